@@ -22,6 +22,7 @@
 #include "h2rngLib.h"
 #include "h2timeLib.h"
 #include "h2semLib.h"
+#include "mboxTypes.h"
 #include "h2endianness.h"
 
 #ifdef __cplusplus
@@ -47,6 +48,18 @@ typedef struct H2_SEM_STR {
  * XXX are stored under the 'taskId' name. Don't mix them!
  */
 
+/* Send date of a message of a MBOX_FLAG_LATENCY mailbox, for the
+   latency statistics.
+   Each lane has nStamp entries, a power of two not smaller than the
+   number of blocks its ring buffer can hold: entry seq % nStamp belongs
+   to the message numbered seq in the lane, as told by tag */
+typedef struct H2_MBOX_STAMP {
+    unsigned int tag;			/* H2_MBOX_STAMP_TAG(), 0 if unused */
+    unsigned int usec;			/* send date, in microseconds */
+} H2_MBOX_STAMP;
+
+#define H2_MBOX_STAMP_TAG(seq, prio) ((((seq) << 3) | (prio)) + 1)
+
 /* Mailbox */
 typedef struct H2_MBOX_STR {
     long taskId;			/* h2dev id */
@@ -54,6 +67,25 @@ typedef struct H2_MBOX_STR {
     H2SEM_ID semExcl;			/* mutex for this mailbox */
     H2SEM_ID semSigRd;			/* signalling semaphore  */
     H2RNG_ID rngId;			/* global Id of the ring buffer */
+    int flags;				/* MBOX_FLAG_xxx options */
+    H2WAKE wakeRd;			/* wakes up the reader (semSigRd) */
+    int slot;				/* index in the owner ready set or -1 */
+    H2SEM_ID semSigWr;			/* blocked senders semaphore */
+    H2WAKE wakeWr;			/* wakes up all blocked senders */
+    int sendWaiters;			/* senders waiting for room */
+    int nSendBlocked;			/* number of times a sender waited */
+    int nPrio;				/* number of priority lanes */
+    int peekPrio;			/* lane of the last mboxRcvPeek() */
+    int peekPos;			/* its block (MBOX_FLAG_CONFLATE) or -1 */
+    H2RNG_ID rngPrio[MBOX_MAX_PRIO-1];	/* global Ids of lanes 1.. */
+    MBOX_STATS stats;			/* traffic statistics */
+    H2_MBOX_STAMP *stamp;		/* global address of the send dates */
+    int nStamp;				/* number of send dates per lane */
+    int fdArmed;			/* mboxGetFd() made a fifo */
+    int fdPending;			/* the fifo was written to */
+    int fdPid;				/* process owning fdRd and fdWr */
+    int fdRd, fdWr;			/* its ends of the fifo */
+    int maxSize;			/* size limit of MBOX_FLAG_GROW */
 } H2_MBOX_STR;
 
 /* Poster statistics */
@@ -77,15 +109,43 @@ typedef struct H2_POSTER_STR {
     H2_POSTER_STAT_STR stats;		/* statistics */
 } H2_POSTER_STR;
 
+/* Number of mailboxes of a task tracked by its ready set */
+#define H2_TASK_MAX_MBOX 32
+
 /* Task */
 typedef struct H2_TASK_STR {
     long taskId;			/* taskLib id */
     int semId;
+    H2WAKE wake;			/* wakes up the task (semId) */
+    unsigned int mboxReady;		/* bit i: mbox[i] may have messages */
+    int nMboxOther;			/* mailboxes and groups not in mbox[] */
+    int mbox[H2_TASK_MAX_MBOX];		/* owned mailboxes and subscribed
+					   groups, ERROR if free */
 } H2_TASK_STR;
 
+/* Number of subscribers of a mailbox group */
+#define H2_MBOXGRP_MAX_SUBS 32
+
+/* Subscriber of a mailbox group */
+typedef struct H2_MBOXGRP_SUB {
+    int task;				/* h2dev id of the task, ERROR if free */
+    unsigned int rd;			/* position of its next message */
+    int slot;				/* index in the task ready set or -1 */
+} H2_MBOXGRP_SUB;
+
+/* Mailbox group: messages written once, read by every subscriber */
+typedef struct H2_MBOXGRP_STR {
+    long taskId;			/* h2dev id of the creator */
+    int size;				/* size of the data, a power of 2 */
+    H2SEM_ID semExcl;			/* mutex for senders and subscribers */
+    char *pData;			/* global address of the data */
+    unsigned int wr;			/* position of the next message */
+    H2_MBOXGRP_SUB sub[H2_MBOXGRP_MAX_SUBS];
+} H2_MBOXGRP_STR;
+
 /* Shared memory */
 typedef struct H2_MEM_STR {
-    int shmId;				/* IPC SHM identifier */
+    int shmId;				/* IPC SHM identifier, -1 if POSIX */
     int size;				/* size */
 } H2_MEM_STR;
 
@@ -97,42 +157,73 @@ typedef enum {
     H2_DEV_TYPE_MBOX,
     H2_DEV_TYPE_POSTER,
     H2_DEV_TYPE_TASK,
-    H2_DEV_TYPE_MEM
+    H2_DEV_TYPE_MEM,
+    H2_DEV_TYPE_MBOXGRP
 } H2_DEV_TYPE;
 
 /* Number of defined device types */
-#define H2DEV_MAX_TYPES 7
+#define H2DEV_MAX_TYPES 8
 
 /* Maximum length of a device name */
 #define H2_DEV_MAX_NAME 32
 
-/* devices */
+/* devices, aligned on cache lines so that segments of devices are small
+   multiples of a page */
+#define H2_DEV_ALIGN 64
 typedef struct H2_DEV_STR {
     H2_DEV_TYPE type;
     unsigned int devgen; /* h2dev number: contains generation # and index */
+    unsigned int seq;	 /* odd while type, devgen, name or uid change */
     char name[H2_DEV_MAX_NAME];
     long uid;
+    int typeNext, typePrev;	/* list of the devices of the same type */
+    int owner;			/* owner task device, or -1 */
+    int ownerNext, ownerPrev;	/* list of the devices of the same owner */
+    int ownerHead;		/* first device owned by this one */
     union {
 	H2_SEM_STR sem;
 	H2_MBOX_STR mbox;
 	H2_POSTER_STR poster;
 	H2_TASK_STR task;
 	H2_MEM_STR mem;
+	H2_MBOXGRP_STR mboxgrp;
     } data;
-} H2_DEV_STR;
+} __attribute__((aligned(H2_DEV_ALIGN))) H2_DEV_STR;
 
 /* Default Maximum number of h2 devices */
 #define H2_DEV_MAX_DEFAULT 120
 
+/* Number of devices the table can grow to, and of shared memory segments
+   holding it */
+#define H2_DEV_MAX_LIMIT 16384
+#define H2_DEV_MAX_CHUNKS 16
+
+/* Shared memory backend options, see h2devSetShmFlags() */
+#define H2DEV_SHM_POSIX    0x01		/* shm_open(3) objects, not SysV IPC */
+#define H2DEV_SHM_HUGE     0x02		/* ask for transparent huge pages */
+#define H2DEV_SHM_POPULATE 0x04		/* prefault the mappings */
+#define H2DEV_SHM_MLOCK    0x08		/* lock the mappings in memory */
+#define H2DEV_SHM_ALL      0x0f
+
 /* Number of bits of an h2dev dedicated to generation number */
 #define H2_DEV_GEN_BITS 12
 
-/* Timeout on h2devFind */
+/* Slots of the name index per device. The index is an open addressing
+   table of device index + 1 (0 for a free slot) stored in the shared
+   segment before the devices, sized for the largest table */
+#define H2_DEV_HASH_RATIO 2
+#define H2_DEV_HASH_SLOTS (H2_DEV_HASH_RATIO * H2_DEV_MAX_LIMIT)
+#define H2_DEV_HASH_TOMB (-1)
+
+/* Timeout on H2SEM_DEV_LOCK in h2devSnapshot, in ticks */
 #define H2DEV_TIMEOUT 100
 
 /* External name for h2 devices */
 #define H2_DEV_NAME ".h2dev"
 
+/* Maximum length of a namespace name, see h2devSetNamespace() */
+#define H2DEV_MAX_NAMESPACE 32
+
 /* -- ERRORS CODES ----------------------------------------------- */
 
 #include "h2errorLib.h"
@@ -166,6 +257,9 @@ typedef struct H2_DEV_STR {
 
 extern H2_DEV_STR *h2Devs;
 extern H2_DEV_STR h2DevInvalid;
+extern int *h2devHash;
+extern int *h2devTypeHead;
+extern int h2devMapped;
 
   /* a h2 device is stored on 32 bits, with first bits for generation # */
 #define H2DEV_INDEX(dev) \
@@ -173,9 +267,12 @@ extern H2_DEV_STR h2DevInvalid;
 #define H2DEV_GEN(dev) \
   ((unsigned int)(dev) >> (8*sizeof(int) - H2_DEV_GEN_BITS))
 #define H2DEV_BY_INDEX(idx) (h2Devs[idx].devgen)
+  /* devices added to the table by other processes are mapped on demand,
+     out of line by h2devExtendDev() */
 #define H2DEV_DEV(dev)                                                      \
-  (h2Devs[H2DEV_INDEX(dev)].devgen == (dev) ?                               \
-   &h2Devs[H2DEV_INDEX(dev)] : &h2DevInvalid)
+  (H2DEV_INDEX(dev) < (unsigned int)h2devMapped &&                          \
+   h2Devs[H2DEV_INDEX(dev)].devgen == (unsigned int)(dev) ?                 \
+   &h2Devs[H2DEV_INDEX(dev)] : h2devExtendDev((unsigned int)(dev)))
 
 #define H2DEV_NAME(dev) H2DEV_DEV(dev)->name
 #define H2DEV_TYPE(dev) H2DEV_DEV(dev)->type
@@ -189,6 +286,11 @@ extern H2_DEV_STR h2DevInvalid;
 #define H2DEV_MBOX_SEM_EXCL_ID(dev) H2DEV_DEV(dev)->data.mbox.semExcl
 #define H2DEV_MBOX_TASK_ID(dev) H2DEV_DEV(dev)->data.mbox.taskId
 #define H2DEV_MBOX_RNG_ID(dev) H2DEV_DEV(dev)->data.mbox.rngId
+#define H2DEV_MBOX_FLAGS(dev) H2DEV_DEV(dev)->data.mbox.flags
+#define H2DEV_MBOX_WAKE(dev) (&(H2DEV_DEV(dev)->data.mbox.wakeRd))
+#define H2DEV_MBOX_SLOT(dev) H2DEV_DEV(dev)->data.mbox.slot
+#define H2DEV_MBOX_WAKE_WR(dev) (&(H2DEV_DEV(dev)->data.mbox.wakeWr))
+#define H2DEV_MBOX_STATS(dev) (&(H2DEV_DEV(dev)->data.mbox.stats))
 
 #define H2DEV_POSTER_SEM_ID(dev) H2DEV_DEV(dev)->data.poster.semId
 #define H2DEV_POSTER_POOL(dev) H2DEV_DEV(dev)->data.poster.pPool
@@ -208,10 +310,17 @@ extern H2_DEV_STR h2DevInvalid;
 #define H2DEV_TASK_TID(dev) H2DEV_DEV(dev)->data.task.taskId
 #define H2DEV_TASK_PID(dev) H2DEV_DEV(dev)->data.task.pid
 #define H2DEV_TASK_SEM_ID(dev) H2DEV_DEV(dev)->data.task.semId
+#define H2DEV_TASK_WAKE(dev) (&(H2DEV_DEV(dev)->data.task.wake))
+#define H2DEV_TASK_MBOX_READY(dev) H2DEV_DEV(dev)->data.task.mboxReady
+#define H2DEV_TASK_NMBOX_OTHER(dev) H2DEV_DEV(dev)->data.task.nMboxOther
+#define H2DEV_TASK_MBOX(dev, i) H2DEV_DEV(dev)->data.task.mbox[i]
 
 #define H2DEV_MEM_SHM_ID(dev) H2DEV_DEV(dev)->data.mem.shmId
 #define H2DEV_MEM_SIZE(dev) H2DEV_DEV(dev)->data.mem.size
 
+#define H2DEV_MBOXGRP_STR(dev) (&(H2DEV_DEV(dev)->data.mboxgrp))
+#define H2DEV_MBOXGRP_SEM_EXCL_ID(dev) H2DEV_DEV(dev)->data.mboxgrp.semExcl
+
 /*
  * Prototypes
  */
@@ -219,14 +328,35 @@ extern int h2devRecordH2ErrMsgs(void);
 extern int h2devAlloc ( const char *name, H2_DEV_TYPE type );
 extern int h2devAllocUnlocked ( const char *name, H2_DEV_TYPE type );
 extern STATUS h2devAttach ( int *h2devMax );
+extern STATUS h2devExtend ( unsigned int idx );
+extern H2_DEV_STR *h2devExtendDev ( unsigned int dev );
+extern STATUS h2devGrow ( void );
 extern int h2devSize ( void );
 extern STATUS h2devEnd ( void );
 extern int h2devFind ( const char *name, H2_DEV_TYPE type );
+extern void h2devHashAdd ( int idx );
+extern void h2devTypeAdd ( int idx );
+extern int h2devFirst ( H2_DEV_TYPE type );
+extern int h2devNext ( int dev, H2_DEV_TYPE type );
+extern STATUS h2devSetOwner ( int dev, int owner );
+extern int h2devOwnerFirst ( int owner );
+extern int h2devOwnerNext ( int dev, int owner );
+extern STATUS h2devSnapshot ( int idx, H2_DEV_STR *snap );
+extern STATUS h2devGetName ( int dev, char *name, size_t len );
 extern STATUS h2devFree ( int dev );
 extern STATUS h2devClean ( const char *name );
 extern long h2devGetKey ( int type, int dev, BOOL create, int *pFd );
+extern STATUS h2devGetPath ( int dev, const char *suffix, char *path, size_t len );
 extern int h2devGetSemId ( void );
 extern STATUS h2devInit ( int smMemSize, int h2devMax, int posterServFlag );
+extern STATUS h2devSetNamespace ( const char *name );
+extern const char *h2devGetNamespace ( void );
+extern STATUS h2devSetShmFlags ( int flags );
+extern int h2devGetShmFlags ( void );
+extern void *h2devShmMap ( const char *what, size_t *len, void *addr,
+			   int flags, BOOL create );
+extern int h2devShmOpen ( const char *what, int oflag );
+extern STATUS h2devShmUnlink ( const char *what );
 extern STATUS h2devShow ( void );
 
 #ifdef __cplusplus
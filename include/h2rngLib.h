@@ -35,6 +35,8 @@
    de ring buffers, version HILARE II  (inter-processeurs)
 */
 
+#include <sys/uio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -52,16 +54,55 @@ extern "C" {
 /* Caractere d'indication de la fin d'un block */
 #define  H2RNG_CAR_END   '$'
 
-/* Tete d'un ring buffer */
+/* Options des ring buffers (h2rngCreateFlags) */
+#define  H2RNG_FLAG_SPSC        0x0001      /* 1 producer, 1 consumer */
+#define  H2RNG_FLAG_MIRROR      0x0002      /* donnees projetees 2 fois */
+#define  H2RNG_FLAG_MPSC        0x0004      /* n producers, 1 consumer */
+
+/* Taille d'une ligne de cache, pour separer lecteur et ecrivain */
+#define  H2RNG_CACHE_LINE       64
+
+/* Tete d'un ring buffer.
+ * pRd is only written by the consumer and pWr only by the producer: they
+ * live on separate cache lines and are accessed with acquire/release
+ * ordering, so that a single producer and a single consumer can share a
+ * block ring without any lock. Block rings also count the blocks put
+ * (nPut) and got (nGet) next to the matching pointer, so that the
+ * number of blocks is nPut - nGet. With H2RNG_FLAG_MPSC, producers
+ * first claim room by moving pRsv with a compare and swap; pWr then
+ * follows pRsv as blocks are committed, moved together with nPut by a
+ * single compare and swap. */
 typedef struct {
   int flgInit;      /* Indicateur d'initialisation */
+  int size;         /* Taille du ring buffer */
+  int flags;        /* Options H2RNG_FLAG_xxx */
+  int mirrorPid;    /* Objet shm des donnees (H2RNG_FLAG_MIRROR) */
+  int mirrorSeq;
+  char pad0[H2RNG_CACHE_LINE - 5*sizeof(int)];
   int pRd;          /* Pointeur de lecture */
+  unsigned int nGet;  /* Nombre de blocks lus */
+  char pad1[H2RNG_CACHE_LINE - 2*sizeof(int)];
   int pWr;          /* Pointeur d'ecriture */
-  int size;         /* Taille du ring buffer */
+  unsigned int nPut;  /* Nombre de blocks ecrits */
+  int pRsv;         /* Fin de la place reservee (H2RNG_FLAG_MPSC) */
+  char pad2[H2RNG_CACHE_LINE - 3*sizeof(int)];
 } H2RNG_HDR;
 
 typedef H2RNG_HDR *H2RNG_ID;
 
+/* Vue directe sur le contenu d'un block du ring (acces sans copie).
+ * The data of a block may wrap at the end of the ring: it is then
+ * described by two pieces, otherwise len[1] is 0. Blocks of a
+ * H2RNG_FLAG_MIRROR ring never wrap. */
+typedef struct H2RNG_VIEW {
+  char *ptr[2];     /* Morceaux des donnees du block */
+  int len[2];       /* Taille de chaque morceau */
+  int nbytes;       /* Nombre de bytes du message */
+  int id;           /* Identificateur du block */
+  int pos;          /* Position du block dans le ring */
+  int next;         /* Position du block suivant */
+} H2RNG_VIEW;
+
 /* -- ERRORS CODES ----------------------------------------------- */
 
 #include "h2errorLib.h"
@@ -79,6 +120,7 @@ typedef H2RNG_HDR *H2RNG_ID;
 #define  S_h2rngLib_SMALL_BUF             H2_ENCODE_ERR(M_h2rngLib, 6)
 #define  S_h2rngLib_SMALL_BLOCK           H2_ENCODE_ERR(M_h2rngLib, 7)
 #define  S_h2rngLib_BIG_BLOCK             H2_ENCODE_ERR(M_h2rngLib, 8)
+#define  S_h2rngLib_MIRROR_ERROR          H2_ENCODE_ERR(M_h2rngLib, 9)
 
 
 #define H2_RNG_LIB_H2_ERR_MSGS { \
@@ -91,6 +133,7 @@ typedef H2RNG_HDR *H2RNG_ID;
    {"SMALL_BUF",             H2_DECODE_ERR(S_h2rngLib_SMALL_BUF)},  \
    {"SMALL_BLOCK",           H2_DECODE_ERR(S_h2rngLib_SMALL_BLOCK)},  \
    {"BIG_BLOCK",             H2_DECODE_ERR(S_h2rngLib_BIG_BLOCK)},  \
+   {"MIRROR_ERROR",          H2_DECODE_ERR(S_h2rngLib_MIRROR_ERROR)},  \
      }
 
 /* RING macros */
@@ -232,12 +275,22 @@ typedef H2RNG_HDR *H2RNG_ID;
 
 
 extern int h2rngBlockGet ( H2RNG_ID rngId, int *pidBlk, char *buf, int maxbytes );
+extern int h2rngBlockGetN ( H2RNG_ID rngId, int maxBlocks, int *pidBlk, int *pnbytes, char **bufs, int maxbytes );
 extern int h2rngBlockPut ( H2RNG_ID rngId, int idBlk, const char *buf, int nbytes );
+extern int h2rngBlockPutV ( H2RNG_ID rngId, int idBlk, const struct iovec *iov, int iovcnt );
+extern int h2rngBlockPutN ( H2RNG_ID rngId, int idBlk, int nBlocks, char * const *bufs, const int *nbytes );
 extern STATUS h2rngBlockSkip ( H2RNG_ID rngId );
+extern int h2rngBlockReserve ( H2RNG_ID rngId, int nbytes, H2RNG_VIEW *view );
+extern STATUS h2rngBlockCommit ( H2RNG_ID rngId, int idBlk, int nbytes, H2RNG_VIEW *view );
+extern int h2rngBlockPeek ( H2RNG_ID rngId, H2RNG_VIEW *view );
+extern STATUS h2rngBlockRelease ( H2RNG_ID rngId, H2RNG_VIEW *view );
+extern int h2rngBlockFind ( H2RNG_ID rngId, int idBlk, H2RNG_VIEW *view );
+extern int h2rngViewCopy ( const H2RNG_VIEW *view, int offset, char *buf, int maxbytes );
 extern int h2rngBlockSpy ( H2RNG_ID rngId, int *pidBlk, int *pnbytes, char *buf, int maxbytes );
 extern int h2rngBufGet ( H2RNG_ID rngId, char *buf, int maxbytes );
 extern int h2rngBufPut ( H2RNG_ID rngId, const char *buf, int nbytes );
 extern H2RNG_ID h2rngCreate ( int type, int nbytes );
+extern H2RNG_ID h2rngCreateFlags ( int type, int nbytes, int flags );
 extern H2RNG_ID h2rngRealloc ( H2RNG_ID rngId, int nbytes );
 extern void h2rngDelete ( H2RNG_ID rngId );
 extern STATUS h2rngFlush ( H2RNG_ID rngId );
@@ -30,9 +30,32 @@ extern "C" {
 #define   H2SEM_SYNC         0          /* Semaphore de synchronisation */
 #define   H2SEM_EXCL         1          /* Semaphore d'exclusion mutuelle */
 
+/* Global locks, the first semaphores of the first array. A task holding
+   H2SEM_SEM_LOCK may take H2SEM_DEV_LOCK, never the other way round.
+   H2SEM_MEM_LOCK is never held with another one. */
+#define   H2SEM_DEV_LOCK     0          /* table of h2 devices */
+#define   H2SEM_SEM_LOCK     1          /* semaphore allocator */
+#define   H2SEM_MEM_LOCK     2          /* shared memory heap */
+#define   H2SEM_NLOCKS       3
+
 /* semaphore id, encoded as the (h2dev index)*MAX_SEM + semaphore index */
 typedef int H2SEM_ID;
 
+/* Evenement binaire en memoire partagee. h2wakeTake() is for a single
+ * owner, which consumes the event through seen. Several tasks can wait
+ * with h2wakeWait() instead, each on its own snapshot of seq taken with
+ * h2wakeSeq(): a give wakes all of them.
+ * h2wakeGive() only enters the kernel when a task is actually sleeping,
+ * and a wait that finds the event already given does not enter it at
+ * all. It relies on futexes where available and falls back to the SysV
+ * semaphore sem otherwise. */
+typedef struct H2WAKE {
+    unsigned int seq;		/* incremented by each give (futex word) */
+    unsigned int seen;		/* last seq consumed by the owner */
+    unsigned int waiters;	/* tasks sleeping on seq */
+    H2SEM_ID sem;		/* SysV fallback */
+} H2WAKE;
+
 /* -- ERRORS CODES ----------------------------------------------- */
 
 #include "h2errorLib.h"
@@ -79,6 +102,12 @@ extern STATUS h2semInit ( int num, int *pSemId );
 extern STATUS h2semShow ( H2SEM_ID sem );
 extern BOOL h2semTake ( H2SEM_ID sem, int timeout );
 extern STATUS h2semSet ( H2SEM_ID sem, int value );
+extern void h2wakeInit ( H2WAKE *w, H2SEM_ID sem );
+extern STATUS h2wakeGive ( H2WAKE *w );
+extern BOOL h2wakeTake ( H2WAKE *w, int timeout );
+extern unsigned int h2wakeSeq ( H2WAKE *w );
+extern BOOL h2wakeWait ( H2WAKE *w, unsigned int *pSeq, int timeout );
+extern void h2wakeFlush ( H2WAKE *w );
 extern void h2semList( void);
 
 #ifdef __cplusplus
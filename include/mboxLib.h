@@ -17,6 +17,9 @@
 #ifndef _MBOXLIB_H
 #define _MBOXLIB_H
 
+#include "h2rngLib.h"
+#include "mboxTypes.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,10 +32,24 @@ typedef int MBOX_ID;
 #define   FIO_GETNAME                   3
 #define   FIO_FLUSH                     4
 #define   FIO_SIZE                      5
+#define   FIO_NSENDBLOCKED              6
+#define   FIO_STATS                     7
+#define   FIO_SETMAXSIZE                8
 
 /* Indication de "tous les mailboxes " */
 #define   ALL_MBOX                      0
 
+/* Mailbox options (mboxCreateFlags) */
+#define   MBOX_FLAG_SPSC                0x0001  /* single sender, lock-free */
+#define   MBOX_FLAG_MIRROR              0x0002  /* messages never wrap */
+#define   MBOX_FLAG_MPSC                0x0004  /* many senders, lock-free */
+#define   MBOX_FLAG_CONFLATE            0x0008  /* latest message per sender */
+#define   MBOX_FLAG_GROW                0x0010  /* grows instead of being full */
+#define   MBOX_FLAG_LATENCY             0x0020  /* latency histogram */
+
+/* Default size limit of a MBOX_FLAG_GROW mailbox, in initial sizes */
+#define   MBOX_GROW_MAX_DEFAULT         16
+
 /* -- ERRORS CODES ----------------------------------------------- */
 
 #include "h2errorLib.h"
@@ -46,6 +63,10 @@ typedef int MBOX_ID;
 #define   S_mboxLib_TOO_BIG             H2_ENCODE_ERR(M_mboxLib, 5)
 #define   S_mboxLib_SMALL_BLOCK         H2_ENCODE_ERR(M_mboxLib, 6)
 #define   S_mboxLib_SHORT_MESSAGE       H2_ENCODE_ERR(M_mboxLib, 7)
+#define   S_mboxLib_BAD_FLAGS           H2_ENCODE_ERR(M_mboxLib, 8)
+#define   S_mboxLib_BAD_PRIO            H2_ENCODE_ERR(M_mboxLib, 9)
+#define   S_mboxLib_NOT_SUBSCRIBED      H2_ENCODE_ERR(M_mboxLib, 10)
+#define   S_mboxLib_GROUP_FULL          H2_ENCODE_ERR(M_mboxLib, 11)
 
 #define MBOX_LIB_H2_ERR_MSGS { \
    {"MBOX_CLOSED",         H2_DECODE_ERR(S_mboxLib_MBOX_CLOSED)},  \
@@ -56,20 +77,46 @@ typedef int MBOX_ID;
    {"TOO_BIG",             H2_DECODE_ERR(S_mboxLib_TOO_BIG)},  \
    {"SMALL_BLOCK",         H2_DECODE_ERR(S_mboxLib_SMALL_BLOCK)},  \
    {"SHORT_MESSAGE",       H2_DECODE_ERR(S_mboxLib_SHORT_MESSAGE)},  \
+   {"BAD_FLAGS",           H2_DECODE_ERR(S_mboxLib_BAD_FLAGS)},  \
+   {"BAD_PRIO",            H2_DECODE_ERR(S_mboxLib_BAD_PRIO)},  \
+   {"NOT_SUBSCRIBED",      H2_DECODE_ERR(S_mboxLib_NOT_SUBSCRIBED)},  \
+   {"GROUP_FULL",          H2_DECODE_ERR(S_mboxLib_GROUP_FULL)},  \
   }
 
 /* -- PROTOTYPES ----------------------------------------------- */
 extern STATUS mboxCreate ( const char *name, int len, MBOX_ID *pMboxId );
+extern STATUS mboxCreateFlags ( const char *name, int len, int flags, MBOX_ID *pMboxId );
+extern STATUS mboxCreatePrio ( const char *name, int len, int flags, int nPrio, MBOX_ID *pMboxId );
 extern STATUS mboxResize ( MBOX_ID mboxId, int size );
 extern STATUS mboxDelete ( MBOX_ID mboxId );
 extern STATUS mboxEnd ( long taskId );
 extern STATUS mboxFind ( const char *name, MBOX_ID *pMboxId );
+extern STATUS mboxGroupCreate ( const char *name, int size, MBOX_ID *pGrpId );
+extern STATUS mboxGroupDelete ( MBOX_ID grpId );
+extern STATUS mboxGroupFind ( const char *name, MBOX_ID *pGrpId );
+extern STATUS mboxGroupJoin ( MBOX_ID grpId );
+extern STATUS mboxGroupLeave ( MBOX_ID grpId );
+extern int mboxGroupRcv ( MBOX_ID grpId, MBOX_ID *pFromId, char *buf, int maxbytes, int timeout );
+extern STATUS mboxGroupSend ( MBOX_ID grpId, MBOX_ID fromId, char *buf, int nbytes );
+extern int mboxGetFd ( MBOX_ID mboxId );
 extern STATUS mboxInit ( const char *procName );
 extern STATUS mboxIoctl ( MBOX_ID mboxId, int codeFunc, void *pArg );
 extern BOOL mboxPause ( MBOX_ID mboxId, int timeout );
+extern int mboxPauseAll ( MBOX_ID *pReady, int maxIds, int timeout );
 extern int mboxRcv ( MBOX_ID mboxId, MBOX_ID *pFromId, char *buf, int maxbytes, int timeout );
+extern int mboxRcvN ( MBOX_ID mboxId, int maxMsgs, MBOX_ID *pFromIds, int *pNbytes, char **bufs, int maxbytes, int timeout );
+extern int mboxRcvPeek ( MBOX_ID mboxId, MBOX_ID *pFromId, H2RNG_VIEW *view, int timeout );
+extern STATUS mboxRcvRelease ( MBOX_ID mboxId, H2RNG_VIEW *view );
 extern STATUS mboxSend ( MBOX_ID toId, MBOX_ID fromId, char *buf, int nbytes );
+extern STATUS mboxSendPrio ( MBOX_ID toId, MBOX_ID fromId, int prio, char *buf, int nbytes );
+extern STATUS mboxSendTimed ( MBOX_ID toId, MBOX_ID fromId, char *buf, int nbytes, int timeout );
+extern STATUS mboxSendV ( MBOX_ID toId, MBOX_ID fromId, const struct iovec *iov, int iovcnt );
+extern int mboxSendN ( MBOX_ID toId, MBOX_ID fromId, int nMsgs, char * const *bufs, const int *nbytes );
+extern STATUS mboxSendReserve ( MBOX_ID toId, int nbytes, H2RNG_VIEW *view );
+extern STATUS mboxSendCommit ( MBOX_ID toId, MBOX_ID fromId, int nbytes, H2RNG_VIEW *view );
+extern STATUS mboxSendCancel ( MBOX_ID toId, H2RNG_VIEW *view );
 extern void mboxShow ( void );
+extern void mboxStats ( void );
 extern STATUS mboxSkip ( MBOX_ID mboxId );
 extern int mboxSpy ( MBOX_ID mboxId, MBOX_ID *pFromId, int *pNbytes, char *buf, int maxbytes );
 
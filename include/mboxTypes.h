@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ ** Mailbox limits and types shared by mboxLib.h and the mailbox devices
+ ** of h2devLib.h.
+ **/
+
+#ifndef _MBOXTYPES_H
+#define _MBOXTYPES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Nombre maximum de niveaux de priorite d'une mailbox */
+#define   MBOX_MAX_PRIO                 8
+
+/* Statistiques d'une mailbox (FIO_STATS) */
+#define   MBOX_STATS_NLAT               24
+
+typedef struct MBOX_STATS {
+    unsigned int sentMsgs;		/* messages sent */
+    unsigned int sentBytes;		/* bytes sent */
+    unsigned int rcvMsgs;		/* messages received */
+    unsigned int rcvBytes;		/* bytes received */
+    unsigned int sendFull;		/* sends refused on a full mailbox */
+    unsigned int highWater;		/* most bytes held by one lane */
+    /* enqueue to dequeue latency: latency[0] counts messages received
+       within 1us, latency[i] those received within [2^(i-1), 2^i[ us,
+       the last bucket everything slower */
+    unsigned int latency[MBOX_STATS_NLAT];
+} MBOX_STATS;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MBOXTYPES_H */
@@ -1088,6 +1088,7 @@ gcomDispatch (MBOX_ID replyMbox)
 {
     MBOX_ID fromId;            /* Mbox qui a origine le message */
     int nbytes;                /* Nombre de bytes dans mbox ou dans message */
+    H2RNG_VIEW view;           /* Message dans le mailbox */
     LETTER_HDR hdr;            /* En-tete de la lettre recue */
     LETTER_ID letter;          /* Lettre recue */
     SEND *pSend;               /* Pointeur vers structure du send */
@@ -1100,9 +1101,13 @@ gcomDispatch (MBOX_ID replyMbox)
         LOGDBG(("comLib:gcomDispatch: %d bytes in mbox %d\n",
 		nbytes, replyMbox));
 
-	/* Epier le contenu du mailbox */
-	if (mboxSpy (replyMbox, &fromId, &nbytes, (char *) &hdr, 
-		     sizeof (LETTER_HDR)) == sizeof (LETTER_HDR) &&
+	/* Regarder le message sur place */
+	if ((nbytes = mboxRcvPeek (replyMbox, &fromId, &view, 1)) <= 0)
+	    return;
+
+	/* Lire l'en-tete */
+	if (h2rngViewCopy (&view, 0, (char *) &hdr, sizeof (LETTER_HDR))
+	    == sizeof (LETTER_HDR) &&
 	    (sendId = hdr.sendId) >= 0 && sendId < MAX_SEND) {
 	    /* Calculer le pointeur vers la structure donnees send */
 	    pSend = &sendTab [indice][sendId];
@@ -1118,8 +1123,9 @@ gcomDispatch (MBOX_ID replyMbox)
 		/* Si c'est le cas, recevoir cette replique */
 		if (pSend->status == WAITING_INTERMED_REPLY &&
 		    letter->flagInit == GCOM_FLAG_INIT &&
-		    mboxRcv (replyMbox, &fromId, (char *) letter->pHdr,
-			     letter->size, 1) > 0) {
+		    letter->size >= nbytes) {
+		    h2rngViewCopy (&view, 0, (char *) letter->pHdr, nbytes);
+		    (void) mboxRcvRelease (replyMbox, &view);
 		    /* Indiquer l'attente de la replique finale */
 		    pSend->status = WAITING_FINAL_REPLY;
 		    continue;
@@ -1136,8 +1142,9 @@ gcomDispatch (MBOX_ID replyMbox)
 		if ((pSend->status == WAITING_INTERMED_REPLY ||
 		     pSend->status == WAITING_FINAL_REPLY) &&
 		    letter->flagInit == GCOM_FLAG_INIT &&
-		    mboxRcv (replyMbox, &fromId, (char *) letter->pHdr, 
-			     letter->size, 1) > 0) {
+		    letter->size >= nbytes) {
+		    h2rngViewCopy (&view, 0, (char *) letter->pHdr, nbytes);
+		    (void) mboxRcvRelease (replyMbox, &view);
 		    /* Indiquer que la replique a ete recue et continuer */
 		    pSend->status = FINAL_REPLY_OK;
 		    continue;
@@ -1147,7 +1154,7 @@ gcomDispatch (MBOX_ID replyMbox)
       
 	/* Jeter la lettre et continuer */
 	logMsg("Problem while receiving a reply\n");
-	(void) mboxSkip (replyMbox);
+	(void) mboxRcvRelease (replyMbox, &view);
     } /* while */
 }
 
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef _H2ATOMIC_H
+#define _H2ATOMIC_H
+
+/*
+ * Private memory ordering helpers for data shared between processes
+ * through smMem / the h2dev segment. These are thin wrappers around the
+ * GCC/clang __atomic builtins, which are lock-free for aligned ints.
+ */
+
+#if !defined(__GNUC__) && !defined(__clang__)
+# error "comLib requires __atomic builtins (gcc >= 4.7 or clang)"
+#endif
+
+#define H2_LOAD_RELAXED(p)	__atomic_load_n((p), __ATOMIC_RELAXED)
+#define H2_LOAD_ACQ(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define H2_STORE_RELAXED(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define H2_STORE_REL(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define H2_LOAD_SEQ(p)		__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define H2_STORE_SEQ(p, v)	__atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define H2_CAS(p, pOld, v)	__atomic_compare_exchange_n((p), (pOld), (v), \
+				    0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define H2_CAS_RELAXED(p, pOld, v) __atomic_compare_exchange_n((p), (pOld), \
+				    (v), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define H2_ADD_RELAXED(p, v)	__atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define H2_XCHG_RELAXED(p, v)	__atomic_exchange_n((p), (v), __ATOMIC_RELAXED)
+#define H2_ADD_SEQ(p, v)	__atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define H2_SUB_SEQ(p, v)	__atomic_sub_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define H2_OR_SEQ(p, v)		__atomic_or_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define H2_AND_SEQ(p, v)	__atomic_and_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define H2_XCHG_SEQ(p, v)	__atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define H2_FENCE_ACQ()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define H2_FENCE_REL()		__atomic_thread_fence(__ATOMIC_RELEASE)
+
+#endif /* _H2ATOMIC_H */
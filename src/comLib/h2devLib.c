@@ -46,7 +46,16 @@ static const H2_ERROR h2devLibH2errMsgs[] = H2_DEV_LIB_H2_ERR_MSGS;
 
 /* Local fucntions prototypes */
 static int h2devAllocAux(const char *name, H2_DEV_TYPE type, int h2devMax);
-static int h2devFindAux(const char *name, H2_DEV_TYPE type, int h2devMax);
+static int h2devFindAux(const char *name, H2_DEV_TYPE type);
+static unsigned int h2devHashName(const char *name);
+static void h2devHashRemove(int idx);
+static void h2devWriteBegin(int idx);
+static void h2devWriteEnd(int idx);
+static void h2devTypeRemove(int idx);
+static void h2devOwnerRemove(int idx);
+static void h2devOwnerRelease(int idx);
+static int h2devTypeSkip(int idx, H2_DEV_TYPE type);
+static int h2devOwnerSkip(int idx, int owner);
 
 /*----------------------------------------------------------------------*/
 
@@ -61,6 +70,413 @@ h2devRecordH2ErrMsgs(void)
                            h2devLibH2errMsgs);
 }
 
+/*----------------------------------------------------------------------*/
+
+/**
+ ** Entry sequence numbers
+ **
+ ** The type, generation, name and uid of a device are only changed with
+ ** H2SEM_DEV_LOCK held, between h2devWriteBegin() and h2devWriteEnd(). Its
+ ** sequence number is odd meanwhile, so that readers can copy them
+ ** without the semaphore and retry if the number changed.
+ **/
+
+static void
+h2devWriteBegin(int idx)
+{
+    __atomic_store_n(&h2Devs[idx].seq, h2Devs[idx].seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+h2devWriteEnd(int idx)
+{
+    __atomic_store_n(&h2Devs[idx].seq, h2Devs[idx].seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Lock-free copy attempts before h2devSnapshot() takes H2SEM_DEV_LOCK */
+#define H2DEV_SNAPSHOT_TRIES 1000
+
+static void
+h2devSnapshotCopy(const H2_DEV_STR *dev, H2_DEV_STR *snap)
+{
+    snap->type = dev->type;
+    snap->devgen = dev->devgen;
+    snap->uid = dev->uid;
+    memcpy(snap->name, dev->name, H2_DEV_MAX_NAME);
+    snap->name[H2_DEV_MAX_NAME - 1] = '\0';
+}
+
+/**
+ ** Consistent copy of the type, generation, name and uid of the device at
+ ** index idx. The device data is not copied. If the entry keeps changing,
+ ** or a writer died in the middle of an update, the copy is made under
+ ** H2SEM_DEV_LOCK, waited for at most H2DEV_TIMEOUT ticks.
+ **/
+STATUS
+h2devSnapshot(int idx, H2_DEV_STR *snap)
+{
+    H2_DEV_STR *dev = &h2Devs[idx];
+    unsigned int seq;
+    int tries;
+
+    for (tries = 0; tries < H2DEV_SNAPSHOT_TRIES; tries++) {
+	if ((seq = __atomic_load_n(&dev->seq, __ATOMIC_ACQUIRE)) & 1)
+	    continue;
+	h2devSnapshotCopy(dev, snap);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&dev->seq, __ATOMIC_RELAXED) == seq) {
+	    snap->seq = seq;
+	    return OK;
+	}
+    }
+    if (h2semTake(H2SEM_DEV_LOCK, H2DEV_TIMEOUT) != TRUE) {
+	errnoSet(S_h2devLib_NOT_FOUND);
+	return ERROR;
+    }
+    h2devSnapshotCopy(dev, snap);
+    snap->seq = dev->seq;
+    h2semGive(H2SEM_DEV_LOCK);
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ ** Name index
+ **
+ ** Devices are indexed by the hash of their name in h2devHash, with
+ ** linear probing. Updates are done with H2SEM_DEV_LOCK held and published
+ ** with release stores, so that lookups do not need it: a slot read by
+ ** a lookup may point to a device being freed or reused, which the
+ ** lookup detects by checking its type and name.
+ **/
+
+static unsigned int
+h2devHashName(const char *name)
+{
+    unsigned int h = 2166136261U;
+    int i;
+
+    /* FNV-1a */
+    for (i = 0; i < H2_DEV_MAX_NAME && name[i] != '\0'; i++) {
+	h ^= (unsigned char)name[i];
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/**
+ ** Index the device at index idx. H2SEM_DEV_LOCK must be held.
+ **/
+void
+h2devHashAdd(int idx)
+{
+    int n = H2_DEV_HASH_SLOTS;
+    unsigned int s = h2devHashName(h2Devs[idx].name) % n;
+
+    /* reuse the first deleted slot */
+    while (h2devHash[s] > 0)
+	s = (s + 1) % n;
+    __atomic_store_n(&h2devHash[s], idx + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ ** Remove the device at index idx from the index. H2SEM_DEV_LOCK must be held.
+ **/
+static void
+h2devHashRemove(int idx)
+{
+    int n = H2_DEV_HASH_SLOTS;
+    unsigned int s = h2devHashName(h2Devs[idx].name) % n;
+    int i;
+
+    for (i = 0; i < n && h2devHash[s] != 0; i++, s = (s + 1) % n) {
+	if (h2devHash[s] != idx + 1)
+	    continue;
+	/* Mark the slot as deleted, unless it ends a probe sequence: then
+	   it and the deleted slots before it can be freed */
+	if (h2devHash[(s + 1) % n] != 0) {
+	    __atomic_store_n(&h2devHash[s], H2_DEV_HASH_TOMB, __ATOMIC_RELEASE);
+	    return;
+	}
+	do {
+	    __atomic_store_n(&h2devHash[s], 0, __ATOMIC_RELEASE);
+	    s = (s + n - 1) % n;
+	} while (h2devHash[s] == H2_DEV_HASH_TOMB);
+	return;
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ ** Device lists
+ **
+ ** The devices of each type are linked in a list starting at
+ ** h2devTypeHead[type], and the devices owned by a task device in a list
+ ** starting at its ownerHead. Links and owners are device numbers, with
+ ** their generation, -1 ending a list. They are changed with
+ ** H2SEM_DEV_LOCK held and published with release stores. A removed
+ ** device keeps its next links, so that a scan without the semaphore can
+ ** go on from a device freed meanwhile. Once the device is allocated
+ ** again, or given to another owner, its links lead to another list: a
+ ** scan that reaches it through a former link, or stands on it, sees
+ ** that its number or owner changed and starts over from the head of its
+ ** list. A scan may thus miss the devices allocated or freed during the
+ ** scan, or see some twice. A scan deleting the devices it visits gets
+ ** the next one first.
+ **/
+
+/**
+ ** Link the device at index idx in the list of its type, without owner.
+ ** H2SEM_DEV_LOCK must be held.
+ **/
+void
+h2devTypeAdd(int idx)
+{
+    H2_DEV_STR *d = &h2Devs[idx];
+    int head = h2devTypeHead[d->type];
+
+    d->owner = -1;
+    d->ownerPrev = -1;
+    d->ownerHead = -1;
+    d->typePrev = -1;
+    /* stored after the new generation, see h2devTypeLink() */
+    __atomic_store_n(&d->ownerNext, -1, __ATOMIC_RELEASE);
+    __atomic_store_n(&d->typeNext, head, __ATOMIC_RELEASE);
+    if (head != -1)
+	h2Devs[H2DEV_INDEX(head)].typePrev = d->devgen;
+    __atomic_store_n(&h2devTypeHead[d->type], d->devgen, __ATOMIC_RELEASE);
+}
+
+/**
+ ** Unlink the device at index idx from the list of its type.
+ ** H2SEM_DEV_LOCK must be held.
+ **/
+static void
+h2devTypeRemove(int idx)
+{
+    H2_DEV_STR *d = &h2Devs[idx];
+
+    if (d->typePrev != -1)
+	__atomic_store_n(&h2Devs[H2DEV_INDEX(d->typePrev)].typeNext,
+	    d->typeNext, __ATOMIC_RELEASE);
+    else
+	__atomic_store_n(&h2devTypeHead[d->type], d->typeNext,
+	    __ATOMIC_RELEASE);
+    if (d->typeNext != -1)
+	h2Devs[H2DEV_INDEX(d->typeNext)].typePrev = d->typePrev;
+}
+
+/**
+ ** Unlink the device at index idx from the list of its owner.
+ ** H2SEM_DEV_LOCK must be held.
+ **/
+static void
+h2devOwnerRemove(int idx)
+{
+    H2_DEV_STR *d = &h2Devs[idx];
+
+    if (d->owner == -1)
+	return;
+    if (d->ownerPrev != -1)
+	__atomic_store_n(&h2Devs[H2DEV_INDEX(d->ownerPrev)].ownerNext,
+	    d->ownerNext, __ATOMIC_RELEASE);
+    else
+	__atomic_store_n(&h2Devs[H2DEV_INDEX(d->owner)].ownerHead,
+	    d->ownerNext, __ATOMIC_RELEASE);
+    if (d->ownerNext != -1)
+	h2Devs[H2DEV_INDEX(d->ownerNext)].ownerPrev = d->ownerPrev;
+    __atomic_store_n(&d->owner, -1, __ATOMIC_RELEASE);
+}
+
+/**
+ ** Release the devices owned by the device at index idx.
+ ** H2SEM_DEV_LOCK must be held.
+ **/
+static void
+h2devOwnerRelease(int idx)
+{
+    int i;
+
+    for (i = h2Devs[idx].ownerHead; i != -1;
+	 i = h2Devs[H2DEV_INDEX(i)].ownerNext)
+	__atomic_store_n(&h2Devs[H2DEV_INDEX(i)].owner, -1, __ATOMIC_RELEASE);
+    __atomic_store_n(&h2Devs[idx].ownerHead, -1, __ATOMIC_RELEASE);
+}
+
+/**
+ ** Make the device dev owned by the task device owner
+ **/
+STATUS
+h2devSetOwner(int dev, int owner)
+{
+    H2_DEV_STR *d;
+    int idx, head;
+
+    if (h2devAttach(NULL) == ERROR) {
+        return ERROR;
+    }
+    h2semTake(H2SEM_DEV_LOCK, WAIT_FOREVER);
+    if (H2DEV_TYPE(dev) == H2_DEV_TYPE_NONE ||
+        H2DEV_TYPE(owner) != H2_DEV_TYPE_TASK) {
+        h2semGive(H2SEM_DEV_LOCK);
+        errnoSet(S_h2devLib_BAD_PARAMETERS);
+        return ERROR;
+    }
+    idx = H2DEV_INDEX(dev);
+    d = &h2Devs[idx];
+    h2devOwnerRemove(idx);
+    head = h2Devs[H2DEV_INDEX(owner)].ownerHead;
+    d->ownerPrev = -1;
+    /* the owner is stored before the link, see h2devOwnerLink() */
+    __atomic_store_n(&d->owner, owner, __ATOMIC_RELAXED);
+    __atomic_store_n(&d->ownerNext, head, __ATOMIC_RELEASE);
+    if (head != -1)
+        h2Devs[H2DEV_INDEX(head)].ownerPrev = dev;
+    __atomic_store_n(&h2Devs[H2DEV_INDEX(owner)].ownerHead, dev,
+        __ATOMIC_RELEASE);
+    h2semGive(H2SEM_DEV_LOCK);
+    return OK;
+}
+
+/**
+ ** Link following dev in the list of the given type, or the head of the
+ ** list if dev was allocated again
+ **/
+static int
+h2devTypeLink(int dev, H2_DEV_TYPE type)
+{
+    H2_DEV_STR *d = &h2Devs[H2DEV_INDEX(dev)];
+    int next;
+
+    next = __atomic_load_n(&d->typeNext, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&d->devgen, __ATOMIC_RELAXED) == (unsigned int)dev)
+        return next;
+    return __atomic_load_n(&h2devTypeHead[type], __ATOMIC_ACQUIRE);
+}
+
+/**
+ ** First device of the given type from dev in its list
+ **/
+static int
+h2devTypeSkip(int dev, H2_DEV_TYPE type)
+{
+    H2_DEV_STR snap;
+    int idx;
+
+    while (dev != -1) {
+        idx = H2DEV_INDEX(dev);
+        /* the device may have been added by another process */
+        if (idx >= h2devMapped && h2devExtend(idx) == ERROR)
+            return ERROR;
+        if (h2devSnapshot(idx, &snap) == ERROR)
+            return ERROR;
+        if (snap.devgen == (unsigned int)dev && snap.type == type)
+            return dev;
+        dev = h2devTypeLink(dev, type);
+    }
+    return ERROR;
+}
+
+/**
+ ** First device of the given type, ERROR if there is none
+ **/
+int
+h2devFirst(H2_DEV_TYPE type)
+{
+    if (type <= H2_DEV_TYPE_NONE || type >= H2DEV_MAX_TYPES ||
+        h2devAttach(NULL) == ERROR) {
+        return ERROR;
+    }
+    return h2devTypeSkip(
+        __atomic_load_n(&h2devTypeHead[type], __ATOMIC_ACQUIRE), type);
+}
+
+/**
+ ** Device of the given type following dev, ERROR at the end of the list
+ **/
+int
+h2devNext(int dev, H2_DEV_TYPE type)
+{
+    if (type <= H2_DEV_TYPE_NONE || type >= H2DEV_MAX_TYPES) {
+        return ERROR;
+    }
+    return h2devTypeSkip(h2devTypeLink(dev, type), type);
+}
+
+/**
+ ** Link following dev in the list of owner, or the head of the list if
+ ** dev was allocated again or given to another owner
+ **/
+static int
+h2devOwnerLink(int dev, int owner)
+{
+    H2_DEV_STR *d = &h2Devs[H2DEV_INDEX(dev)];
+    int next, o;
+
+    next = __atomic_load_n(&d->ownerNext, __ATOMIC_ACQUIRE);
+    o = __atomic_load_n(&d->owner, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&d->devgen, __ATOMIC_RELAXED) == (unsigned int)dev &&
+        (o == -1 || o == owner))
+        return next;
+    /* the owner itself may be gone */
+    d = &h2Devs[H2DEV_INDEX(owner)];
+    if (__atomic_load_n(&d->devgen, __ATOMIC_RELAXED) != (unsigned int)owner)
+        return -1;
+    return __atomic_load_n(&d->ownerHead, __ATOMIC_ACQUIRE);
+}
+
+/**
+ ** First device still owned by owner from dev in its list
+ **/
+static int
+h2devOwnerSkip(int dev, int owner)
+{
+    H2_DEV_STR *d;
+
+    while (dev != -1) {
+        if (H2DEV_INDEX(dev) >= (unsigned int)h2devMapped &&
+            h2devExtend(H2DEV_INDEX(dev)) == ERROR)
+            return ERROR;
+        d = &h2Devs[H2DEV_INDEX(dev)];
+        if (__atomic_load_n(&d->owner, __ATOMIC_ACQUIRE) == owner &&
+            __atomic_load_n(&d->devgen, __ATOMIC_RELAXED) ==
+            (unsigned int)dev)
+            return dev;
+        dev = h2devOwnerLink(dev, owner);
+    }
+    return ERROR;
+}
+
+/**
+ ** First device owned by the task device owner, ERROR if there is none
+ **/
+int
+h2devOwnerFirst(int owner)
+{
+    if (h2devAttach(NULL) == ERROR ||
+        (H2DEV_INDEX(owner) >= (unsigned int)h2devMapped &&
+         h2devExtend(H2DEV_INDEX(owner)) == ERROR) ||
+        H2DEV_TYPE(owner) != H2_DEV_TYPE_TASK) {
+        return ERROR;
+    }
+    return h2devOwnerSkip(__atomic_load_n(
+        &h2Devs[H2DEV_INDEX(owner)].ownerHead, __ATOMIC_ACQUIRE), owner);
+}
+
+/**
+ ** Device owned by owner following dev, ERROR at the end of the list
+ **/
+int
+h2devOwnerNext(int dev, int owner)
+{
+    return h2devOwnerSkip(h2devOwnerLink(dev, owner), owner);
+}
+
+/*----------------------------------------------------------------------*/
+
 /**
  ** Allocation d'un device h2
  **/
@@ -70,34 +486,39 @@ h2devAllocAux(const char *name, H2_DEV_TYPE type, int h2devMax)
     int i;
 
     /* Verifie que le nom n'existe pas */
-    if (type != H2_DEV_TYPE_SEM && h2devFindAux(name, type, h2devMax) != ERROR) {
+    if (type != H2_DEV_TYPE_SEM && h2devFindAux(name, type) != ERROR) {
         errnoSet(S_h2devLib_DUPLICATE_DEVICE_NAME);
         return ERROR;
     }
     /* Recherche un device libre */
-    for (i = 0; i < h2devMax; i++) {
+    for (i = 0; ; i++) {
+        if (i == h2devMax) {
+            /* Pas de device libre: agrandit la table */
+            if (h2devGrow() == ERROR || h2devAttach(&h2devMax) == ERROR) {
+                return ERROR;
+            }
+        }
         if (h2Devs[i].type == H2_DEV_TYPE_NONE) {
             /* Trouve' */
-            if (snprintf(h2Devs[i].name, H2_DEV_MAX_NAME, "%s", name)
-                >= H2_DEV_MAX_NAME) {
+            if (strlen(name) >= H2_DEV_MAX_NAME) {
                 LOGDBG(("comLib:h2devAlloc: device name too long\n"));
                 errnoSet(S_h2devLib_BAD_PARAMETERS);
                 return ERROR;
             }
+            h2devWriteBegin(i);
             strncpy(h2Devs[i].name, name, H2_DEV_MAX_NAME-1);
             h2Devs[i].type = type;
             h2Devs[i].uid = getuid();
             /* increment previous generation number */
             h2Devs[i].devgen += 1 << (8*sizeof(int) - H2_DEV_GEN_BITS);
+            h2devWriteEnd(i);
+            h2devHashAdd(i);
+            h2devTypeAdd(i);
             LOGDBG(("comLib:h2devAlloc: created device %d (gen %d)\n", i,
                      H2DEV_GEN(h2Devs[i].devgen)));
             return H2DEV_BY_INDEX(i);
         }
     } /* for */
-
-    /* Pas de device libre */
-    errnoSet(S_h2devLib_FULL);
-    return ERROR;
 }
 
 int
@@ -109,9 +530,9 @@ h2devAlloc(const char *name, H2_DEV_TYPE type)
         return ERROR;
     }
 
-    h2semTake(0, WAIT_FOREVER);
+    h2semTake(H2SEM_DEV_LOCK, WAIT_FOREVER);
     i = h2devAllocAux(name, type, h2devMax);
-    h2semGive(0);
+    h2semGive(H2SEM_DEV_LOCK);
 
     return i;
 }
@@ -145,9 +566,17 @@ h2devFree(int dev)
         errnoSet(S_h2devLib_NOT_OWNER);
         return ERROR;
     }
-    h2semTake(0, WAIT_FOREVER);
-    H2DEV_TYPE(dev) = H2_DEV_TYPE_NONE;
-    h2semGive(0);
+    h2semTake(H2SEM_DEV_LOCK, WAIT_FOREVER);
+    if (H2DEV_TYPE(dev) != H2_DEV_TYPE_NONE) {
+        h2devHashRemove(H2DEV_INDEX(dev));
+        h2devTypeRemove(H2DEV_INDEX(dev));
+        h2devOwnerRemove(H2DEV_INDEX(dev));
+        h2devOwnerRelease(H2DEV_INDEX(dev));
+        h2devWriteBegin(H2DEV_INDEX(dev));
+        H2DEV_TYPE(dev) = H2_DEV_TYPE_NONE;
+        h2devWriteEnd(H2DEV_INDEX(dev));
+    }
+    h2semGive(H2SEM_DEV_LOCK);
     return OK;
 }
 
@@ -161,23 +590,26 @@ h2devFree(int dev)
 STATUS
 h2devClean(const char *name)
 {
-   int i, d, match = 0, h2devMax = 0;
+   int i, next, type, match = 0;
    unsigned char *pool;
 
-   if (h2devAttach(&h2devMax) == ERROR) {
+   if (h2devAttach(NULL) == ERROR) {
       return ERROR;
    }
    /* Look for devices */
-   for (d = 0; d < h2devMax; d++) {
-      i = H2DEV_BY_INDEX(d);
-      if (H2DEV_TYPE(i) != H2_DEV_TYPE_NONE &&
-          fnmatch(name, H2DEV_NAME(i), 0) == 0) {
+   for (type = H2_DEV_TYPE_NONE + 1; type < H2DEV_MAX_TYPES; type++)
+   for (i = h2devFirst(type); i != ERROR; i = next) {
+      next = h2devNext(i, type);
+      if (fnmatch(name, H2DEV_NAME(i), 0) == 0) {
          logMsg("Freeing %s\n", H2DEV_NAME(i));
          match++;
          switch (H2DEV_TYPE(i)) {
               case H2_DEV_TYPE_MBOX:
                  mboxDelete(i);
                  break;
+              case H2_DEV_TYPE_MBOXGRP:
+                 mboxGroupDelete(i);
+                 break;
               case H2_DEV_TYPE_POSTER:
                 pool = smObjGlobalToLocal(H2DEV_POSTER_POOL(i));
                 if (pool != NULL)
@@ -216,14 +648,27 @@ h2devClean(const char *name)
  **/
 
 static int
-h2devFindAux(const char *name, H2_DEV_TYPE type, int h2devMax)
+h2devFindAux(const char *name, H2_DEV_TYPE type)
 {
-    int i;
-
-    for (i = 0; i < h2devMax; i++) {
-        if ((type == h2Devs[i].type)
-            && (strcmp(name, h2Devs[i].name) == 0)) {
-          return H2DEV_BY_INDEX(i);
+    int n = H2_DEV_HASH_SLOTS;
+    unsigned int s = h2devHashName(name) % n;
+    int i, idx;
+    H2_DEV_STR snap;
+
+    for (i = 0; i < n; i++, s = (s + 1) % n) {
+        idx = __atomic_load_n(&h2devHash[s], __ATOMIC_ACQUIRE);
+        if (idx == 0)
+            break;
+        if (idx == H2_DEV_HASH_TOMB)
+            continue;
+        /* the device may have been added by another process */
+        if (idx > h2devMapped && h2devExtend(idx - 1) == ERROR)
+            continue;
+        if (h2devSnapshot(idx - 1, &snap) == ERROR)
+            continue;
+        if ((type == snap.type)
+            && (strcmp(name, snap.name) == 0)) {
+          return snap.devgen;
         }
     } /* for */
     return ERROR;
@@ -232,18 +677,17 @@ h2devFindAux(const char *name, H2_DEV_TYPE type, int h2devMax)
 int
 h2devFind(const char *name, H2_DEV_TYPE type)
 {
-    int i, h2devMax;
+    int i;
 
     if (name == NULL) {
         errnoSet(S_h2devLib_BAD_PARAMETERS);
         return ERROR;
     }
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
         return ERROR;
     }
-    h2semTake(0, H2DEV_TIMEOUT);
-    i = h2devFindAux(name, type, h2devMax);
-    h2semGive(0);
+    /* The name index can be searched without H2SEM_DEV_LOCK */
+    i = h2devFindAux(name, type);
 
     if (i != ERROR) {
         return i;
@@ -255,6 +699,57 @@ h2devFind(const char *name, H2_DEV_TYPE type)
 
 /*----------------------------------------------------------------------*/
 
+/**
+ ** Slow path of H2DEV_DEV(), for a device that is not mapped in this
+ ** process: maps the devices added by other processes, which takes the
+ ** process mutex of h2devExtend()
+ **/
+H2_DEV_STR *
+h2devExtendDev(unsigned int dev)
+{
+    unsigned int idx = H2DEV_INDEX(dev);
+
+    if ((idx < (unsigned int)h2devMapped || h2devExtend(idx) == OK)
+        && h2Devs[idx].devgen == dev) {
+        return &h2Devs[idx];
+    }
+    return &h2DevInvalid;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ ** Copy the name of a device, without taking H2SEM_DEV_LOCK
+ **/
+STATUS
+h2devGetName(int dev, char *name, size_t len)
+{
+    H2_DEV_STR snap;
+
+    if (h2devAttach(NULL) == ERROR) {
+        return ERROR;
+    }
+    if (H2DEV_INDEX(dev) >= (unsigned int)h2devMapped &&
+        h2devExtend(H2DEV_INDEX(dev)) == ERROR) {
+        errnoSet(S_h2devLib_NOT_FOUND);
+        return ERROR;
+    }
+    if (h2devSnapshot(H2DEV_INDEX(dev), &snap) == ERROR) {
+        return ERROR;
+    }
+    if (snap.devgen != (unsigned int)dev || snap.type == H2_DEV_TYPE_NONE) {
+        errnoSet(S_h2devLib_NOT_FOUND);
+        return ERROR;
+    }
+    if (snprintf(name, len, "%s", snap.name) >= (int)len) {
+        errnoSet(S_h2devLib_BAD_PARAMETERS);
+        return ERROR;
+    }
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
 /**
  ** Retourne le semId des semaphores
  **/
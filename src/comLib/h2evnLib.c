@@ -92,7 +92,7 @@ h2evnSusp(int timeout)
     }
 
     LOGDBG(("comLib:h2evnSusp: task %lx device %d\n", taskIdSelf(), dev));
-    return h2semTake(H2DEV_TASK_SEM_ID(dev), timeout);
+    return h2wakeTake(H2DEV_TASK_WAKE(dev), timeout);
 }
 
 
@@ -119,7 +119,7 @@ h2evnSignal(long taskId)
     }
 
     LOGDBG(("comLib:h2evnSignal: task %lx device %d\n", taskId, dev));
-    return(h2semGive(H2DEV_TASK_SEM_ID(dev)));
+    return(h2wakeGive(H2DEV_TASK_WAKE(dev)));
 }
 
 /***********************************************************************
@@ -132,5 +132,5 @@ h2evnClear(void)
 {
     unsigned long dev = taskGetUserData(0);
 
-    h2semFlush(H2DEV_TASK_SEM_ID(dev));
+    h2wakeFlush(H2DEV_TASK_WAKE(dev));
 }
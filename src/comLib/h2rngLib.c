@@ -30,15 +30,26 @@
 #include "pocolibs-config.h"
 
 #include <sys/types.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_SHM_OPEN
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #include <portLib.h>
 #include <taskLib.h>
 #include <errnoLib.h>
 #include <smMemLib.h>
+#include <h2devLib.h>
 #include <h2rngLib.h>
 
+#include "h2atomic.h"
+
 #define COMLIB_DEBUG_H2RNGLIB
 
 #ifdef COMLIB_DEBUG_H2RNGLIB
@@ -203,6 +214,579 @@
    )
 
 
+/*****************************************************************************
+*
+*   H2RNG_BLK_SIZE  -  Taille totale d'un block
+*
+*   Description :
+*   Nombre de bytes occupes dans le ring par un message de nbytes: nombre
+*   de bytes et id du block, message, caractere de fin et alignement.
+*/
+
+#define H2RNG_BLK_SIZE(nbytes)					\
+  ((int)((nbytes) + 2*sizeof(int) + 4 - ((nbytes) & 3)))
+
+
+/*****************************************************************************
+*
+*   H2RNG_BLK_PUBLISH  -  Publier un ou n blocks
+*
+*   Description :
+*   Compte les nouveaux blocks puis avance le pointeur d'ecriture. Le
+*   compteur est mis a jour avant, pour que nPut - nGet ne soit jamais
+*   negatif.
+*/
+
+#define H2RNG_BLK_PUBLISH_N(rngId, next, n)			\
+  (								\
+   H2_STORE_RELAXED(&(rngId)->nPut, (rngId)->nPut + (n)),	\
+   H2_STORE_REL(&(rngId)->pWr, (next))				\
+   )
+#define H2RNG_BLK_PUBLISH(rngId, next) H2RNG_BLK_PUBLISH_N(rngId, next, 1)
+
+
+/*****************************************************************************
+*
+*   H2RNG_BLK_CONSUME  -  Liberer un ou n blocks
+*
+*   Description :
+*   Avance le pointeur de lecture apres les blocks, puis les compte. La
+*   place liberee est d'abord remise a zero dans un ring MPSC.
+*/
+
+#define H2RNG_BLK_CONSUME_N(rngId, next, n)			\
+  (								\
+   h2rngBlockClear((rngId), (rngId)->pRd, (next)),		\
+   H2_STORE_REL(&(rngId)->pRd, (next)),				\
+   H2_STORE_REL(&(rngId)->nGet, (rngId)->nGet + (n))		\
+   )
+#define H2RNG_BLK_CONSUME(rngId, next) H2RNG_BLK_CONSUME_N(rngId, next, 1)
+
+
+/*****************************************************************************
+*
+*   H2RNG_BUF  -  Adresse des donnees d'un ring buffer
+*
+*   Description :
+*   Les donnees suivent l'en-tete dans smMem, sauf pour un ring
+*   H2RNG_FLAG_MIRROR: elles sont alors dans un objet POSIX shm projete
+*   deux fois de suite dans chaque processus, de sorte qu'un block ne
+*   soit jamais coupe en deux.
+*
+*   Retourne : adresse des donnees, ou NULL si la projection a echoue
+*/
+
+#define H2RNG_BUF(rngId)					\
+  (((rngId)->flags & H2RNG_FLAG_MIRROR) ?			\
+   h2rngMirrorBuf(rngId) : (char *) ((rngId)+1))
+
+#ifdef HAVE_SHM_OPEN
+
+/* Projection d'un ring miroir dans ce processus. The list only grows and
+ * is read without lock. Entries of deleted rings are reused: an entry is
+ * rewritten with h2rngMirrorMutex held and gen odd, so that readers
+ * skip it meanwhile. */
+typedef struct H2RNG_MIRROR {
+    unsigned int gen;		/* Impair pendant une mise a jour */
+    H2RNG_ID rngId;		/* Ring projete, NULL si libre */
+    int pid, seq;		/* Objet shm projete */
+    char *base;			/* Adresse des 2 projections */
+    size_t len;			/* Taille totale projetee */
+    struct H2RNG_MIRROR *next;
+} H2RNG_MIRROR;
+
+static H2RNG_MIRROR *h2rngMirrors = NULL;
+static pthread_mutex_t h2rngMirrorMutex = PTHREAD_MUTEX_INITIALIZER;
+static int h2rngMirrorSeq = 0;
+
+/* Nom de l'objet shm, parmi ceux des devices h2 */
+static void
+h2rngMirrorName(H2RNG_ID rngId, char *what, size_t len)
+{
+    snprintf(what, len, "rng.%d.%d", rngId->mirrorPid, rngId->mirrorSeq);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngMirrorFind  -  Chercher la projection d'un ring miroir
+*
+*   Retourne : adresse des donnees ou NULL
+*/
+
+static char *
+h2rngMirrorFind(H2RNG_ID rngId)
+{
+    H2RNG_MIRROR *m;
+    unsigned int gen;
+    char *base;
+
+    for (m = H2_LOAD_ACQ(&h2rngMirrors); m != NULL; m = m->next) {
+	gen = H2_LOAD_ACQ(&m->gen);
+	if ((gen & 1) || H2_LOAD_RELAXED(&m->rngId) != rngId ||
+	    H2_LOAD_RELAXED(&m->pid) != rngId->mirrorPid ||
+	    H2_LOAD_RELAXED(&m->seq) != rngId->mirrorSeq)
+	    continue;
+	base = H2_LOAD_RELAXED(&m->base);
+	H2_FENCE_ACQ();
+	if (H2_LOAD_RELAXED(&m->gen) == gen)
+	    return (base);
+    }
+    return (NULL);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngMirrorSet  -  Reecrire une entree de la liste des projections
+*
+*   Description :
+*   h2rngMirrorMutex doit etre pris. rngId NULL libere l'entree.
+*/
+
+static void
+h2rngMirrorSet(H2RNG_MIRROR *m, H2RNG_ID rngId, char *base, size_t len)
+{
+    H2_STORE_RELAXED(&m->gen, m->gen + 1);
+    H2_FENCE_REL();
+    H2_STORE_RELAXED(&m->rngId, rngId);
+    H2_STORE_RELAXED(&m->pid, rngId != NULL ? rngId->mirrorPid : 0);
+    H2_STORE_RELAXED(&m->seq, rngId != NULL ? rngId->mirrorSeq : 0);
+    H2_STORE_RELAXED(&m->base, base);
+    m->len = len;
+    H2_STORE_REL(&m->gen, m->gen + 1);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngMirrorAttach  -  Projeter les donnees d'un ring miroir
+*
+*   Description :
+*   Ouvre l'objet shm du ring (le cree si oflag contient O_CREAT) et le
+*   projette deux fois de suite, dans une entree de la liste du processus.
+*   Les projections des rings detruits par d'autres processus, dont
+*   l'en-tete ne designe plus le meme objet, sont liberees au passage.
+*
+*   Retourne : adresse des donnees ou NULL
+*/
+
+static char *
+h2rngMirrorAttach(H2RNG_ID rngId, int oflag)
+{
+    char what[32];
+    size_t size = rngId->size;
+    H2RNG_MIRROR *m, *ent = NULL, *added = NULL;
+    H2RNG_ID r;
+    char *base = NULL;
+    int fd;
+
+    pthread_mutex_lock(&h2rngMirrorMutex);
+
+    /* Deja projete par une autre tache du processus ? */
+    if ((base = h2rngMirrorFind(rngId)) != NULL) {
+	pthread_mutex_unlock(&h2rngMirrorMutex);
+	return (base);
+    }
+    for (m = h2rngMirrors; m != NULL; m = m->next) {
+	if ((r = m->rngId) != NULL &&
+	    (!(r->flags & H2RNG_FLAG_MIRROR) || r->mirrorPid != m->pid ||
+	     r->mirrorSeq != m->seq)) {
+	    munmap(m->base, m->len);
+	    h2rngMirrorSet(m, NULL, NULL, 0);
+	}
+	if (m->rngId == NULL && ent == NULL)
+	    ent = m;
+    }
+
+    h2rngMirrorName(rngId, what, sizeof(what));
+    if ((fd = h2devShmOpen(what, O_RDWR | oflag)) == ERROR)
+	goto fail;
+    if ((oflag & O_CREAT) && ftruncate(fd, size) < 0)
+	goto close;
+
+    /* Reserver 2 x size, puis y projeter 2 fois l'objet */
+    base = mmap(NULL, 2*size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+	base = NULL;
+	goto close;
+    }
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+	     fd, 0) == MAP_FAILED ||
+	mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+	     fd, 0) == MAP_FAILED ||
+	(ent == NULL && (ent = added = calloc(1, sizeof(*ent))) == NULL)) {
+	munmap(base, 2*size);
+	base = NULL;
+	goto close;
+    }
+    close(fd);
+
+    h2rngMirrorSet(ent, rngId, base, 2*size);
+    if (added != NULL) {
+	added->next = h2rngMirrors;
+	H2_STORE_REL(&h2rngMirrors, added);
+    }
+    pthread_mutex_unlock(&h2rngMirrorMutex);
+    return (base);
+
+  close:
+    close(fd);
+    if (oflag & O_CREAT)
+	h2devShmUnlink(what);
+  fail:
+    pthread_mutex_unlock(&h2rngMirrorMutex);
+    LOGDBG(("comLib:h2rngMirrorAttach: cannot map %s\n", what));
+    errnoSet (S_h2rngLib_MIRROR_ERROR);
+    return (NULL);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngMirrorBuf  -  Adresse des donnees d'un ring miroir
+*
+*   Retourne : adresse des donnees ou NULL
+*/
+
+static char *
+h2rngMirrorBuf(H2RNG_ID rngId)
+{
+    char *base;
+
+    if ((base = h2rngMirrorFind(rngId)) != NULL)
+	return (base);
+    return (h2rngMirrorAttach(rngId, 0));
+}
+
+
+/*****************************************************************************
+*
+*   h2rngMirrorDelete  -  Detruire les donnees d'un ring miroir
+*
+*   Description :
+*   Supprime la projection de ce processus et l'objet shm. Les autres
+*   processus gardent leur projection jusqu'a ce qu'ils projettent un
+*   autre ring miroir, ou jusqu'a leur fin.
+*/
+
+static void
+h2rngMirrorDelete(H2RNG_ID rngId)
+{
+    char what[32];
+    H2RNG_MIRROR *m;
+
+    pthread_mutex_lock(&h2rngMirrorMutex);
+    for (m = h2rngMirrors; m != NULL; m = m->next)
+	if (m->rngId == rngId && m->pid == rngId->mirrorPid &&
+	    m->seq == rngId->mirrorSeq) {
+	    munmap(m->base, m->len);
+	    h2rngMirrorSet(m, NULL, NULL, 0);
+	}
+    pthread_mutex_unlock(&h2rngMirrorMutex);
+
+    h2rngMirrorName(rngId, what, sizeof(what));
+    h2devShmUnlink(what);
+}
+
+#else
+
+static char *
+h2rngMirrorBuf(H2RNG_ID rngId)
+{
+    errnoSet (S_h2rngLib_MIRROR_ERROR);
+    return (NULL);
+}
+
+#endif /* HAVE_SHM_OPEN */
+
+
+/*****************************************************************************
+*
+*   h2rngBlockClear  -  Remettre a zero la place liberee d'un ring MPSC
+*
+*   Description :
+*   In a H2RNG_FLAG_MPSC ring, a block is committed by writing its
+*   number of bytes last, so free room must read as zero. The consumer
+*   clears the bytes from..to before giving them back to producers.
+*
+*   Retourne : Neant
+*/
+
+static void
+h2rngBlockClear(H2RNG_ID rngId, int from, int to)
+{
+    char *pDeb;
+
+    if (!(rngId->flags & H2RNG_FLAG_MPSC) || from == to ||
+	(pDeb = H2RNG_BUF(rngId)) == NULL)
+	return;
+    if (from < to)
+	memset(pDeb + from, 0, to - from);
+    else {
+	memset(pDeb + from, 0, rngId->size - from);
+	memset(pDeb, 0, to);
+    }
+}
+
+
+/*****************************************************************************
+*
+*   h2rngWrAt  -  Ecrire des bytes a une position du ring
+*
+*   Description :
+*   Ecrit nbytes a partir de la position pos, en revenant au debut du
+*   ring si necessaire (en une seule copie pour un ring miroir). Aucun
+*   pointeur du ring n'est modifie.
+*
+*   Retourne : position qui suit les bytes ecrits
+*/
+
+static int
+h2rngWrAt(H2RNG_ID rngId, int pos, const char *buf, int nbytes)
+{
+    char *pDeb = H2RNG_BUF(rngId);
+    int ntop = rngId->size - pos;
+
+    if (nbytes < ntop || (rngId->flags & H2RNG_FLAG_MIRROR)) {
+	memcpy (pDeb + pos, buf, nbytes);
+	return (nbytes < ntop ? pos + nbytes : nbytes - ntop);
+    }
+    memcpy (pDeb + pos, buf, ntop);
+    memcpy (pDeb, buf + ntop, nbytes - ntop);
+    return (nbytes - ntop);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngRdAt  -  Lire des bytes a une position du ring
+*
+*   Description :
+*   Lit nbytes a partir de la position pos, en revenant au debut du
+*   ring si necessaire. Aucun pointeur du ring n'est modifie.
+*
+*   Retourne : position qui suit les bytes lus
+*/
+
+static int
+h2rngRdAt(H2RNG_ID rngId, int pos, char *buf, int nbytes)
+{
+    char *pDeb = H2RNG_BUF(rngId);
+    int ntop = rngId->size - pos;
+
+    if (nbytes < ntop || (rngId->flags & H2RNG_FLAG_MIRROR)) {
+	memcpy (buf, pDeb + pos, nbytes);
+	return (nbytes < ntop ? pos + nbytes : nbytes - ntop);
+    }
+    memcpy (buf, pDeb + pos, ntop);
+    memcpy (buf + ntop, pDeb, nbytes - ntop);
+    return (nbytes - ntop);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngBlockPlace  -  Chercher la place pour un block
+*
+*   Description :
+*   Verifie qu'un block de nt bytes (taille totale) peut etre ecrit a la
+*   position pWr, compte tenu de la position de lecture pRd.
+*
+*   Retourne : TRUE et la position du block suivant dans *pNext, ou FALSE
+*/
+
+static BOOL
+h2rngBlockPlace(H2RNG_ID rngId, int pWr, int pRd, int nt, int *pNext)
+{
+    int ntop;
+
+    if (pRd <= pWr) {
+	/* Nombre de bytes libres jusqu'au top */
+	ntop = rngId->size - pWr;
+	if (ntop > nt) {
+	    *pNext = pWr + nt;
+	    return (TRUE);
+	}
+	/* Le block doit revenir au debut du ring */
+	if (nt > ntop + pRd - 2)
+	    return (FALSE);
+	*pNext = nt + pWr - rngId->size;
+	return (TRUE);
+    }
+    if (nt > pRd - pWr - 2)
+	return (FALSE);
+    *pNext = pWr + nt;
+    return (TRUE);
+}
+
+
+/*****************************************************************************
+*
+*   H2RNG_WR  -  Position d'ecriture et nombre de blocks d'un ring MPSC
+*
+*   Description :
+*   pWr et nPut se suivent dans l'entete du ring: les producteurs d'un
+*   ring MPSC les changent ensemble, par un seul compare and swap. nPut
+*   distingue ainsi deux passages de pWr a la meme position.
+*/
+
+typedef union {
+  struct {
+    int pWr;
+    unsigned int nPut;
+  } pos;
+  unsigned long long word;
+} H2RNG_WR;
+
+typedef char h2rngWrCheck[offsetof(H2RNG_HDR, nPut) ==
+			  offsetof(H2RNG_HDR, pWr) + sizeof(int) ? 1 : -1];
+
+
+/*****************************************************************************
+*
+*   h2rngMpscPut  -  Ecrire un block dans un ring MPSC
+*
+*   Description :
+*   Claims room for a block by moving pRsv with a compare and swap, then
+*   writes the id, the iovcnt segments of the message and the end
+*   character. The number of bytes is written last and marks the block
+*   as committed. Committed blocks are then published in ring order by
+*   whichever producer finds them first, so that a producer that is late
+*   to commit never blocks the others.
+*
+*   Retourne : nbytes, ou 0 s'il n'y a pas de place
+*/
+
+static int
+h2rngMpscPut(H2RNG_ID rngId, int idBlk, const struct iovec *iov, int iovcnt,
+	     int nbytes)
+{
+    char *pDeb = H2RNG_BUF(rngId);
+    unsigned long long *pWrPut = (unsigned long long *) &rngId->pWr;
+    H2RNG_WR wr, upd;
+    int size = rngId->size;
+    int pos, pRsv, pRd, next, n, i;
+    char car = H2RNG_CAR_END;
+
+    /* Reserver la place du block */
+    pRsv = H2_LOAD_ACQ(&rngId->pRsv);
+    do {
+	pRd = H2_LOAD_ACQ(&rngId->pRd);
+	if (!h2rngBlockPlace(rngId, pRsv, pRd, H2RNG_BLK_SIZE(nbytes),
+			     &next))
+	    return (0);
+    } while (!H2_CAS(&rngId->pRsv, &pRsv, next));
+
+    /* Ecrire le block, sauf son nombre de bytes */
+    if ((pos = pRsv + (int) sizeof(nbytes)) >= size)
+	pos -= size;
+    pos = h2rngWrAt(rngId, pos, (char *) &idBlk, sizeof(idBlk));
+    for (i = 0; i < iovcnt; i++)
+	pos = h2rngWrAt(rngId, pos, iov[i].iov_base, (int) iov[i].iov_len);
+    (void) h2rngWrAt(rngId, pos, &car, 1);
+
+    /* Le nombre de bytes valide le block */
+    H2_STORE_SEQ((int *) (pDeb + pRsv), nbytes);
+
+    /* Publier, dans l'ordre, les blocks valides. Le compare and swap
+       echoue si d'autres blocks ont ete publies depuis la lecture de pWr,
+       meme si pWr est revenu a la meme position */
+    wr.word = H2_LOAD_SEQ(pWrPut);
+    while (wr.pos.pWr != H2_LOAD_SEQ(&rngId->pRsv)) {
+	n = H2_LOAD_SEQ((int *) (pDeb + wr.pos.pWr));
+	if (n == 0) {
+	    /* Pas encore valide: son producteur le publiera, sauf si pWr a
+	       deja bouge */
+	    upd.word = H2_LOAD_SEQ(pWrPut);
+	    if (upd.word == wr.word)
+		break;
+	    wr = upd;
+	    continue;
+	}
+	upd = wr;
+	if ((upd.pos.pWr = wr.pos.pWr + H2RNG_BLK_SIZE(n)) >= size)
+	    upd.pos.pWr -= size;
+	upd.pos.nPut++;
+	if (H2_CAS(pWrPut, &wr.word, upd.word))
+	    wr = upd;
+    }
+    return (nbytes);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngBlockCount  -  Compter les blocks entre deux positions
+*
+*   Description :
+*   Parcourt les blocks de pRd a pWr, sans modifier le ring.
+*
+*   Retourne : nombre de blocks, ou ERROR si un block est incoherent
+*/
+
+static int
+h2rngBlockCount(H2RNG_ID rngId, int pRd, int pWr)
+{
+    int nbytes, nt, no, nblocks = 0;
+
+    if (H2RNG_BUF(rngId) == NULL)
+	return (ERROR);
+    while (pRd != pWr) {
+	if ((no = pWr - pRd) < 0)
+	    no += rngId->size;
+	if (no < sizeof(nbytes))
+	    return (ERROR);
+	(void) h2rngRdAt(rngId, pRd, (char *) &nbytes, sizeof(nbytes));
+	nt = H2RNG_BLK_SIZE(nbytes);
+	if (nbytes < 0 || nt > no)
+	    return (ERROR);
+	if ((pRd = pRd + nt) >= rngId->size)
+	    pRd -= rngId->size;
+	nblocks++;
+    }
+    return (nblocks);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngViewSet  -  Decrire les donnees d'un block
+*
+*   Description :
+*   Remplit les morceaux d'une vue sur les nbytes de donnees du block
+*   qui commence a la position pos.
+*
+*   Retourne : Neant
+*/
+
+static void
+h2rngViewSet(H2RNG_ID rngId, H2RNG_VIEW *view, int pos, int nbytes)
+{
+    char *pDeb = H2RNG_BUF(rngId);
+    int size = rngId->size;
+    int ntop;
+
+    /* Les donnees suivent le nombre de bytes et l'id du block */
+    pos += 2*sizeof(int);
+    if (pos >= size)
+	pos -= size;
+    ntop = size - pos;
+
+    view->nbytes = nbytes;
+    view->ptr[0] = pDeb + pos;
+    if (nbytes <= ntop || (rngId->flags & H2RNG_FLAG_MIRROR)) {
+	view->len[0] = nbytes;
+	view->ptr[1] = NULL;
+	view->len[1] = 0;
+    } else {
+	view->len[0] = ntop;
+	view->ptr[1] = pDeb;
+	view->len[1] = nbytes - ntop;
+    }
+}
+
+
 /*****************************************************************************
 *
 *   h2rngCreate  -  Creation d'un ring buffer inter-processeurs
@@ -216,6 +800,35 @@
 H2RNG_ID 
 h2rngCreate(int type,			/* Type du ring buffer */
 	    int nbytes)			/* Nombre de bytes */
+{
+    return h2rngCreateFlags(type, nbytes, 0);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngCreateFlags  -  Create a ring buffer with options
+*
+*   Description :
+*   Same as h2rngCreate(), with a set of H2RNG_FLAG_xxx options.
+*   H2RNG_FLAG_SPSC declares that the ring has exactly one producer and
+*   one consumer at any time, so that no external locking is needed: the
+*   read and write pointers are then only ever written by their owner,
+*   including by h2rngFlush().
+*   H2RNG_FLAG_MIRROR puts the data in a POSIX shared memory object
+*   mapped twice back to back in each process, so that blocks never
+*   wrap; the size is then rounded up to a multiple of the page size.
+*   H2RNG_FLAG_MPSC (block rings only) allows any number of concurrent
+*   producers without external locking, still with a single consumer.
+*   h2rngBlockReserve() cannot be used on such a ring.
+*
+*   Retourne : identificateur du ring buffer ou NULL
+*/
+
+H2RNG_ID
+h2rngCreateFlags(int type,		/* Type du ring buffer */
+		 int nbytes,		/* Nombre de bytes */
+		 int flags)		/* Options H2RNG_FLAG_xxx */
 {
     H2RNG_ID rngId;             /* Pointeur vers tete */
     int flgInit;                /* Flag d'initialisation */
@@ -226,6 +839,14 @@ h2rngCreate(int type,			/* Type du ring buffer */
 	return ((H2RNG_ID) NULL);
     }
 
+    /* Verifier les options */
+    if ((flags & ~(H2RNG_FLAG_SPSC | H2RNG_FLAG_MIRROR | H2RNG_FLAG_MPSC))
+	!= 0 || ((flags & H2RNG_FLAG_MPSC) &&
+		 ((flags & H2RNG_FLAG_SPSC) || type != H2RNG_TYPE_BLOCK))) {
+	errnoSet (S_h2rngLib_ILLEGAL_TYPE);
+	return ((H2RNG_ID) NULL);
+    }
+
     /* Verifier le type demande de ring buffer */
     switch (type) {
       case H2RNG_TYPE_BYTE:           /* Ring buffer type byte */
@@ -252,17 +873,44 @@ h2rngCreate(int type,			/* Type du ring buffer */
 	errnoSet (S_h2rngLib_ILLEGAL_TYPE);
 	return ((H2RNG_ID) NULL);
     } /* switch */
-    
+
+    if (flags & H2RNG_FLAG_MIRROR) {
+#ifdef HAVE_SHM_OPEN
+	long page = sysconf(_SC_PAGESIZE);
+
+	/* Les donnees sont hors de smMem, en pages entieres */
+	nbytes = (nbytes + page - 1) / page * page;
+	if ((rngId = (H2RNG_ID) smMemMalloc(sizeof (H2RNG_HDR))) == NULL)
+	    return ((H2RNG_ID) NULL);
+	memset(rngId, 0, sizeof(H2RNG_HDR));
+	rngId->size = nbytes;
+	rngId->flags = flags;
+	rngId->mirrorPid = getpid();
+	rngId->mirrorSeq = H2_ADD_RELAXED(&h2rngMirrorSeq, 1);
+	if (h2rngMirrorAttach(rngId, O_CREAT | O_EXCL) == NULL) {
+	    smMemFree ((char *) rngId);
+	    return ((H2RNG_ID) NULL);
+	}
+	rngId->flgInit = flgInit;
+	return (rngId);
+#else
+	errnoSet (S_h2rngLib_ILLEGAL_TYPE);
+	return ((H2RNG_ID) NULL);
+#endif
+    }
+
     /* Allouer memoire pour l'en-tete et pour le buffer */
     if ((rngId = (H2RNG_ID) 
 	 smMemMalloc ((size_t) (nbytes + sizeof (H2RNG_HDR)))) == NULL) {
 	return ((H2RNG_ID) NULL);
     }
     
-    /* Initialiser l' en-tete */
-    rngId->pRd = 0;
-    rngId->pWr = 0;
+    /* Initialiser l' en-tete (et les donnees d'un ring MPSC) */
+    memset(rngId, 0, sizeof(H2RNG_HDR));
+    if (flags & H2RNG_FLAG_MPSC)
+	memset(rngId + 1, 0, nbytes);
     rngId->size = nbytes;
+    rngId->flags = flags;
     rngId->flgInit = flgInit;
     
     /* Retourner le pointeur vers le ring buffer */
@@ -294,6 +942,12 @@ h2rngRealloc(H2RNG_ID rngId,		/* Ring buffer identifier */
         errnoSet(S_h2rngLib_ILLEGAL_NBYTES);
         return NULL;
     }
+    /* the mapping of mirrored rings cannot be moved, and producers of
+       MPSC rings do not take any lock */
+    if (rngId->flags & (H2RNG_FLAG_MIRROR | H2RNG_FLAG_MPSC)) {
+        errnoSet(S_h2rngLib_ILLEGAL_TYPE);
+        return NULL;
+    }
 
     /* compute actual ring buffer size */
     switch (rngId->flgInit) {
@@ -342,9 +996,11 @@ h2rngRealloc(H2RNG_ID rngId,		/* Ring buffer identifier */
     }
 
     /* initialize header */
-    newId->pRd = 0;
+    memset(newId, 0, sizeof(H2RNG_HDR));
     newId->pWr = used;
+    newId->nPut = rngId->nPut - rngId->nGet;
     newId->size = nbytes;
+    newId->flags = rngId->flags;
     newId->flgInit = rngId->flgInit;
 
     /* free old buffer */
@@ -374,9 +1030,27 @@ h2rngFlush(H2RNG_ID rngId)		/* Identificateur du ring buffer */
 	return (ERROR);
     }
     
+    /* Un ring SPSC ou MPSC est vide par le consommateur seul: pWr et
+       nPut appartiennent aux producteurs */
+    if (rngId->flags & (H2RNG_FLAG_SPSC | H2RNG_FLAG_MPSC)) {
+	int pWr = H2_LOAD_ACQ(&rngId->pWr);
+	int n = 0;
+
+	if (rngId->flgInit == H2RNG_INIT_BLOCK)
+	    n = h2rngBlockCount(rngId, rngId->pRd, pWr);
+	h2rngBlockClear(rngId, rngId->pRd, pWr);
+	H2_STORE_REL(&rngId->pRd, pWr);
+	if (n == ERROR)
+	    H2_STORE_REL(&rngId->nGet, H2_LOAD_ACQ(&rngId->nPut));
+	else
+	    H2_STORE_REL(&rngId->nGet, rngId->nGet + n);
+	return (OK);
+    }
+
     /* Reseter les pointeurs */
     rngId->pRd = 0;
     rngId->pWr = 0;
+    rngId->nGet = rngId->nPut;
     return (OK);
 }
 
@@ -400,6 +1074,7 @@ h2rngBufGet(H2RNG_ID rngId,		/* Identificateur du ring buffer */
 {
     int n1, n2, nbytes;                          
     int pWr, pRd;                 
+    char *pDeb;
     
     /* Retourner, si ring buffer non-initialise */
     if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BYTE) {
@@ -407,9 +1082,24 @@ h2rngBufGet(H2RNG_ID rngId,		/* Identificateur du ring buffer */
 	return (ERROR);
     }
 
+    /* Adresse des donnees */
+    if ((pDeb = H2RNG_BUF(rngId)) == NULL)
+	return (ERROR);
+
     /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-    pWr = rngId->pWr;
+    pWr = H2_LOAD_ACQ(&rngId->pWr);
     pRd = rngId->pRd;
+
+    /* Un ring miroir est lu d'une seule copie */
+    if (rngId->flags & H2RNG_FLAG_MIRROR) {
+	if ((nbytes = pWr - pRd) < 0)
+	    nbytes += rngId->size;
+	memcpy (buf, pDeb + pRd, nbytes = MIN(maxbytes, nbytes));
+	if ((pRd = pRd + nbytes) >= rngId->size)
+	    pRd -= rngId->size;
+	H2_STORE_REL(&rngId->pRd, pRd);
+	return (nbytes);
+    }
     
     /* Verifier si on doit faire la copie en deux morceaux */
     if ((n1 = pWr - pRd) < 0) {
@@ -422,214 +1112,713 @@ h2rngBufGet(H2RNG_ID rngId,		/* Identificateur du ring buffer */
 	/* Verifier si plus grand que nombre de bytes a lire */
 	if (n1 > nbytes) {
 	    /* Faire une seule copie */
-	    memcpy (buf, (char *) (rngId+1) + pRd, nbytes);
+	    memcpy (buf, pDeb + pRd, nbytes);
 	    
 	    /* Actualiser pointeur de lecture et retourner */
-	    rngId->pRd = pRd + nbytes;
+	    H2_STORE_REL(&rngId->pRd, pRd + nbytes);
 	    return (nbytes);
 	}
 	
 	/* Copier tout le premier morceau */
-	memcpy (buf, (char *) (rngId+1) + pRd, n1);
+	memcpy (buf, pDeb + pRd, n1);
 	
 	/* Taille du deuxieme morceau */
 	n2 = nbytes - n1;
 	
 	/* Copier le deuxieme morceau et retourner */
-	memcpy (buf+n1, (char *) (rngId+1), n2);
+	memcpy (buf+n1, pDeb, n2);
 	
 	/* Actualiser le pointeur de lecture et retourner */
-	rngId->pRd = n2;
+	H2_STORE_REL(&rngId->pRd, n2);
 	return (n1 + n2);
     }
     
     /* Copier tout, d'une seule fois */
-    memcpy (buf, (char *) (rngId+1) + pRd, n1 = MIN(maxbytes, n1));
+    memcpy (buf, pDeb + pRd, n1 = MIN(maxbytes, n1));
     
     /* Actualiser le pointeur de lecture et retourner */
-    rngId->pRd = pRd + n1;
+    H2_STORE_REL(&rngId->pRd, pRd + n1);
     return (n1);
 }
 
 
 
-/******************************************************************************
+/******************************************************************************
+*
+*   h2rngBufPut  -  Ecrire des bytes sur le ring buffer
+*
+*   Description :
+*   Copie le contenu du buffer de l'utilisateur sur le ring buffer.
+*   Le nombe specifie de bytes va etre mis dans le ring buffer, s'il y a
+*   de la place.
+*
+*   Retourne :
+*   Nombre de bytes effectivement copies.
+*/
+
+int 
+h2rngBufPut(H2RNG_ID rngId, /* Ring buffer ou mettre les bytes */    
+	    const char *buf, 	    /* Buffer a copier */                    
+	    int nbytes)	    /* Nombre de bytes a essayer de copier */
+{
+    int n1, n2;                          
+    int pWr, pRd;                 
+    char *pDeb;
+    
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BYTE) {
+	errnoSet (S_h2rngLib_NOT_A_BYTE_RING);
+	return (ERROR);
+    }
+    
+    /* Verifier si le nombre de bytes est positif */
+    if (nbytes <= 0) {
+	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+
+    /* Adresse des donnees */
+    if ((pDeb = H2RNG_BUF(rngId)) == NULL)
+	return (ERROR);
+    
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = rngId->pWr;
+    pRd = H2_LOAD_ACQ(&rngId->pRd);
+
+    /* Un ring miroir est ecrit d'une seule copie */
+    if (rngId->flags & H2RNG_FLAG_MIRROR) {
+	if ((n1 = pRd - pWr - 1) < 0)
+	    n1 += rngId->size;
+	memcpy (pDeb + pWr, buf, nbytes = MIN(nbytes, n1));
+	if ((pWr = pWr + nbytes) >= rngId->size)
+	    pWr -= rngId->size;
+	H2_STORE_REL(&rngId->pWr, pWr);
+	return (nbytes);
+    }
+    
+    /* Verifier l'etat des pointeurs */
+    if ((n1 = pRd - pWr) <= 0) {
+	/* Nombre de bytes a ecrire = min (pos.libres, nbytes) */
+	nbytes = MIN(n1 + rngId->size - 1, nbytes);
+	
+	/* Taille du premier morceau libre */
+	n1 = rngId->size - pWr;
+	
+	/* Verifier si plus grand que le nombre de bytes a ecrire */
+	if (n1 > nbytes) {
+	    /* Faire une seule copie */
+	    memcpy (pDeb + pWr, buf, nbytes);
+	    
+	    /* Actualiser pointeur d'ecriture et retourner */
+	    H2_STORE_REL(&rngId->pWr, pWr + nbytes);
+	    return (nbytes);
+	}
+	
+	/* Copier tout le premier morceau */
+	memcpy (pDeb + pWr, buf, n1);
+	
+	/* Taille du deuxieme morceau */
+	n2 = nbytes - n1;
+	
+	/* Copier le deuxieme morceau et retourner */
+	memcpy (pDeb, buf+n1, n2);
+	
+	/* Actualiser le pointeur d'ecriture et retourner */
+	H2_STORE_REL(&rngId->pWr, n2);
+	return (nbytes);
+    } 
+
+    /* Copier tout, d'une seule fois */
+    memcpy (pDeb + pWr, buf, nbytes = MIN(nbytes, n1 - 1));
+    
+    /* Actualiser le pointeur d'ecriture et retourner */
+    H2_STORE_REL(&rngId->pWr, pWr + nbytes);
+    return (nbytes);
+}
+
+
+
+/*****************************************************************************
+*
+*   h2rngBlockPut  -  Ecrire un block de caracteres sur un ring buffer
+*
+*   Description :
+*   Copie le contenu du buffer de l'utilisateur sur le ring buffer, sous
+*   le format de "block". Le overhead associe est de 9 ou 10 bytes, dependant
+*   de la taille du message. Le en-tete du message consiste du nombre de
+*   bytes du message, suivi d'un identificateur de block (fourni par 
+*   l'utilisateur).
+*
+*   Retourne :
+*   Taille du buffer de l'utilisateur, 0 s'il n'y a pas de place, ERROR si
+*   pas un ring buffer type block
+*/
+ 
+int 
+h2rngBlockPut(H2RNG_ID rngId,       /* Ring buffer ou mettre les bytes */    
+	      int idBlk,            /* Identificateur du block */            
+	      const char *buf,      /* Buffer a copier */                    
+	      int nbytes)           /* Nombre de bytes a essayer de copier */
+{
+    int ntop, nt, n;
+    struct iovec iov;
+    int pWr, pRd, size;                 
+    char *pTo;
+    char *pDeb;
+    
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+    
+    /* Verifier si le nombre de bytes est positif */
+    if (nbytes <= 0) {
+	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+
+    /* Adresse des donnees */
+    if ((pDeb = H2RNG_BUF(rngId)) == NULL)
+	return (ERROR);
+    
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = rngId->pWr;
+    pRd = H2_LOAD_ACQ(&rngId->pRd);
+
+    /* Calculer la taille totale du block a ecrire */
+    nt = nbytes + sizeof(nbytes) + sizeof(idBlk) + 4 - (nbytes & 3);
+  
+    /* Plusieurs producteurs sans verrou */
+    if (rngId->flags & H2RNG_FLAG_MPSC) {
+	iov.iov_base = (char *) buf;
+	iov.iov_len = nbytes;
+	return (h2rngMpscPut(rngId, idBlk, &iov, 1, nbytes));
+    }
+
+    /* Obtenir le ptr vers 1ere position libre du ring */
+    pTo = pDeb + pWr;
+
+    /* Un block d'un ring miroir est toujours ecrit d'un seul morceau */
+    if (rngId->flags & H2RNG_FLAG_MIRROR) {
+	if (!h2rngBlockPlace(rngId, pWr, pRd, nt, &n))
+	    return (0);
+	BLK_WR1(pTo, idBlk, buf, nbytes);
+	H2RNG_BLK_PUBLISH(rngId, n);
+	return (nbytes);
+    }
+    
+    /* Verifier l'etat des pointeurs */
+    if (pRd <= pWr) {
+	/* Obtenir la taille du ring */
+	size = rngId->size;
+	
+	/* Nombre de bytes libres jusqu'au top */
+	ntop = size - pWr;
+	
+	/* Verifier si plus grand que le nombre de bytes a ecrire */
+	if (ntop > nt) {
+	    /* Ecrire le block */
+	    BLK_WR1(pTo, idBlk, buf, nbytes);
+	    
+	    /* Actualiser pointeur d'ecriture et retourner */
+	    H2RNG_BLK_PUBLISH(rngId, pWr + nt);
+	    return (nbytes);
+	}
+	
+	/* Sinon, verifier si on peut ecrire le block */
+	if (nt > ntop + pRd - 2)
+	    return (0);
+	
+	/* Ecrire en 2 parties */
+	BLK_WR2(pTo, idBlk, buf, nbytes, ntop, pDeb);
+	
+	/* Actualiser le pointeur d'ecriture et retourner */
+	H2RNG_BLK_PUBLISH(rngId, nt + pWr - size);
+	return (nbytes);
+    }
+    
+    /* Calculer le nombre de bytes libres */
+    ntop = pRd - pWr - 2;
+    
+    /* Retourner 0, s'il n'y a pas de place */
+    if (nt > ntop)
+	return (0);
+    
+    /* Copier tout le block, d'une seule fois */
+    BLK_WR1(pTo, idBlk, buf, nbytes);
+
+    /* Actualiser le pointeur d'ecriture et retourner */
+    H2RNG_BLK_PUBLISH(rngId, pWr + nt);
+    return (nbytes);
+}
+
+
+
+/*****************************************************************************
+*
+*   h2rngBlockPutV  -  Ecrire un block a partir de plusieurs buffers
+*
+*   Description :
+*   Like h2rngBlockPut(), but the message is gathered from the iovcnt
+*   segments of iov, which are written one after the other in a single
+*   block. The consumer sees one message of the total size.
+*
+*   Retourne :
+*   Taille totale du message, 0 s'il n'y a pas de place, ERROR si pas un
+*   ring buffer type block
+*/
+
+int
+h2rngBlockPutV(H2RNG_ID rngId,		/* Ring buffer ou mettre le block */
+	       int idBlk,		/* Identificateur du block */
+	       const struct iovec *iov,	/* Segments a copier */
+	       int iovcnt)		/* Nombre de segments */
+{
+    int pWr, pRd, pos, next, nbytes, i;
+    char car = H2RNG_CAR_END;
+
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+
+    /* Taille totale du message, qui doit etre positive */
+    for (i = 0, nbytes = 0; i < iovcnt; i++) {
+	if (iov[i].iov_len > rngId->size) {
+	    errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	    return (ERROR);
+	}
+	nbytes += (int) iov[i].iov_len;
+    }
+    if (nbytes <= 0 || nbytes > rngId->size) {
+	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+    if (H2RNG_BUF(rngId) == NULL)
+	return (ERROR);
+    if (rngId->flags & H2RNG_FLAG_MPSC)
+	return (h2rngMpscPut(rngId, idBlk, iov, iovcnt, nbytes));
+
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = rngId->pWr;
+    pRd = H2_LOAD_ACQ(&rngId->pRd);
+
+    if (!h2rngBlockPlace(rngId, pWr, pRd, H2RNG_BLK_SIZE(nbytes), &next))
+	return (0);
+
+    /* Ecrire l'en-tete, les segments et le caractere de fin */
+    pos = h2rngWrAt(rngId, pWr, (char *) &nbytes, sizeof(nbytes));
+    pos = h2rngWrAt(rngId, pos, (char *) &idBlk, sizeof(idBlk));
+    for (i = 0; i < iovcnt; i++)
+	pos = h2rngWrAt(rngId, pos, iov[i].iov_base, (int) iov[i].iov_len);
+    (void) h2rngWrAt(rngId, pos, &car, 1);
+
+    /* Actualiser le pointeur d'ecriture et retourner */
+    H2RNG_BLK_PUBLISH(rngId, next);
+    return (nbytes);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngBlockPutN  -  Ecrire plusieurs blocks sur un ring buffer
+*
+*   Description :
+*   Writes nBlocks messages (bufs[i], of nbytes[i] bytes each) as
+*   consecutive blocks with the same id. The write pointer is advanced
+*   once, after the last block that fits, so that the consumer sees the
+*   whole batch at once.
+*
+*   Retourne :
+*   Nombre de blocks ecrits (0 s'il n'y a pas de place), ERROR si pas un
+*   ring buffer type block
+*/
+
+int
+h2rngBlockPutN(H2RNG_ID rngId,		/* Ring buffer ou mettre les blocks */
+	       int idBlk,		/* Identificateur des blocks */
+	       int nBlocks,		/* Nombre de blocks */
+	       char * const *bufs,	/* Buffers a copier */
+	       const int *nbytes)	/* Taille de chaque buffer */
+{
+    int pWr, pRd, pos, next, k;
+    struct iovec iov;
+    char car = H2RNG_CAR_END;
+
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+
+    /* Verifier si les nombres de bytes sont positifs */
+    for (k = 0; k < nBlocks; k++)
+	if (nbytes[k] <= 0) {
+	    errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	    return (ERROR);
+	}
+    if (H2RNG_BUF(rngId) == NULL)
+	return (ERROR);
+
+    /* Plusieurs producteurs: chaque block est reserve a son tour */
+    if (rngId->flags & H2RNG_FLAG_MPSC) {
+	for (k = 0; k < nBlocks; k++) {
+	    iov.iov_base = bufs[k];
+	    iov.iov_len = nbytes[k];
+	    if (h2rngMpscPut(rngId, idBlk, &iov, 1, nbytes[k]) == 0)
+		break;
+	}
+	return (k);
+    }
+
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = rngId->pWr;
+    pRd = H2_LOAD_ACQ(&rngId->pRd);
+
+    for (k = 0; k < nBlocks; k++) {
+	if (!h2rngBlockPlace(rngId, pWr, pRd, H2RNG_BLK_SIZE(nbytes[k]),
+			     &next))
+	    break;
+
+	/* Ecrire l'en-tete, le message et le caractere de fin */
+	pos = h2rngWrAt(rngId, pWr, (char *) &nbytes[k], sizeof(nbytes[k]));
+	pos = h2rngWrAt(rngId, pos, (char *) &idBlk, sizeof(idBlk));
+	pos = h2rngWrAt(rngId, pos, bufs[k], nbytes[k]);
+	(void) h2rngWrAt(rngId, pos, &car, 1);
+	pWr = next;
+    }
+
+    /* Rendre visibles tous les blocks ecrits */
+    if (k > 0)
+	H2RNG_BLK_PUBLISH_N(rngId, pWr, k);
+    return (k);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngBlockReserve  -  Reserve room for a block, without copy
+*
+*   Description :
+*   Reserves room for a message of nbytes in the ring buffer, and fills
+*   view with the address of the reserved data (in one or two pieces if
+*   the room wraps at the end of the ring). The caller then writes the
+*   message directly into the ring and calls h2rngBlockCommit() to make
+*   it visible to the consumer. Nothing is changed in the ring until the
+*   commit, so a reservation that is not committed is simply dropped.
+*   Only one reservation per ring may be pending at a time.
+*
+*   Retourne :
+*   nbytes, 0 s'il n'y a pas de place, ERROR si pas un ring buffer type block
+*/
+
+int
+h2rngBlockReserve(H2RNG_ID rngId,	/* Ring buffer ou mettre le block */
+		  int nbytes,		/* Taille du message */
+		  H2RNG_VIEW *view)	/* Ou` mettre la zone reservee */
+{
+    int pWr, pRd, next;
+
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+
+    /* Verifier si le nombre de bytes est positif */
+    if (nbytes <= 0) {
+	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+    if (H2RNG_BUF(rngId) == NULL)
+	return (ERROR);
+
+    /* Une reservation bloquerait les autres producteurs d'un ring MPSC */
+    if (rngId->flags & H2RNG_FLAG_MPSC) {
+	errnoSet (S_h2rngLib_ILLEGAL_TYPE);
+	return (ERROR);
+    }
+
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = rngId->pWr;
+    pRd = H2_LOAD_ACQ(&rngId->pRd);
+
+    if (!h2rngBlockPlace(rngId, pWr, pRd, H2RNG_BLK_SIZE(nbytes), &next))
+	return (0);
+
+    view->id = 0;
+    view->pos = pWr;
+    view->next = next;
+    h2rngViewSet(rngId, view, pWr, nbytes);
+    return (nbytes);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngBlockCommit  -  Publish a block written through h2rngBlockReserve
+*
+*   Description :
+*   Writes the header of a block reserved by h2rngBlockReserve() and
+*   advances the write pointer. nbytes may be smaller than the reserved
+*   size, if the producer finally used less room.
+*
+*   Retourne : OK ou ERROR
+*/
+
+STATUS
+h2rngBlockCommit(H2RNG_ID rngId,	/* Ring buffer du block */
+		 int idBlk,		/* Identificateur du block */
+		 int nbytes,		/* Taille finale du message */
+		 H2RNG_VIEW *view)	/* Zone reservee */
+{
+    int pos, next;
+    char car = H2RNG_CAR_END;
+
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+
+    /* La reservation doit correspondre au pointeur d'ecriture */
+    if (view == NULL || view->pos != rngId->pWr) {
+	errnoSet (S_h2rngLib_ERR_SYNC);
+	return (ERROR);
+    }
+    if (nbytes <= 0 || nbytes > view->nbytes) {
+	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+
+    /* Ecrire l'en-tete et le caractere de fin */
+    pos = h2rngWrAt(rngId, view->pos, (char *) &nbytes, sizeof(nbytes));
+    pos = h2rngWrAt(rngId, pos, (char *) &idBlk, sizeof(idBlk));
+    if ((pos = pos + nbytes) >= rngId->size)
+	pos -= rngId->size;
+    (void) h2rngWrAt(rngId, pos, &car, 1);
+
+    /* Position du block suivant */
+    if ((next = view->pos + H2RNG_BLK_SIZE(nbytes)) >= rngId->size)
+	next -= rngId->size;
+    view->id = idBlk;
+    view->nbytes = nbytes;
+    view->next = next;
+
+    /* Publier le block */
+    H2RNG_BLK_PUBLISH(rngId, next);
+    return (OK);
+}
+
+
+/*****************************************************************************
+*
+*   h2rngBlockPeek  -  Look at the next block, without copy
+*
+*   Description :
+*   Checks the next block of the ring buffer and fills view with its id,
+*   size and the address of its data (in one or two pieces if it wraps).
+*   The block stays in the ring, and its data may be used in place until
+*   h2rngBlockRelease() is called. Like h2rngBlockGet(), the ring is
+*   flushed if the block is corrupted.
+*
+*   Retourne : nombre de bytes du message, 0 si ring vide, ou ERROR.
+*/
+
+int
+h2rngBlockPeek(H2RNG_ID rngId,		/* Identificateur du ring buffer */
+	       H2RNG_VIEW *view)	/* Ou` mettre la vue sur le block */
+{
+    int nbytes, idBlk, nt, no, pos;
+    int pWr, pRd, size;
+    char car;
+
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+    if (H2RNG_BUF(rngId) == NULL)
+	return (ERROR);
+
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = H2_LOAD_ACQ(&rngId->pWr);
+    pRd = rngId->pRd;
+
+    /* Retourner, s'il n'y a pas de message */
+    if (pWr == pRd)
+	return (0);
+
+    /* Nombre de bytes occupes */
+    size = rngId->size;
+    if ((no = pWr - pRd) < 0)
+	no += size;
+    if (no < sizeof(nbytes)) {
+	errnoSet (S_h2rngLib_SMALL_BLOCK);
+	(void) h2rngFlush (rngId);
+	return (ERROR);
+    }
+
+    /* Lire l'en-tete du block */
+    pos = h2rngRdAt(rngId, pRd, (char *) &nbytes, sizeof(nbytes));
+    nt = H2RNG_BLK_SIZE(nbytes);
+    if (nbytes < 0 || nt > no) {
+	errnoSet (S_h2rngLib_BIG_BLOCK);
+	(void) h2rngFlush (rngId);
+	return (ERROR);
+    }
+    pos = h2rngRdAt(rngId, pos, (char *) &idBlk, sizeof(idBlk));
+
+    /* Verifier le caractere de fin de message */
+    if ((pos = pos + nbytes) >= size)
+	pos -= size;
+    (void) h2rngRdAt(rngId, pos, &car, 1);
+    if (car != H2RNG_CAR_END) {
+	errnoSet (S_h2rngLib_ERR_SYNC);
+	(void) h2rngFlush (rngId);
+	return (ERROR);
+    }
+
+    view->id = idBlk;
+    view->pos = pRd;
+    if ((view->next = pRd + nt) >= size)
+	view->next -= size;
+    h2rngViewSet(rngId, view, pRd, nbytes);
+    return (nbytes);
+}
+
+
+/*****************************************************************************
 *
-*   h2rngBufPut  -  Ecrire des bytes sur le ring buffer
+*   h2rngBlockRelease  -  Remove a block obtained by h2rngBlockPeek
 *
 *   Description :
-*   Copie le contenu du buffer de l'utilisateur sur le ring buffer.
-*   Le nombe specifie de bytes va etre mis dans le ring buffer, s'il y a
-*   de la place.
+*   Advances the read pointer past the block described by view. The data
+*   of the block must not be used anymore after this call.
 *
-*   Retourne :
-*   Nombre de bytes effectivement copies.
+*   Retourne : OK ou ERROR
 */
 
-int 
-h2rngBufPut(H2RNG_ID rngId, /* Ring buffer ou mettre les bytes */    
-	    const char *buf, 	    /* Buffer a copier */                    
-	    int nbytes)	    /* Nombre de bytes a essayer de copier */
+STATUS
+h2rngBlockRelease(H2RNG_ID rngId,	/* Identificateur du ring buffer */
+		  H2RNG_VIEW *view)	/* Block obtenu par h2rngBlockPeek */
 {
-    int n1, n2;                          
-    int pWr, pRd;                 
-    
     /* Retourner, si ring buffer non-initialise */
-    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BYTE) {
-	errnoSet (S_h2rngLib_NOT_A_BYTE_RING);
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
 	return (ERROR);
     }
-    
-    /* Verifier si le nombre de bytes est positif */
-    if (nbytes <= 0) {
-	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+
+    /* Le block doit etre le premier du ring */
+    if (view == NULL || view->pos != rngId->pRd) {
+	errnoSet (S_h2rngLib_ERR_SYNC);
 	return (ERROR);
     }
-    
-    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-    pWr = rngId->pWr;
-    pRd = rngId->pRd;
-    
-    /* Verifier l'etat des pointeurs */
-    if ((n1 = pRd - pWr) <= 0) {
-	/* Nombre de bytes a ecrire = min (pos.libres, nbytes) */
-	nbytes = MIN(n1 + rngId->size - 1, nbytes);
-	
-	/* Taille du premier morceau libre */
-	n1 = rngId->size - pWr;
-	
-	/* Verifier si plus grand que le nombre de bytes a ecrire */
-	if (n1 > nbytes) {
-	    /* Faire une seule copie */
-	    memcpy ((char *) (rngId+1) + pWr, buf, nbytes);
-	    
-	    /* Actualiser pointeur d'ecriture et retourner */
-	    rngId->pWr = pWr + nbytes;
-	    return (nbytes);
-	}
-	
-	/* Copier tout le premier morceau */
-	memcpy ((char *) (rngId+1) + pWr, buf, n1);
-	
-	/* Taille du deuxieme morceau */
-	n2 = nbytes - n1;
-	
-	/* Copier le deuxieme morceau et retourner */
-	memcpy ((char *) (rngId+1), buf+n1, n2);
-	
-	/* Actualiser le pointeur d'ecriture et retourner */
-	rngId->pWr = n2;
-	return (nbytes);
-    } 
-
-    /* Copier tout, d'une seule fois */
-    memcpy ((char *) (rngId+1) + pWr, buf, nbytes = MIN(nbytes, n1 - 1));
-    
-    /* Actualiser le pointeur d'ecriture et retourner */
-    rngId->pWr = pWr + nbytes;
-    return (nbytes);
+    H2RNG_BLK_CONSUME(rngId, view->next);
+    return (OK);
 }
 
 
-
 /*****************************************************************************
 *
-*   h2rngBlockPut  -  Ecrire un block de caracteres sur un ring buffer
+*   h2rngBlockFind  -  Look for the newest unread block with a given id
 *
 *   Description :
-*   Copie le contenu du buffer de l'utilisateur sur le ring buffer, sous
-*   le format de "block". Le overhead associe est de 9 ou 10 bytes, dependant
-*   de la taille du message. Le en-tete du message consiste du nombre de
-*   bytes du message, suivi d'un identificateur de block (fourni par 
-*   l'utilisateur).
+*   Walks the blocks between the read and the write pointers and fills
+*   view with the last one whose id is idBlk, so that its data may be
+*   overwritten in place. The caller must make sure that no reader
+*   removes blocks during the walk and while the view is in use.
 *
-*   Retourne :
-*   Taille du buffer de l'utilisateur, 0 s'il n'y a pas de place, ERROR si
-*   pas un ring buffer type block
+*   Retourne : nombre de bytes du block, 0 si aucun block n'a cet id,
+*   ou ERROR si le ring est incoherent.
 */
- 
-int 
-h2rngBlockPut(H2RNG_ID rngId,       /* Ring buffer ou mettre les bytes */    
-	      int idBlk,            /* Identificateur du block */            
-	      const char *buf,      /* Buffer a copier */                    
-	      int nbytes)           /* Nombre de bytes a essayer de copier */
+
+int
+h2rngBlockFind(H2RNG_ID rngId,		/* Identificateur du ring buffer */
+	       int idBlk,		/* Identificateur cherche */
+	       H2RNG_VIEW *view)	/* Ou` mettre la vue sur le block */
 {
-    int ntop, nt, n;
-    int pWr, pRd, size;                 
-    char *pTo;
-    char *pDeb;
-    
+    int nbytes, id, nt, no, pos;
+    int pWr, pRd, size, found = 0;
+
     /* Retourner, si ring buffer non-initialise */
     if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
 	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
 	return (ERROR);
     }
-    
-    /* Verifier si le nombre de bytes est positif */
-    if (nbytes <= 0) {
-	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+    if (H2RNG_BUF(rngId) == NULL)
 	return (ERROR);
-    }
-    
-    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-    pWr = rngId->pWr;
-    pRd = rngId->pRd;
 
-    /* Calculer la taille totale du block a ecrire */
-    nt = nbytes + sizeof(nbytes) + sizeof(idBlk) + 4 - (nbytes & 3);
-  
-    /* Obtenir le ptr vers 1ere position libre du ring */
-    pTo = (char *) (rngId+1) + pWr;
-    
-    /* Verifier l'etat des pointeurs */
-    if (pRd <= pWr) {
-	/* Obtenir la taille du ring */
-	size = rngId->size;
-	
-	/* Nombre de bytes libres jusqu'au top */
-	ntop = size - pWr;
-	
-	/* Verifier si plus grand que le nombre de bytes a ecrire */
-	if (ntop > nt) {
-	    /* Ecrire le block */
-	    BLK_WR1(pTo, idBlk, buf, nbytes);
-	    
-	    /* Actualiser pointeur d'ecriture et retourner */
-	    rngId->pWr = pWr + nt;
-	    return (nbytes);
+    pWr = H2_LOAD_ACQ(&rngId->pWr);
+    pRd = H2_LOAD_ACQ(&rngId->pRd);
+    size = rngId->size;
+
+    while (pRd != pWr) {
+	if ((no = pWr - pRd) < 0)
+	    no += size;
+	if (no < 2*sizeof(int)) {
+	    errnoSet (S_h2rngLib_SMALL_BLOCK);
+	    return (ERROR);
 	}
-	
-	/* Sinon, verifier si on peut ecrire le block */
-	if (nt > ntop + pRd - 2)
-	    return (0);
-	
-	/* Calculer le pointeur vers le debut du ring */
-	pDeb = (char *) (rngId+1);
-	
-	/* Ecrire en 2 parties */
-	BLK_WR2(pTo, idBlk, buf, nbytes, ntop, pDeb);
-	
-	/* Actualiser le pointeur d'ecriture et retourner */
-	rngId->pWr = nt + pWr - size;
-	return (nbytes);
+	pos = h2rngRdAt(rngId, pRd, (char *) &nbytes, sizeof(nbytes));
+	nt = H2RNG_BLK_SIZE(nbytes);
+	if (nbytes < 0 || nt > no) {
+	    errnoSet (S_h2rngLib_BIG_BLOCK);
+	    return (ERROR);
+	}
+	(void) h2rngRdAt(rngId, pos, (char *) &id, sizeof(id));
+	if (id == idBlk) {
+	    view->id = id;
+	    view->pos = pRd;
+	    if ((view->next = pRd + nt) >= size)
+		view->next -= size;
+	    h2rngViewSet(rngId, view, pRd, nbytes);
+	    found = 1;
+	}
+	if ((pRd = pRd + nt) >= size)
+	    pRd -= size;
     }
-    
-    /* Calculer le nombre de bytes libres */
-    ntop = pRd - pWr - 2;
-    
-    /* Retourner 0, s'il n'y a pas de place */
-    if (nt > ntop)
-	return (0);
-    
-    /* Copier tout le block, d'une seule fois */
-    BLK_WR1(pTo, idBlk, buf, nbytes);
-
-    /* Actualiser le pointeur d'ecriture et retourner */
-    rngId->pWr = pWr + nt;
-    return (nbytes);
+    return (found ? view->nbytes : 0);
 }
 
 
+/*****************************************************************************
+*
+*   h2rngViewCopy  -  Copy data out of a block view
+*
+*   Description :
+*   Copies at most maxbytes of the data described by view, starting at
+*   offset, into buf.
+*
+*   Retourne : nombre de bytes copies
+*/
+
+int
+h2rngViewCopy(const H2RNG_VIEW *view,	/* Vue sur un block */
+	      int offset,		/* Premier byte a copier */
+	      char *buf,		/* Buffer utilisateur */
+	      int maxbytes)		/* Nombre max. de bytes a copier */
+{
+    int n, n1;
+
+    if (offset < 0 || offset >= view->nbytes || maxbytes <= 0)
+	return (0);
+    n = MIN(maxbytes, view->nbytes - offset);
+
+    /* Partie dans le premier morceau */
+    if (offset < view->len[0]) {
+	n1 = MIN(n, view->len[0] - offset);
+	memcpy (buf, view->ptr[0] + offset, n1);
+	if (n1 < n)
+	    memcpy (buf + n1, view->ptr[1], n - n1);
+	return (n);
+    }
+    memcpy (buf, view->ptr[1] + offset - view->len[0], n);
+    return (n);
+}
+
 
 /*****************************************************************************
 *
@@ -658,9 +1847,13 @@ h2rngBlockGet(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
 	return (ERROR);
     }
+
+    /* Adresse des donnees */
+    if ((pDeb = H2RNG_BUF(rngId)) == NULL)
+	return (ERROR);
     
     /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-    pWr = rngId->pWr;
+    pWr = H2_LOAD_ACQ(&rngId->pWr);
     pRd = rngId->pRd;
     
     /* Retourner, s'il n'y a pas de message */
@@ -668,10 +1861,11 @@ h2rngBlockGet(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	return (0);
     
     /* Calculer le pointeur vers 1ere position a lire */
-    pFrom = (char *) (rngId+1) + pRd;
+    pFrom = pDeb + pRd;
     
-    /* Verifier l'etat des pointeurs */
-    if (pRd > pWr) {
+    /* Verifier l'etat des pointeurs (un block d'un ring miroir est
+       toujours lu d'un seul morceau) */
+    if (pRd > pWr && !(rngId->flags & H2RNG_FLAG_MIRROR)) {
 	/* Obtenir la taille du ring */
 	size = rngId->size;
 	
@@ -681,8 +1875,6 @@ h2rngBlockGet(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	/* Nombre total de bytes occupes */
 	no = ntop + pWr;
 	
-	/* Calculer le pointeur vers le debut du ring */
-	pDeb = (char *) (rngId+1);
 	
 	/* Verifier si le nombre de bytes occupes est insuffisant */
 	if (no < sizeof(nbytes)) {
@@ -728,15 +1920,16 @@ h2rngBlockGet(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	
 	/* Actualiser le pointeur de lecture */
 	if ((pRd = pRd + nt) >= size)
-	    rngId->pRd = pRd - size;
-	else rngId->pRd = pRd;
+	    pRd = pRd - size;
+	H2RNG_BLK_CONSUME(rngId, pRd);
 	
 	/* Retourner le nombre de bytes */
 	return (nbytes);
     }
   
     /* Calculer le nombre de bytes occupes */
-    no = pWr - pRd;
+    if ((no = pWr - pRd) < 0)
+	no += rngId->size;
 
     /* Verifier si nombre de bytes occupes est trop petit */
     if (no < sizeof(nbytes)) {
@@ -779,11 +1972,113 @@ h2rngBlockGet(H2RNG_ID rngId, /* Identificateur du ring buffer */
     }
     
     /* Actualiser le pointeur de lecture et retourner */
-    rngId->pRd = pRd + nt;
+    if ((pRd = pRd + nt) >= rngId->size)
+	pRd -= rngId->size;
+    H2RNG_BLK_CONSUME(rngId, pRd);
     return (nbytes);
 }
   
 
+/*****************************************************************************
+*
+*    h2rngBlockGetN  -  Get several blocks at once
+*
+*    Description :
+*    Reads up to maxBlocks blocks from the ring buffer. Block i is copied
+*    into bufs[i], which can hold maxbytes, its id is stored in pidBlk[i]
+*    (if pidBlk is not NULL) and its size in pnbytes[i]. The pointers of
+*    the ring are read once for the whole batch and the read pointer is
+*    advanced once at the end. The batch stops before a block which does
+*    not fit in maxbytes; that block is then reported as an error by the
+*    next call, like h2rngBlockGet() would do.
+*
+*    Retourne : nombre de blocks lus, 0 si le ring est vide, ou ERROR.
+*/
+
+int
+h2rngBlockGetN(H2RNG_ID rngId,	/* Identificateur du ring buffer */
+	       int maxBlocks,	/* Nombre max. de blocks a lire */
+	       int *pidBlk,	/* Ou` mettre les ids des blocks */
+	       int *pnbytes,	/* Ou` mettre les tailles des messages */
+	       char **bufs,	/* Buffers utilisateur */
+	       int maxbytes)	/* Taille de chaque buffer */
+{
+    int nbytes, idBlk, nt, no, pos, k;
+    int pWr, pRd, size;
+    int err = 0;
+    char car;
+
+    /* Retourner, si ring buffer non-initialise */
+    if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK) {
+	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
+	return (ERROR);
+    }
+    if (maxBlocks <= 0) {
+	errnoSet (S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+    if (H2RNG_BUF(rngId) == NULL)
+	return (ERROR);
+
+    /* Valeurs congelees des pointeurs d'ecriture et de lecture */
+    pWr = H2_LOAD_ACQ(&rngId->pWr);
+    pRd = rngId->pRd;
+    size = rngId->size;
+
+    for (k = 0; k < maxBlocks && pRd != pWr; k++) {
+	/* Nombre de bytes occupes */
+	if ((no = pWr - pRd) < 0)
+	    no += size;
+	if (no < sizeof(nbytes)) {
+	    err = S_h2rngLib_SMALL_BLOCK;
+	    break;
+	}
+
+	/* Lire le nombre de bytes du message */
+	pos = h2rngRdAt(rngId, pRd, (char *) &nbytes, sizeof(nbytes));
+	nt = H2RNG_BLK_SIZE(nbytes);
+	if (nbytes < 0 || nt > no) {
+	    err = S_h2rngLib_BIG_BLOCK;
+	    break;
+	}
+	if (nbytes > maxbytes) {
+	    err = S_h2rngLib_SMALL_BUF;
+	    break;
+	}
+
+	/* Lire l'id du block et le message */
+	pos = h2rngRdAt(rngId, pos, (char *) &idBlk, sizeof(idBlk));
+	pos = h2rngRdAt(rngId, pos, bufs[k], nbytes);
+
+	/* Verifier le caractere de fin de message */
+	(void) h2rngRdAt(rngId, pos, &car, 1);
+	if (car != H2RNG_CAR_END) {
+	    err = S_h2rngLib_ERR_SYNC;
+	    break;
+	}
+	if (pidBlk != NULL)
+	    pidBlk[k] = idBlk;
+	pnbytes[k] = nbytes;
+
+	/* Block suivant */
+	if ((pRd = pRd + nt) >= size)
+	    pRd -= size;
+    }
+
+    /* Les blocks deja lus sont rendus, l'erreur sera vue au prochain appel */
+    if (k > 0) {
+	H2RNG_BLK_CONSUME_N(rngId, pRd, k);
+	return (k);
+    }
+    if (err != 0) {
+	errnoSet (err);
+	(void) h2rngFlush (rngId);
+	return (ERROR);
+    }
+    return (0);
+}
+
+
 /*****************************************************************************
 *
 *    h2rngBlockSpy  -  Espionner le contenu du ring buffer
@@ -814,9 +2109,13 @@ h2rngBlockSpy(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	errnoSet (S_h2rngLib_NOT_A_BLOCK_RING);
 	return (ERROR);
     }
+
+    /* Adresse des donnees */
+    if ((pDeb = H2RNG_BUF(rngId)) == NULL)
+	return (ERROR);
     
     /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-    pWr = rngId->pWr;
+    pWr = H2_LOAD_ACQ(&rngId->pWr);
     pRd = rngId->pRd;
     
     /* Retourner, s'il n'y a pas de message */
@@ -824,10 +2123,11 @@ h2rngBlockSpy(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	return (0);
     
     /* Calculer le pointeur vers 1ere position a lire */
-    pFrom = (char *) (rngId+1) + pRd;
+    pFrom = pDeb + pRd;
     
-    /* Verifier l'etat des pointeurs */
-    if (pRd > pWr) {
+    /* Verifier l'etat des pointeurs (un block d'un ring miroir est
+       toujours lu d'un seul morceau) */
+    if (pRd > pWr && !(rngId->flags & H2RNG_FLAG_MIRROR)) {
 	/* Obtenir la taille du ring */
 	size = rngId->size;
 	
@@ -837,8 +2137,6 @@ h2rngBlockSpy(H2RNG_ID rngId, /* Identificateur du ring buffer */
 	/* Nombre total de bytes occupes */
 	no = ntop + pWr;
 	
-	/* Calculer le pointeur vers le debut du ring */
-	pDeb = (char *) (rngId+1);
 
 	/* Verifier si le nombre de bytes occupes est insuffisant */
 	if (no < sizeof(nbytes)) {
@@ -879,7 +2177,8 @@ h2rngBlockSpy(H2RNG_ID rngId, /* Identificateur du ring buffer */
     }
   
     /* Calculer le nombre de bytes occupes */
-    no = pWr - pRd;
+    if ((no = pWr - pRd) < 0)
+	no += rngId->size;
 
     /* Verifier si nombre de bytes occupes est trop petit */
     if (no < sizeof(nbytes)) {
@@ -939,7 +2238,7 @@ h2rngIsEmpty(H2RNG_ID rngId) /* Identificateur du ring buffer */
     }
     
     /* Ring buffer est vide si les pointeurs sont egaux */
-    return (rngId->pWr == rngId->pRd);
+    return (H2_LOAD_ACQ(&rngId->pWr) == H2_LOAD_ACQ(&rngId->pRd));
 }
 
 
@@ -964,7 +2263,7 @@ h2rngIsFull(H2RNG_ID rngId)
       return ERROR;
   }
   /* Determine l'ecart entre les pointeurs de lecture et d'ecriture */
-  dp = rngId->pRd - rngId->pWr;
+  dp = H2_LOAD_ACQ(&rngId->pRd) - H2_LOAD_ACQ(&rngId->pWr);
 
   /* Verifier le type du ring buffer */
   switch (rngId->flgInit)
@@ -1012,7 +2311,7 @@ h2rngFreeBytes(H2RNG_ID rngId)
   }
 
   /* Ecart entre pointeurs */
-  dp = rngId->pRd - rngId->pWr;
+  dp = H2_LOAD_ACQ(&rngId->pRd) - H2_LOAD_ACQ(&rngId->pWr);
 
   /* Verifier le type du ring buffer */
   switch (rngId->flgInit)
@@ -1067,7 +2366,7 @@ h2rngNBytes(H2RNG_ID rngId)
     }
 
   /* Ecart entre pointeurs */
-  dp = rngId->pWr - rngId->pRd;
+  dp = H2_LOAD_ACQ(&rngId->pWr) - H2_LOAD_ACQ(&rngId->pRd);
 
   /* Calculer le nombre de bytes occupes */
   if (dp >= 0)
@@ -1083,7 +2382,7 @@ h2rngNBytes(H2RNG_ID rngId)
 *
 *   Description :
 *   Cette procedure donne comme reponse le nombre de blocks dans un ring
-*   type block.
+*   type block, a partir des compteurs de blocks ecrits et lus.
 *
 *   Retourne : nombre de blocks ou ERROR.
 */
@@ -1091,10 +2390,8 @@ h2rngNBytes(H2RNG_ID rngId)
 int 
 h2rngNBlocks(H2RNG_ID rngId)
 {
-  int nbytes, ntop, nt, no, n, nblocks;
-  int pWr, pRd, size;                 
-  char *pFrom;
-  char *pDeb;
+  unsigned int nGet;
+  int n;
 
   /* Retourner, si ring buffer non-initialise */
   if (rngId == NULL || rngId->flgInit != H2RNG_INIT_BLOCK)
@@ -1103,93 +2400,10 @@ h2rngNBlocks(H2RNG_ID rngId)
       return (ERROR);
     }
 
-  /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-  pWr = rngId->pWr;
-  pRd = rngId->pRd;
-
-  /* Obtenir la taille du ring */
-  size = rngId->size;
-      
-  /* Calculer le pointeur vers le debut du ring */
-  pDeb = (char *) (rngId+1);
-
-  /* Boucler et compter le nombre total de blocks dans le ring */
-  for (nblocks = 0; ; nblocks++)
-    {
-      /* Calculer le pointeur vers 1ere position a lire */
-      pFrom = (char *) (rngId+1) + pRd;
-
-      /* Verifier l'etat des pointeurs */
-      if (pRd > pWr)
-	{
-	  /* Nombre de bytes occupes jusqu'au top */
-	  ntop = size - pRd;
-      
-	  /* Nombre total de bytes occupes */
-	  no = ntop + pWr;
-
-	  /* Verifier si le nombre de bytes occupes est insuffisant */
-	  if (no < sizeof(nbytes)) {
-	    if (no == 0) {            /* Pas de message */
-	      return (nblocks);
-	    } else {                    /* Erreur */ 
-		errnoSet (S_h2rngLib_SMALL_BLOCK);
-		(void) h2rngFlush (rngId);
-		return (ERROR);
-	      }
-	  }
-	  /* Lire le nombre de bytes du message ("net") */
-	  H2RNG_RD2(pFrom,
-		    (char *) &nbytes, sizeof(nbytes), ntop, n, pDeb);
-
-	  /* Calculer la taille totale du message */
-	  nt = nbytes + sizeof(nbytes) + 8 - (nbytes & 3);
-
-	  /* Verifier si compatible avec le nombre de bytes occupes */
-	  if (nt > no)
-	    {
-	      errnoSet (S_h2rngLib_BIG_BLOCK);
-	      (void) h2rngFlush (rngId);
-	      return (ERROR);
-	    }
-
-	  /* Actualiser le pointeur de lecture et continuer */
-	  if ((pRd = pRd + nt) >= size)
-	    pRd = pRd - size;
-	  continue;
-	}
-  
-      /* Calculer le nombre de bytes occupes */
-      no = pWr - pRd;
-
-      /* Verifier si nombre de bytes occupes est trop petit */
-      if (no < sizeof(nbytes)) {
-	if (no == 0) {             /* Pas de message */
-	    return (nblocks);
-	} else {
-	    errnoSet (S_h2rngLib_SMALL_BLOCK);
-	    (void) h2rngFlush (rngId);
-	    return (ERROR);
-	}
-      }
-      /* Lire le nombre de bytes du message */
-      H2RNG_RD1(pFrom, (char *) &nbytes, sizeof(nbytes));
-
-      /* Calculer la taille totale du block */
-      nt = nbytes + sizeof(nbytes) + 8 - (nbytes & 3);
-
-      /* Verifier si compatible avec le nombre de bytes occupes */
-      if (nt > no)
-	{
-	  errnoSet (S_h2rngLib_BIG_BLOCK);
-	  (void) h2rngFlush (rngId);
-	  return (ERROR);
-	}
-
-      /* Actualiser le pointeur de lecture et continuer */
-      pRd = pRd + nt;
-      continue;
-    }
+  /* nGet d'abord: un block lu a toujours ete compte dans nPut */
+  nGet = H2_LOAD_ACQ(&rngId->nGet);
+  n = (int) (H2_LOAD_ACQ(&rngId->nPut) - nGet);
+  return (MAX(n, 0));
 }
   
 
@@ -1219,21 +2433,23 @@ h2rngBlockSkip(H2RNG_ID rngId)
       return (ERROR);
     }
 
+  /* Adresse des donnees */
+  if ((pDeb = H2RNG_BUF(rngId)) == NULL)
+    return (ERROR);
+
   /* Valeurs congelees des pointeurs d'ecriture et de lecture */
-  pWr = rngId->pWr;
+  pWr = H2_LOAD_ACQ(&rngId->pWr);
   pRd = rngId->pRd;
 
   /* Obtenir la taille du ring */
   size = rngId->size;
       
-  /* Calculer le pointeur vers le debut du ring */
-  pDeb = (char *) (rngId+1);
-
   /* Calculer le pointeur vers 1ere position a lire */
-  pFrom = (char *) (rngId+1) + pRd;
+  pFrom = pDeb + pRd;
 
-  /* Verifier l'etat des pointeurs */
-  if (pRd > pWr)
+  /* Verifier l'etat des pointeurs (un block d'un ring miroir est
+     toujours lu d'un seul morceau) */
+  if (pRd > pWr && !(rngId->flags & H2RNG_FLAG_MIRROR))
     {
       /* Nombre de bytes occupes jusqu'au top */
       ntop = size - pRd;
@@ -1269,12 +2485,13 @@ h2rngBlockSkip(H2RNG_ID rngId)
       /* Actualiser le pointeur de lecture et retourner */
       if ((pRd = pRd + nt) >= size)
 	pRd = pRd - size;
-      rngId->pRd = pRd;
+      H2RNG_BLK_CONSUME(rngId, pRd);
       return (OK);
     }
   
   /* Calculer le nombre de bytes occupes */
-  no = pWr - pRd;
+  if ((no = pWr - pRd) < 0)
+    no += size;
 
   /* Verifier si nombre de bytes occupes est trop petit */
   if (no < sizeof(nbytes)) {
@@ -1301,7 +2518,9 @@ h2rngBlockSkip(H2RNG_ID rngId)
     }
 
   /* Actualiser le pointeur de lecture et retourner */
-  rngId->pRd = pRd + nt;
+  if ((pRd = pRd + nt) >= size)
+    pRd -= size;
+  H2RNG_BLK_CONSUME(rngId, pRd);
   return (OK);
 }
   
@@ -1325,7 +2544,13 @@ h2rngDelete(H2RNG_ID rngId)
     }
     /* Reseter le flag d'initialisation */
     rngId->flgInit = 0;
-    
+
+#ifdef HAVE_SHM_OPEN
+    /* Detruire les donnees d'un ring miroir */
+    if (rngId->flags & H2RNG_FLAG_MIRROR)
+	h2rngMirrorDelete(rngId);
+#endif
+
     /* Liberer le pool de memoire */
     smMemFree ((char *) rngId);
 }
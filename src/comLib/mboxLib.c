@@ -16,7 +16,11 @@
 
 #include "pocolibs-config.h"
 
+#include <sys/param.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -28,8 +32,12 @@
 #include "h2semLib.h"
 #include "h2rngLib.h"
 #include "h2errorLib.h"
+#include "h2timeLib.h"
 #include "mboxLib.h"
 #include "smObjLib.h"
+#include "smMemLib.h"
+
+#include "h2atomic.h"
 
 static const H2_ERROR mboxLibH2errMsgs[] = MBOX_LIB_H2_ERR_MSGS;
 static const H2_ERROR h2rngLibH2errMsgs[] = H2_RNG_LIB_H2_ERR_MSGS;
@@ -40,6 +48,39 @@ static const H2_ERROR h2rngLibH2errMsgs[] = H2_RNG_LIB_H2_ERR_MSGS;
 # define LOGDBG(x)
 #endif
 
+/* Mailboxes whose senders do not take the mutex semaphore */
+#define MBOX_LOCK_FREE(id) \
+    (H2DEV_MBOX_FLAGS(id) & (MBOX_FLAG_SPSC | MBOX_FLAG_MPSC))
+
+/* Senders may overwrite unread messages of conflating mailboxes, or
+   replace the ring buffer of growing ones: their readers take the mutex
+   semaphore too */
+#define MBOX_RCV_EXCL (MBOX_FLAG_CONFLATE | MBOX_FLAG_GROW)
+#define MBOX_RCV_LOCK(id)						\
+    (!(H2DEV_MBOX_FLAGS(id) & MBOX_RCV_EXCL) ||				\
+     h2semTake(H2DEV_MBOX_SEM_EXCL_ID(id), WAIT_FOREVER) == TRUE)
+#define MBOX_RCV_UNLOCK(id)						\
+    do {								\
+	if (H2DEV_MBOX_FLAGS(id) & MBOX_RCV_EXCL)			\
+	    h2semGive(H2DEV_MBOX_SEM_EXCL_ID(id));			\
+    } while (0)
+
+/* Number of the first message sent (the nPut counter of its ring read
+   before the write), for mboxStatSent(): unknown to the lock-free
+   senders of MBOX_FLAG_MPSC mailboxes */
+#define MBOX_STAT_SEQ(id, pSeq)						\
+    ((H2DEV_MBOX_FLAGS(id) & MBOX_FLAG_MPSC) ? NULL : (pSeq))
+
+/* Smallest block of a ring buffer: its number of bytes, its id and the
+   end character, aligned. Bounds the number of messages in a lane */
+#define MBOX_BLK_MIN (2 * (int)sizeof(int) + 4)
+
+/* Local functions prototypes */
+static BOOL mboxNotEmpty(MBOX_ID mboxId);
+static STATUS mboxGroupDrop(MBOX_ID grpId, long task);
+static H2_MBOXGRP_SUB *mboxGroupSub(H2_MBOXGRP_STR *grp, long task);
+static BOOL mboxGroupReady(MBOX_ID grpId, long task, BOOL other);
+
 /*----------------------------------------------------------------------*/
 
 /**
@@ -54,7 +95,7 @@ mboxInit(const char *procName)		/* unused parameter procName */
 {
     long tid = taskIdSelf();
     const char *tName;
-    int dev;
+    int dev, i;
 
     /* record error msgs */
     h2recordErrMsgs("mboxInit", "h2rngLib", M_h2rngLib, 			
@@ -92,6 +133,12 @@ mboxInit(const char *procName)		/* unused parameter procName */
             LOGDBG(("mboxInit:h2semAlloc failed %d\n", errnoGet()));
 	    return ERROR;
 	}
+	h2wakeInit(H2DEV_TASK_WAKE(dev), H2DEV_TASK_SEM_ID(dev));
+	/* Empty ready set */
+	H2DEV_TASK_MBOX_READY(dev) = 0;
+	H2DEV_TASK_NMBOX_OTHER(dev) = 0;
+	for (i = 0; i < H2_TASK_MAX_MBOX; i++)
+	    H2DEV_TASK_MBOX(dev, i) = ERROR;
 	/* Store the device index in the user data of this task */
 	taskSetUserData(0, dev);
 	LOGDBG(("comLib:mboxInitSelf: initialized for task %lx\n", tid));
@@ -114,7 +161,7 @@ STATUS
 mboxEnd(long taskId)
 {
     const char *tName;
-    int i, d;
+    int i, next;
     long dev;
 
     if (taskId == 0) {
@@ -131,12 +178,17 @@ mboxEnd(long taskId)
     }
 
     /* Free all mailboxes attached to this task */
-    for (d = 0; d < h2devSize(); d++) {
-        i = H2DEV_BY_INDEX(d);
+    for (i = h2devOwnerFirst(dev); i != ERROR; i = next) {
+	next = h2devOwnerNext(i, dev);
 	if (H2DEV_TYPE(i) == H2_DEV_TYPE_MBOX
-	    && H2DEV_MBOX_TASK_ID(i) == dev) {
+	    && H2DEV_MBOX_TASK_ID(i) == dev)
 	    mboxDelete(i);
-	}
+    }
+    /* and leave the groups it subscribed to */
+    for (i = h2devFirst(H2_DEV_TYPE_MBOXGRP); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_MBOXGRP)) {
+	if (mboxGroupSub(H2DEV_MBOXGRP_STR(i), dev) != NULL)
+	    mboxGroupDrop(i, dev);
     }
     /* Free the global synchronisation semaphore of the task */
     h2semDelete(H2DEV_TASK_SEM_ID(dev));
@@ -147,6 +199,427 @@ mboxEnd(long taskId)
 
 /*----------------------------------------------------------------------*/
 
+/**
+ **  mboxLane  -  Local address of the ring buffer of a priority lane
+ **/
+
+static H2RNG_ID
+mboxLane(MBOX_ID mboxId, int prio)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(mboxId);
+
+    return (H2RNG_ID)smObjGlobalToLocal(
+	prio == 0 ? mbox->rngId : mbox->rngPrio[prio - 1]);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxRcvLane  -  Highest priority lane holding a message
+ **
+ **  Returns: the lane, or 0 if all lanes are empty
+ **/
+
+static int
+mboxRcvLane(MBOX_ID mboxId)
+{
+    int prio;
+
+    for (prio = H2DEV_MBOX_STR(mboxId)->nPrio - 1; prio > 0; prio--)
+	if (h2rngNBytes(mboxLane(mboxId, prio)) > 0)
+	    break;
+    return prio;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxTaskSlotAlloc  -  Register a device in the ready set of a task
+ **
+ **  Description:
+ **  Takes a free slot in the mailbox table of the task for a mailbox it
+ **  owns or a group it subscribed to. When all slots are used, the device
+ **  is only counted and mboxPauseAll() falls back to scanning the h2
+ **  devices for it.
+ **
+ **  Returns: the slot, or -1
+ **/
+
+static int
+mboxTaskSlotAlloc(long task, MBOX_ID id)
+{
+    int i, free;
+
+    if (task == ERROR || H2DEV_TYPE(task) != H2_DEV_TYPE_TASK)
+	return -1;
+    for (i = 0; i < H2_TASK_MAX_MBOX; i++) {
+	free = ERROR;
+	if (H2_CAS(&H2DEV_TASK_MBOX(task, i), &free, id))
+	    return i;
+    }
+    H2_ADD_SEQ(&H2DEV_TASK_NMBOX_OTHER(task), 1);
+    return -1;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxTaskSlotFree  -  Remove a device from the ready set of a task
+ **/
+
+static void
+mboxTaskSlotFree(long task, MBOX_ID id, int slot)
+{
+    int self = id;
+
+    if (task == ERROR || H2DEV_TYPE(task) != H2_DEV_TYPE_TASK)
+	return;
+    if (slot < 0) {
+	H2_SUB_SEQ(&H2DEV_TASK_NMBOX_OTHER(task), 1);
+	return;
+    }
+    if (H2_CAS(&H2DEV_TASK_MBOX(task, slot), &self, ERROR))
+	H2_AND_SEQ(&H2DEV_TASK_MBOX_READY(task), ~(1U << slot));
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSlotAlloc  -  Register a new mailbox in the ready set of its owner
+ **/
+
+static void
+mboxSlotAlloc(MBOX_ID mboxId)
+{
+    H2DEV_MBOX_SLOT(mboxId) =
+	mboxTaskSlotAlloc(H2DEV_MBOX_TASK_ID(mboxId), mboxId);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSlotFree  -  Remove a mailbox from the ready set of its owner
+ **/
+
+static void
+mboxSlotFree(MBOX_ID mboxId)
+{
+    mboxTaskSlotFree(H2DEV_MBOX_TASK_ID(mboxId), mboxId,
+	H2DEV_MBOX_SLOT(mboxId));
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxStatUsec  -  Current date in microseconds, for the latency stamps
+ **/
+
+static unsigned int
+mboxStatUsec(void)
+{
+    H2TIMESPEC ts;
+
+    if (h2GetTimeSpec(&ts) == ERROR)
+	return 0;
+    return (unsigned int)ts.tv_sec * 1000000U
+	+ (unsigned int)(ts.tv_nsec / 1000);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxStampNew  -  Allocate the send dates of a MBOX_FLAG_LATENCY mailbox
+ **
+ **  Description:
+ **  Sizes the send dates of each lane after its ring buffer of size
+ **  bytes, so that no two queued messages share an entry. The number of
+ **  entries per lane is stored in pN. The table is installed by
+ **  mboxStampSet(), once the ring buffers are in place.
+ **
+ **  Returns: the table or NULL
+ **/
+
+static H2_MBOX_STAMP *
+mboxStampNew(MBOX_ID mboxId, int size, int *pN)
+{
+    int n;
+
+    for (n = 1; n < size / MBOX_BLK_MIN + 1; n *= 2)
+	;
+    *pN = n;
+    return smMemCalloc((size_t)n * H2DEV_MBOX_STR(mboxId)->nPrio,
+		       sizeof(H2_MBOX_STAMP));
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxStampSet  -  Install the send dates of a mailbox
+ **
+ **  Description:
+ **  Replaces the send dates of the mailbox by the table new of n entries
+ **  per lane from mboxStampNew(). The dates of the queued messages are
+ **  kept: h2rngRealloc() renumbered those of lane 0 from 0, renum being
+ **  the former number of the first one. Called with the mutex semaphore
+ **  held, or before the mailbox is used.
+ **/
+
+static void
+mboxStampSet(MBOX_ID mboxId, H2_MBOX_STAMP *new, int n, unsigned int renum)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(mboxId);
+    H2_MBOX_STAMP *old, *st;
+    H2RNG_ID rid;
+    unsigned int seq, from;
+    int prio;
+
+    old = (H2_MBOX_STAMP *)smObjGlobalToLocal(mbox->stamp);
+    for (prio = 0; old != NULL && prio < mbox->nPrio; prio++) {
+	rid = mboxLane(mboxId, prio);
+	for (seq = rid->nGet; seq != rid->nPut; seq++) {
+	    from = prio == 0 ? seq + renum : seq;
+	    st = &old[prio * mbox->nStamp + from % mbox->nStamp];
+	    if (st->tag != H2_MBOX_STAMP_TAG(from, prio))
+		continue;
+	    new[prio * n + seq % n].usec = st->usec;
+	    new[prio * n + seq % n].tag = H2_MBOX_STAMP_TAG(seq, prio);
+	}
+    }
+    mbox->stamp = (H2_MBOX_STAMP *)smObjLocalToGlobal(new);
+    mbox->nStamp = n;
+    if (old != NULL)
+	smMemFree(old);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxStatSent  -  Account for messages sent to a mailbox
+ **
+ **  Description:
+ **  Called by the senders after nMsgs messages (nbytes in total) were
+ **  written in lane prio. If pSeq is not NULL, it holds the number of the
+ **  first of these messages in the lane (the nPut counter of its ring
+ **  before the write), and their send date is stamped for mboxStatRcvd().
+ **  Lock-free senders of MBOX_FLAG_MPSC mailboxes cannot know this number
+ **  and pass NULL.
+ **/
+
+static void
+mboxStatSent(MBOX_ID toId, int prio, const unsigned int *pSeq, int nMsgs,
+	     int nbytes)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(toId);
+    H2_MBOX_STAMP *st;
+    unsigned int used, hw, now, seq;
+    int i;
+
+    H2_ADD_RELAXED(&mbox->stats.sentMsgs, nMsgs);
+    H2_ADD_RELAXED(&mbox->stats.sentBytes, nbytes);
+
+    used = h2rngNBytes(mboxLane(toId, prio));
+    hw = H2_LOAD_RELAXED(&mbox->stats.highWater);
+    while ((int)used > 0 && used > hw &&
+	   !H2_CAS_RELAXED(&mbox->stats.highWater, &hw, used))
+	;
+
+    if (pSeq == NULL || mbox->stamp == NULL)
+	return;
+    now = mboxStatUsec();
+    for (i = 0; i < nMsgs; i++) {
+	seq = *pSeq + i;
+	st = (H2_MBOX_STAMP *)smObjGlobalToLocal(mbox->stamp)
+	    + prio * mbox->nStamp + seq % mbox->nStamp;
+	/* invalidate the entry while it is rewritten */
+	H2_STORE_RELAXED(&st->tag, 0);
+	H2_FENCE_REL();
+	H2_STORE_RELAXED(&st->usec, now);
+	H2_STORE_REL(&st->tag, H2_MBOX_STAMP_TAG(seq, prio));
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxStatRcvd  -  Account for messages received from a mailbox
+ **
+ **  Description:
+ **  Called by the reader after nMsgs messages (nbytes in total) were
+ **  removed from lane prio, seq being the nGet counter of its ring
+ **  before the read, with the receive lock of the mailbox still held.
+ **  Messages whose send date was stamped are added to the latency
+ **  histogram.
+ **/
+
+static void
+mboxStatRcvd(MBOX_ID mboxId, int prio, unsigned int seq, int nMsgs,
+	     int nbytes)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(mboxId);
+    H2_MBOX_STAMP *st;
+    unsigned int now, tag, usec, lat;
+    int i, b;
+
+    H2_ADD_RELAXED(&mbox->stats.rcvMsgs, nMsgs);
+    H2_ADD_RELAXED(&mbox->stats.rcvBytes, nbytes);
+
+    if (mbox->stamp == NULL)
+	return;
+    now = mboxStatUsec();
+    for (i = 0; i < nMsgs; i++, seq++) {
+	st = (H2_MBOX_STAMP *)smObjGlobalToLocal(mbox->stamp)
+	    + prio * mbox->nStamp + seq % mbox->nStamp;
+	tag = H2_LOAD_ACQ(&st->tag);
+	if (tag != H2_MBOX_STAMP_TAG(seq, prio))
+	    continue;
+	usec = H2_LOAD_RELAXED(&st->usec);
+	H2_FENCE_ACQ();
+	/* overwritten meanwhile by a sender that wrapped around */
+	if (H2_LOAD_RELAXED(&st->tag) != tag)
+	    continue;
+	lat = (int)(now - usec) > 0 ? now - usec : 0;
+	for (b = 0; lat != 0 && b < MBOX_STATS_NLAT - 1; b++)
+	    lat >>= 1;
+	H2_ADD_RELAXED(&mbox->stats.latency[b], 1);
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxStatFull  -  Account for a send refused on a full mailbox
+ **/
+
+static void
+mboxStatFull(MBOX_ID toId)
+{
+    H2_ADD_RELAXED(&H2DEV_MBOX_STR(toId)->stats.sendFull, 1);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGrow  -  Make room for a message in a MBOX_FLAG_GROW mailbox
+ **
+ **  Description:
+ **  Called by a sender holding the mutex semaphore when a message of
+ **  nbytes did not fit. The size of the ring buffer is doubled until the
+ **  message fits, without going over the size limit of the mailbox. The
+ **  queued messages are moved to the new ring buffer. Not done while the
+ **  reader looks at a message in place with mboxRcvPeek().
+ **
+ **  Returns: TRUE if the mailbox was grown
+ **/
+
+static BOOL
+mboxGrow(MBOX_ID toId, int nbytes)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(toId);
+    H2_MBOX_STAMP *stamp = NULL;
+    H2RNG_ID rngId;
+    unsigned int renum;
+    int size, need, nStamp = 0;
+
+    if (!(mbox->flags & MBOX_FLAG_GROW) || mbox->peekPos != -1)
+	return FALSE;
+    rngId = (H2RNG_ID)smObjGlobalToLocal(mbox->rngId);
+
+    /* the block, its header and the gap kept between pWr and pRd */
+    need = h2rngNBytes(rngId) + nbytes + 16;
+    for (size = mbox->size; size < need && size < mbox->maxSize; size *= 2)
+	;
+    if (size > mbox->maxSize)
+	size = mbox->maxSize;
+    if (size < need)
+	return FALSE;
+
+    if ((mbox->flags & MBOX_FLAG_LATENCY) &&
+	(stamp = mboxStampNew(toId, size, &nStamp)) == NULL)
+	return FALSE;
+    renum = rngId->nGet;
+    if ((rngId = h2rngRealloc(rngId, size)) == NULL) {
+	if (stamp != NULL)
+	    smMemFree(stamp);
+	return FALSE;
+    }
+    mbox->rngId = (H2RNG_ID)smObjLocalToGlobal(rngId);
+    mbox->size = size;
+    if (stamp != NULL)
+	mboxStampSet(toId, stamp, nStamp, renum);
+    LOGDBG(("comLib:mboxGrow: mbox %d grown to %d bytes\n", toId, size));
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxFdNotify  -  Make the descriptor of mboxGetFd() readable
+ **
+ **  Description:
+ **  Writes a byte in the fifo of the mailbox, unless one is already
+ **  pending. Senders of other processes open the fifo by its name.
+ **/
+
+static void
+mboxFdNotify(MBOX_ID mboxId)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(mboxId);
+    char path[MAXPATHLEN];
+    int fd;
+
+    if (H2_XCHG_SEQ(&mbox->fdPending, 1) != 0)
+	return;
+    if (mbox->fdPid == getpid()) {
+	fd = mbox->fdWr;
+    } else {
+	if (h2devGetPath(mboxId, "fifo", path, sizeof(path)) == ERROR)
+	    return;
+	if ((fd = open(path, O_WRONLY | O_NONBLOCK)) < 0) {
+	    LOGDBG(("comLib:mboxFdNotify: %s: %s\n", path, strerror(errno)));
+	    return;
+	}
+    }
+    if (write(fd, "", 1) != 1) {
+	LOGDBG(("comLib:mboxFdNotify: write: %s\n", strerror(errno)));
+    }
+    if (fd != mbox->fdWr)
+	close(fd);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxFdReset  -  Clear the descriptor of mboxGetFd() once empty
+ **
+ **  Description:
+ **  Called by the reader after removing messages or finding the mailbox
+ **  empty. When the mailbox is empty, the fifo is drained, even without
+ **  a pending byte: a sender may write it after the previous drain. It
+ **  is written again if a message arrived meanwhile, as its sender may
+ **  have found a byte still pending, or had its byte drained.
+ **/
+
+static void
+mboxFdReset(MBOX_ID mboxId)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(mboxId);
+    char buf[64];
+
+    if (!H2_LOAD_SEQ(&mbox->fdArmed) ||
+	mbox->fdPid != getpid() || mboxNotEmpty(mboxId))
+	return;
+    H2_STORE_SEQ(&mbox->fdPending, 0);
+    while (read(mbox->fdRd, buf, sizeof(buf)) > 0)
+	;
+    if (mboxNotEmpty(mboxId)) {
+	/* fdPending may be set by a sender whose byte was drained */
+	H2_STORE_SEQ(&mbox->fdPending, 0);
+	mboxFdNotify(mboxId);
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
 /**
  **  mboxCreate  -  Create a mailbox device
  **
@@ -158,10 +631,91 @@ mboxEnd(long taskId)
 
 STATUS
 mboxCreate(const char *name, int size, MBOX_ID *pMboxId)
+{
+    return mboxCreateFlags(name, size, 0, pMboxId);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxCreateFlags  -  Create a mailbox device with options
+ **
+ **  Description:
+ **  Create a mailbox with given name, size and MBOX_FLAG_xxx options.
+ **  With MBOX_FLAG_SPSC, the caller guarantees that only one task at a
+ **  time ever sends to the mailbox: mboxSend() then does not take the
+ **  mutex semaphore and relies on the lock-free single producer/single
+ **  consumer ring buffer. With MBOX_FLAG_MIRROR, the ring buffer data
+ **  is mapped twice back to back, so that the views returned by
+ **  mboxRcvPeek() and mboxSendReserve() are always in one piece.
+ **  With MBOX_FLAG_MPSC, any number of tasks may send concurrently
+ **  without taking the mutex semaphore: they claim room in the ring
+ **  buffer with atomic operations. mboxSendReserve() is not available
+ **  for such mailboxes. These mailboxes cannot be resized.
+ **  With MBOX_FLAG_CONFLATE, a message replaces the unread message of
+ **  the same size from the same sender, if any (see mboxConflate()).
+ **  With MBOX_FLAG_LATENCY, the send date of each message is recorded
+ **  in a table sized after the ring buffers, for the latency histogram
+ **  of FIO_STATS.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxCreateFlags(const char *name, int size, int flags, MBOX_ID *pMboxId)
+{
+    return mboxCreatePrio(name, size, flags, 1, pMboxId);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxCreatePrio  -  Create a mailbox device with priority lanes
+ **
+ **  Description:
+ **  Create a mailbox with given name, size and MBOX_FLAG_xxx options,
+ **  made of nPrio (1 to MBOX_MAX_PRIO) ring buffers of size bytes
+ **  each. mboxSendPrio() sends to a given lane, the other send
+ **  functions use lane 0. Receive functions always take the oldest
+ **  message of the highest non-empty lane, so urgent messages never
+ **  wait behind a backlog of lower priority ones.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxCreatePrio(const char *name, int size, int flags, int nPrio,
+	       MBOX_ID *pMboxId)
 {
     H2_MBOX_STR *mbox;
+    H2_MBOX_STAMP *stamp;
     H2RNG_ID rngId;
     MBOX_ID dev;
+    int i, nStamp, rngFlags = 0;
+
+    if ((flags & ~(MBOX_FLAG_SPSC | MBOX_FLAG_MIRROR | MBOX_FLAG_MPSC |
+		   MBOX_FLAG_CONFLATE | MBOX_FLAG_GROW |
+		   MBOX_FLAG_LATENCY)) != 0
+	|| ((flags & MBOX_FLAG_SPSC) && (flags & MBOX_FLAG_MPSC))
+	|| ((flags & MBOX_FLAG_CONFLATE) &&
+	    (flags & (MBOX_FLAG_SPSC | MBOX_FLAG_MPSC)))
+	/* like mboxResize() */
+	|| ((flags & MBOX_FLAG_GROW) &&
+	    (flags & (MBOX_FLAG_SPSC | MBOX_FLAG_MIRROR | MBOX_FLAG_MPSC)))) {
+	errnoSet(S_mboxLib_BAD_FLAGS);
+	return ERROR;
+    }
+    if ((flags & MBOX_FLAG_GROW) && nPrio != 1) {
+	errnoSet(S_mboxLib_BAD_PRIO);
+	return ERROR;
+    }
+    if (nPrio < 1 || nPrio > MBOX_MAX_PRIO) {
+	errnoSet(S_mboxLib_BAD_PRIO);
+	return ERROR;
+    }
+    if (flags & MBOX_FLAG_SPSC) rngFlags |= H2RNG_FLAG_SPSC;
+    if (flags & MBOX_FLAG_MIRROR) rngFlags |= H2RNG_FLAG_MIRROR;
+    if (flags & MBOX_FLAG_MPSC) rngFlags |= H2RNG_FLAG_MPSC;
 
     /* Allocate a h2 device */
     dev = h2devAlloc(name, H2_DEV_TYPE_MBOX);
@@ -186,12 +740,27 @@ mboxCreate(const char *name, int size, MBOX_ID *pMboxId)
         LOGDBG(("mboxCreate:h2semAlloc(H2SEM_SYNC): %d\n", e));
 	return ERROR;
     }
+    h2wakeInit(&mbox->wakeRd, mbox->semSigRd);
+    /* Create a semaphore for blocked senders */
+    if ((mbox->semSigWr = h2semAlloc(H2SEM_SYNC)) == ERROR) {
+	int e = errnoGet();
+	h2semDelete(mbox->semSigRd);
+	h2semDelete(mbox->semExcl);
+	h2devFree(dev);
+	errnoSet(e);
+        LOGDBG(("mboxCreate:h2semAlloc(H2SEM_SYNC): %d\n", e));
+	return ERROR;
+    }
+    h2wakeInit(&mbox->wakeWr, mbox->semSigWr);
+    mbox->sendWaiters = 0;
+    mbox->nSendBlocked = 0;
     LOGDBG(("comLib:mboxCreate: semaphores created\n"));
 
     /* Allocate a ring buffer */
-    rngId = h2rngCreate(H2RNG_TYPE_BLOCK, size);
+    rngId = h2rngCreateFlags(H2RNG_TYPE_BLOCK, size, rngFlags);
     if (rngId == NULL) {
 	int e = errnoGet();
+	h2semDelete(mbox->semSigWr);
 	h2semDelete(mbox->semSigRd);
 	h2semDelete(mbox->semExcl);
 	h2devFree(dev);
@@ -201,9 +770,59 @@ mboxCreate(const char *name, int size, MBOX_ID *pMboxId)
     /* Store the global identifier of this ring buffer */
     mbox->rngId = (H2RNG_ID)smObjLocalToGlobal(rngId);
 
+    /* Ring buffers of the priority lanes */
+    for (i = 1; i < nPrio; i++) {
+	rngId = h2rngCreateFlags(H2RNG_TYPE_BLOCK, size, rngFlags);
+	if (rngId == NULL) {
+	    int e = errnoGet();
+	    while (--i > 0)
+		h2rngDelete(smObjGlobalToLocal(mbox->rngPrio[i - 1]));
+	    h2rngDelete(smObjGlobalToLocal(mbox->rngId));
+	    h2semDelete(mbox->semSigWr);
+	    h2semDelete(mbox->semSigRd);
+	    h2semDelete(mbox->semExcl);
+	    h2devFree(dev);
+	    errnoSet(e);
+	    return ERROR;
+	}
+	mbox->rngPrio[i - 1] = (H2RNG_ID)smObjLocalToGlobal(rngId);
+    }
+    mbox->nPrio = nPrio;
+    mbox->peekPrio = 0;
+    mbox->peekPos = -1;
+    memset(&mbox->stats, 0, sizeof(mbox->stats));
+    mbox->stamp = NULL;
+    mbox->nStamp = 0;
+    if (flags & MBOX_FLAG_LATENCY) {
+	if ((stamp = mboxStampNew(dev, size, &nStamp)) == NULL) {
+	    int e = errnoGet();
+	    for (i = 1; i < nPrio; i++)
+		h2rngDelete(smObjGlobalToLocal(mbox->rngPrio[i - 1]));
+	    h2rngDelete(smObjGlobalToLocal(mbox->rngId));
+	    h2semDelete(mbox->semSigWr);
+	    h2semDelete(mbox->semSigRd);
+	    h2semDelete(mbox->semExcl);
+	    h2devFree(dev);
+	    errnoSet(e);
+	    return ERROR;
+	}
+	mboxStampSet(dev, stamp, nStamp, 0);
+    }
+    mbox->fdArmed = 0;
+    mbox->fdPending = 0;
+    mbox->fdPid = -1;
+    mbox->fdRd = mbox->fdWr = -1;
+    mbox->maxSize = (flags & MBOX_FLAG_GROW) ? MBOX_GROW_MAX_DEFAULT * size
+	: size;
+
     /* Other informations */
     mbox->size = size;
+    mbox->flags = flags;
     mbox->taskId = taskGetUserData(0);
+    mboxSlotAlloc(dev);
+    /* List the mailbox with the other ones of its task */
+    if (H2DEV_TYPE(mbox->taskId) == H2_DEV_TYPE_TASK)
+	h2devSetOwner(dev, mbox->taskId);
 
     /* That's it */
     *pMboxId = dev;
@@ -227,7 +846,10 @@ mboxResize(MBOX_ID mboxId, int size)
 {
     uid_t uid = getuid();
     H2_MBOX_STR *mbox;
+    H2_MBOX_STAMP *stamp = NULL;
     H2RNG_ID rngId;
+    unsigned int renum;
+    int nStamp = 0;
 
     if (uid != H2DEV_UID(mboxId) && uid != H2DEV_UID(0)) {
         errnoSet(S_mboxLib_NOT_OWNER);
@@ -236,15 +858,34 @@ mboxResize(MBOX_ID mboxId, int size)
     mbox = H2DEV_MBOX_STR(mboxId);
     if (mbox->size == size) return OK;
 
+    /* lock-free senders would not see the ring buffer change, and the
+       mapping of a mirrored ring buffer cannot be moved */
+    if (mbox->flags & (MBOX_FLAG_SPSC | MBOX_FLAG_MIRROR | MBOX_FLAG_MPSC)) {
+        errnoSet(S_mboxLib_BAD_FLAGS);
+        return ERROR;
+    }
+    if (mbox->nPrio > 1) {
+        errnoSet(S_mboxLib_BAD_PRIO);
+        return ERROR;
+    }
+
     /* take the mutex semaphore of the device */
     if (h2semTake (H2DEV_MBOX_SEM_EXCL_ID(mboxId), WAIT_FOREVER) != TRUE) {
         return ERROR;
     }
 
-    /* resize the ring buffer */
+    /* resize the send dates and the ring buffer */
+    if ((mbox->flags & MBOX_FLAG_LATENCY) &&
+	(stamp = mboxStampNew(mboxId, size, &nStamp)) == NULL) {
+      h2semGive(H2DEV_MBOX_SEM_EXCL_ID(mboxId));
+      return ERROR;
+    }
     rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(mboxId));
+    renum = rngId->nGet;
     rngId = h2rngRealloc(rngId, size);
     if (rngId == NULL) {
+      if (stamp != NULL)
+	smMemFree(stamp);
       h2semGive(H2DEV_MBOX_SEM_EXCL_ID(mboxId));
       return ERROR;
     }
@@ -254,6 +895,10 @@ mboxResize(MBOX_ID mboxId, int size)
 
     /* other information */
     mbox->size = size;
+    if (mbox->maxSize < size)
+	mbox->maxSize = size;
+    if (stamp != NULL)
+	mboxStampSet(mboxId, stamp, nStamp, renum);
 
     /* that's it */
     h2semGive(H2DEV_MBOX_SEM_EXCL_ID(mboxId));
@@ -266,16 +911,39 @@ STATUS
 mboxDelete(MBOX_ID mboxId)
 {
     uid_t uid = getuid();
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(mboxId);
+    char path[MAXPATHLEN];
+    int i;
 
     if (uid != H2DEV_UID(mboxId) && uid != H2DEV_UID(0)) {
 	errnoSet(S_mboxLib_NOT_OWNER);
 	return ERROR;
     }
-    /* free the ring buffer */
-    h2rngDelete (smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(mboxId)));
+    /* Remove it from the ready set of its owner */
+    mboxSlotFree(mboxId);
+
+    /* Remove the fifo of mboxGetFd() */
+    if (mbox->fdArmed) {
+	mbox->fdArmed = 0;
+	if (mbox->fdPid == getpid()) {
+	    close(mbox->fdRd);
+	    close(mbox->fdWr);
+	}
+	if (h2devGetPath(mboxId, "fifo", path, sizeof(path)) == OK)
+	    unlink(path);
+    }
+
+    /* free the ring buffers */
+    for (i = 0; i < H2DEV_MBOX_STR(mboxId)->nPrio; i++)
+	h2rngDelete (mboxLane(mboxId, i));
+    if (mbox->stamp != NULL) {
+	smMemFree(smObjGlobalToLocal(mbox->stamp));
+	mbox->stamp = NULL;
+    }
 
-    /* Free the synchronization semaphore */
+    /* Free the synchronization semaphores */
     h2semDelete (H2DEV_MBOX_SEM_ID(mboxId));
+    h2semDelete (H2DEV_MBOX_STR(mboxId)->semSigWr);
 
     /* Free the mutex semaphore */
     h2semDelete (H2DEV_MBOX_SEM_EXCL_ID(mboxId));
@@ -315,24 +983,22 @@ mboxFind(const char *name, MBOX_ID *pMboxId)
 void
 mboxShow(void)
 {
-    int i, d, h2devMax;
+    int i;
     int nMess = 0, bytes = 0, size = 0;
 
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
 	return;
     }
     logMsg("\n");
     logMsg("Name                              Id     Size NMes    Bytes\n");
     logMsg("-------------------------------- --- -------- ---- --------\n");
-    for (d = 0; d < h2devMax; d++) {
-	i = H2DEV_BY_INDEX(d);
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_MBOX) {
-	    mboxIoctl(i, FIO_SIZE, &size);
-	    mboxIoctl(i, FIO_NMSGS, &nMess);
-	    mboxIoctl(i, FIO_NBYTES, &bytes);
-	    logMsg("%-32s %3d %8d %4d %8d\n", H2DEV_NAME(i), i,
-		   size, nMess, bytes);
-	}
+    for (i = h2devFirst(H2_DEV_TYPE_MBOX); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_MBOX)) {
+	mboxIoctl(i, FIO_SIZE, &size);
+	mboxIoctl(i, FIO_NMSGS, &nMess);
+	mboxIoctl(i, FIO_NBYTES, &bytes);
+	logMsg("%-32s %3d %8d %4d %8d\n", H2DEV_NAME(i), i,
+	       size, nMess, bytes);
     } /* for */
     logMsg("\n");
 }
@@ -340,30 +1006,140 @@ mboxShow(void)
 /*----------------------------------------------------------------------*/
 
 /**
- **   mboxIoctl  -  Ask for information about a mailbox
+ **   mboxWakeSenders  -  Signal that room was made in a mailbox
  **
  **   Description:
- **   similar to the Unix ioctl() function. Gets various informations
- **   about a mailbox device
- **
- **   Returns:
- **   OK or ERROR
+ **   Called after messages were removed. Only does something when
+ **   senders are blocked in mboxSendTimed().
  **/
-STATUS
-mboxIoctl(MBOX_ID mboxId, int codeFunc, void *pArg)
+static void
+mboxWakeSenders(MBOX_ID mboxId)
 {
-    H2RNG_ID rid;                /* ring buffer */
-    int n;                       /* number of messages or bytes */
-
-    /* Get the local address of the ring buffer */
-    rid = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(mboxId));
+    if (H2_LOAD_SEQ(&H2DEV_MBOX_STR(mboxId)->sendWaiters) != 0)
+	h2wakeGive(H2DEV_MBOX_WAKE_WR(mboxId));
+}
 
-    /* Execute the requested function */
-    switch (codeFunc) {
-      case FIO_NMSGS:                   /* Number of messages in
-					   the mailbox */
-	n = h2rngNBlocks (rid);
-	break;
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxStatsGet  -  Read and reset the statistics of a mailbox
+ **
+ **   Description:
+ **   Each counter is swapped with 0, so that the counts of the messages
+ **   sent or received meanwhile go to the next reading.
+ **/
+static void
+mboxStatsGet(MBOX_ID mboxId, MBOX_STATS *st)
+{
+    MBOX_STATS *cur = H2DEV_MBOX_STATS(mboxId);
+    int b;
+
+    st->sentMsgs = H2_XCHG_RELAXED(&cur->sentMsgs, 0);
+    st->sentBytes = H2_XCHG_RELAXED(&cur->sentBytes, 0);
+    st->rcvMsgs = H2_XCHG_RELAXED(&cur->rcvMsgs, 0);
+    st->rcvBytes = H2_XCHG_RELAXED(&cur->rcvBytes, 0);
+    st->sendFull = H2_XCHG_RELAXED(&cur->sendFull, 0);
+    st->highWater = H2_XCHG_RELAXED(&cur->highWater, 0);
+    for (b = 0; b < MBOX_STATS_NLAT; b++)
+	st->latency[b] = H2_XCHG_RELAXED(&cur->latency[b], 0);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxStatsLatency  -  Latency below which a fraction of messages fell
+ **
+ **   Returns: the upper bound, in microseconds, of the histogram bucket
+ **   holding the given percentile, or 0 if no latency was measured
+ **/
+static unsigned int
+mboxStatsLatency(const MBOX_STATS *st, int percent)
+{
+    unsigned int total = 0, n = 0;
+    int b;
+
+    for (b = 0; b < MBOX_STATS_NLAT; b++)
+	total += st->latency[b];
+    if (total == 0)
+	return 0;
+    for (b = 0; b < MBOX_STATS_NLAT - 1; b++) {
+	n += st->latency[b];
+	if ((unsigned long long)n * 100 >=
+	    (unsigned long long)total * percent)
+	    break;
+    }
+    return 1U << b;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxStats  -  Print and reset the statistics of all mailboxes
+ **
+ **   Description:
+ **   Prints the traffic of each mailbox since the previous call, the
+ **   most bytes held by one of its lanes and the median and 99th
+ **   percentile of the delay between sending and receiving a message,
+ **   rounded up to a power of 2 microseconds.
+ **/
+void
+mboxStats(void)
+{
+    int i;
+    MBOX_STATS st;
+
+    if (h2devAttach(NULL) == ERROR) {
+	return;
+    }
+    logMsg("\n");
+    logMsg("Name                              SentMsgs    RcvMsgs  SentBytes   RcvBytes   Full HighWater   p50us   p99us\n");
+    logMsg("-------------------------------- ---------- ---------- ---------- ---------- ------ --------- ------- -------\n");
+    for (i = h2devFirst(H2_DEV_TYPE_MBOX); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_MBOX)) {
+	mboxStatsGet(i, &st);
+	logMsg("%-32s %10u %10u %10u %10u %6u %9u %7u %7u\n",
+	       H2DEV_NAME(i), st.sentMsgs, st.rcvMsgs, st.sentBytes,
+	       st.rcvBytes, st.sendFull, st.highWater,
+	       mboxStatsLatency(&st, 50), mboxStatsLatency(&st, 99));
+    } /* for */
+    logMsg("\n");
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxIoctl  -  Ask for information about a mailbox
+ **
+ **   Description:
+ **   similar to the Unix ioctl() function. Gets various informations
+ **   about a mailbox device
+ **
+ **   Returns:
+ **   OK or ERROR
+ **/
+STATUS
+mboxIoctl(MBOX_ID mboxId, int codeFunc, void *pArg)
+{
+    int n;                       /* number of messages or bytes */
+    int prio, nLane;
+
+    /* Execute the requested function */
+    switch (codeFunc) {
+      case FIO_NMSGS:                   /* Number of messages in
+					   the mailbox */
+	n = 0;
+	prio = 0;
+	if (!MBOX_RCV_LOCK(mboxId))
+	    return (ERROR);
+	do {
+	    if ((nLane = h2rngNBlocks (mboxLane(mboxId, prio))) == ERROR) {
+		n = ERROR;
+		break;
+	    }
+	    n += nLane;
+	} while (++prio < H2DEV_MBOX_STR(mboxId)->nPrio);
+	MBOX_RCV_UNLOCK(mboxId);
+	break;
 
       case FIO_GETNAME:                 /* Name of the mailbox */
 
@@ -372,12 +1148,29 @@ mboxIoctl(MBOX_ID mboxId, int codeFunc, void *pArg)
 
       case FIO_NBYTES:                  /* Number of bytes in the mailbox */
 
-	n = h2rngNBytes (rid);
+	n = 0;
+	prio = 0;
+	if (!MBOX_RCV_LOCK(mboxId))
+	    return (ERROR);
+	do {
+	    if ((nLane = h2rngNBytes (mboxLane(mboxId, prio))) == ERROR) {
+		n = ERROR;
+		break;
+	    }
+	    n += nLane;
+	} while (++prio < H2DEV_MBOX_STR(mboxId)->nPrio);
+	MBOX_RCV_UNLOCK(mboxId);
 	break;
 
       case FIO_FLUSH:                   /* Clear the mailbox */
 
-	h2rngFlush (rid);
+	if (!MBOX_RCV_LOCK(mboxId))
+	    return (ERROR);
+	for (prio = 0; prio < H2DEV_MBOX_STR(mboxId)->nPrio; prio++)
+	    h2rngFlush (mboxLane(mboxId, prio));
+	MBOX_RCV_UNLOCK(mboxId);
+	mboxWakeSenders(mboxId);
+	mboxFdReset(mboxId);
 	return (OK);
 
       case FIO_SIZE:                    /* Size of the mailbox */
@@ -385,6 +1178,38 @@ mboxIoctl(MBOX_ID mboxId, int codeFunc, void *pArg)
 	n = H2DEV_MBOX_STR(mboxId)->size;
 	break;
 
+      case FIO_NSENDBLOCKED:            /* Number of blocked sends */
+
+	n = H2_LOAD_RELAXED(&H2DEV_MBOX_STR(mboxId)->nSendBlocked);
+	break;
+
+      case FIO_STATS:                   /* Traffic statistics */
+
+	if (H2DEV_TYPE(mboxId) != H2_DEV_TYPE_MBOX) {
+	    errnoSet(S_mboxLib_MBOX_CLOSED);
+	    return (ERROR);
+	}
+	mboxStatsGet(mboxId, (MBOX_STATS *) pArg);
+	return (OK);
+
+      case FIO_SETMAXSIZE:              /* Size limit of MBOX_FLAG_GROW */
+
+	if (!(H2DEV_MBOX_FLAGS(mboxId) & MBOX_FLAG_GROW)) {
+	    errnoSet(S_mboxLib_BAD_FLAGS);
+	    return (ERROR);
+	}
+	if (h2semTake(H2DEV_MBOX_SEM_EXCL_ID(mboxId), WAIT_FOREVER) != TRUE)
+	    return (ERROR);
+	/* The mailbox never shrinks */
+	if (*(int *) pArg < H2DEV_MBOX_STR(mboxId)->size) {
+	    h2semGive(H2DEV_MBOX_SEM_EXCL_ID(mboxId));
+	    errnoSet(S_h2rngLib_ILLEGAL_NBYTES);
+	    return (ERROR);
+	}
+	H2DEV_MBOX_STR(mboxId)->maxSize = *(int *) pArg;
+	h2semGive(H2DEV_MBOX_SEM_EXCL_ID(mboxId));
+	return (OK);
+
       default:                          /* Unknown request */
 
 	errnoSet (S_mboxLib_BAD_IOCTL_CODE);
@@ -409,26 +1234,35 @@ mboxRcv(MBOX_ID mboxId, MBOX_ID *pFromId, char *buf, int maxbytes,
 {
     int nr;                       /* number of read bytes */
     int takeStat;                 /* status of semTake() */
+    int prio;
+    unsigned int seq;
+    BOOL flushed = FALSE;
     H2RNG_ID rid;
 
     LOGDBG(("comLib:mboxRcv: mboxId: %d\n", mboxId));
 
-    /* Compute local address of ring buffer */
-    rid = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(mboxId));
-
-    LOGDBG(("comLib:mboxRcv: rid: %p\n", rid));
-    /* Flush the synchronisation semaphore */
-    h2semFlush(H2DEV_MBOX_SEM_ID(mboxId));
-
     /* Wait for a message */
     while (1) {
+	if (!MBOX_RCV_LOCK(mboxId))
+	    return (ERROR);
+	/* Compute local address of the ring buffer to read */
+	prio = mboxRcvLane(mboxId);
+	rid = mboxLane(mboxId, prio);
 
-	/* Check if a message is available */
+	/* Check if a message is available, and read it */
+	seq = 0;
 	if ((nr = h2rngNBytes (rid)) > 0) {
-	    /* Read it */
+	    seq = rid->nGet;
 	    nr = h2rngBlockGet (rid, (int *) pFromId, buf, maxbytes);
+	}
+	if (nr > 0)
+	    mboxStatRcvd(mboxId, prio, seq, 1, nr);
+	MBOX_RCV_UNLOCK(mboxId);
+	if (nr > 0) {
 	    LOGDBG(("comLib:mboxRcv: read %d bytes from mbox %d in mbox %d\n",
 		    nr, *(int *)pFromId, mboxId));
+	    mboxWakeSenders(mboxId);
+	    mboxFdReset(mboxId);
 	    return (nr);
 	}
 
@@ -436,11 +1270,180 @@ mboxRcv(MBOX_ID mboxId, MBOX_ID *pFromId, char *buf, int maxbytes,
 	if (nr < 0)
 	    return (ERROR);
 
+	/* Flush the synchronisation event before the first wait and check
+	   again, so that no signal is lost */
+	if (!flushed) {
+	    mboxFdReset(mboxId);
+	    h2wakeFlush(H2DEV_MBOX_WAKE(mboxId));
+	    flushed = TRUE;
+	    continue;
+	}
+
+	/* otherwise, wait */
+	if ((takeStat = h2wakeTake (H2DEV_MBOX_WAKE(mboxId), timeout))
+	    != TRUE) {
+	    mboxFdReset(mboxId);
+	    return (takeStat);
+	}
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxRcvN  -  Wait for messages and receive several of them at once
+ **
+ **   Description:
+ **   Waits like mboxRcv() until the mailbox is not empty, then receives
+ **   up to maxMsgs messages in one call. Message i is copied in bufs[i]
+ **   (of maxbytes each), its sender in pFromIds[i] and its size in
+ **   pNbytes[i]. maxMsgs must be positive. The synchronization semaphore
+ **   is only flushed when the mailbox is found empty.
+ **
+ **   Returns: number of messages received, FALSE on timeout or ERROR
+ **/
+int
+mboxRcvN(MBOX_ID mboxId, int maxMsgs, MBOX_ID *pFromIds, int *pNbytes,
+	 char **bufs, int maxbytes, int timeout)
+{
+    int nr;                       /* number of messages */
+    int takeStat;                 /* status of semTake() */
+    int prio, i, nbytes;
+    unsigned int seq;
+    BOOL flushed = FALSE;
+    H2RNG_ID rid;
+
+    if (maxMsgs <= 0) {
+	errnoSet(S_h2rngLib_ILLEGAL_NBYTES);
+	return (ERROR);
+    }
+    while (1) {
+	/* Read what is available in the highest non-empty lane */
+	if (!MBOX_RCV_LOCK(mboxId))
+	    return (ERROR);
+	prio = mboxRcvLane(mboxId);
+	rid = mboxLane(mboxId, prio);
+	seq = rid != NULL ? rid->nGet : 0;
+	nr = h2rngBlockGetN (rid, maxMsgs, (int *) pFromIds, pNbytes,
+			     bufs, maxbytes);
+	if (nr > 0) {
+	    for (i = 0, nbytes = 0; i < nr; i++)
+		nbytes += pNbytes[i];
+	    mboxStatRcvd(mboxId, prio, seq, nr, nbytes);
+	}
+	MBOX_RCV_UNLOCK(mboxId);
+	if (nr != 0) {
+	    LOGDBG(("comLib:mboxRcvN: read %d messages in mbox %d\n",
+		    nr, mboxId));
+	    mboxWakeSenders(mboxId);
+	    mboxFdReset(mboxId);
+	    return (nr);
+	}
+
+	/* Flush the synchronisation semaphore before the first wait and
+	   check again, so that no signal is lost */
+	if (!flushed) {
+	    mboxFdReset(mboxId);
+	    h2wakeFlush(H2DEV_MBOX_WAKE(mboxId));
+	    flushed = TRUE;
+	    continue;
+	}
+
+	/* otherwise, wait */
+	if ((takeStat = h2wakeTake (H2DEV_MBOX_WAKE(mboxId), timeout))
+	    != TRUE) {
+	    mboxFdReset(mboxId);
+	    return (takeStat);
+	}
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxRcvPeek  -  Wait for a message and look at it in place
+ **
+ **   Description:
+ **   Like mboxRcv(), but instead of copying the message, fills view with
+ **   the address of its data in the mailbox ring buffer (in one or two
+ **   pieces if it wraps). The message stays in the mailbox until
+ **   mboxRcvRelease() is called.
+ **
+ **   Returns: number of bytes of the message, FALSE on timeout or ERROR
+ **/
+int
+mboxRcvPeek(MBOX_ID mboxId, MBOX_ID *pFromId, H2RNG_VIEW *view, int timeout)
+{
+    int nr;                       /* number of bytes of the message */
+    int takeStat;                 /* status of semTake() */
+    int prio;
+    BOOL flushed = FALSE;
+
+    while (1) {
+	/* Check if a message is available, remembering its lane for
+	   mboxRcvRelease() */
+	if (!MBOX_RCV_LOCK(mboxId))
+	    return (ERROR);
+	prio = mboxRcvLane(mboxId);
+	nr = h2rngBlockPeek (mboxLane(mboxId, prio), view);
+	if (nr > 0 && (H2DEV_MBOX_FLAGS(mboxId) & MBOX_RCV_EXCL))
+	    H2DEV_MBOX_STR(mboxId)->peekPos = view->pos;
+	MBOX_RCV_UNLOCK(mboxId);
+	if (nr != 0) {
+	    H2DEV_MBOX_STR(mboxId)->peekPrio = prio;
+	    if (nr > 0 && pFromId != NULL)
+		*pFromId = view->id;
+	    return (nr);
+	}
+
+	/* Flush the synchronisation semaphore before the first wait and
+	   check again, so that no signal is lost */
+	if (!flushed) {
+	    mboxFdReset(mboxId);
+	    h2wakeFlush(H2DEV_MBOX_WAKE(mboxId));
+	    flushed = TRUE;
+	    continue;
+	}
+
 	/* otherwise, wait */
-	if ((takeStat = h2semTake (H2DEV_MBOX_SEM_ID(mboxId), timeout))
-	    != TRUE)
+	if ((takeStat = h2wakeTake (H2DEV_MBOX_WAKE(mboxId), timeout))
+	    != TRUE) {
+	    mboxFdReset(mboxId);
 	    return (takeStat);
+	}
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxRcvRelease  -  Remove a message obtained by mboxRcvPeek
+ **
+ **   Returns: OK or ERROR
+ **/
+STATUS
+mboxRcvRelease(MBOX_ID mboxId, H2RNG_VIEW *view)
+{
+    STATUS status;
+    int prio = H2DEV_MBOX_STR(mboxId)->peekPrio;
+    unsigned int seq;
+    H2RNG_ID rid;
+
+    if (!MBOX_RCV_LOCK(mboxId))
+	return ERROR;
+    rid = mboxLane(mboxId, prio);
+    seq = rid != NULL ? rid->nGet : 0;
+    status = h2rngBlockRelease(rid, view);
+    if (status == OK) {
+	H2DEV_MBOX_STR(mboxId)->peekPos = -1;
+	mboxStatRcvd(mboxId, prio, seq, 1, view->nbytes);
     }
+    MBOX_RCV_UNLOCK(mboxId);
+    if (status == ERROR)
+	return ERROR;
+    mboxWakeSenders(mboxId);
+    mboxFdReset(mboxId);
+    return OK;
 }
 
 /*----------------------------------------------------------------------*/
@@ -457,45 +1460,19 @@ mboxRcv(MBOX_ID mboxId, MBOX_ID *pFromId, char *buf, int maxbytes,
 BOOL
 mboxPause(MBOX_ID mboxId, int timeout)
 {
-    int d;
-    int nMbox;                  /* mailbox index */
     int nMes;                   /* number of messages in a mailbox */
     int takeStatus;             /* status of semTake() */
-    long myTaskId;              /* my task identifier */
-    H2SEM_ID semId;
 
     /* Check if we're waiting on all mailboxes */
     if (mboxId == ALL_MBOX) {
-	myTaskId = taskGetUserData(0);
-	/* get and flush my task synchronization semaphore */
-	semId = H2DEV_TASK_SEM_ID(myTaskId);
-	h2semFlush(semId);
-
-	/* Wait for a message */
-	while (1) {
-	    /* Check for messages in one of mailboxes attached to this task */
-	    for (d = 0; d < h2devSize(); d++) {
-		nMbox = H2DEV_BY_INDEX(d);
-		if (H2DEV_TYPE(nMbox) == H2_DEV_TYPE_MBOX
-		    && H2DEV_MBOX_TASK_ID(nMbox) == myTaskId) {
-		    if (mboxIoctl (nMbox, FIO_NMSGS, (char *) &nMes)
-			== OK && nMes != 0) {
-			return (TRUE);
-		    }
-		}
-	    } /* for */
-
-	    /* no message, wait for the synchronization semaphore */
-	    LOGDBG(("comLib:mboxPause: waiting on sem #%d\n", semId));
-	    if ((takeStatus = h2semTake(semId, timeout)) != TRUE) {
-		return (takeStatus);
-	    }
-	} /* while */
+	if ((takeStatus = mboxPauseAll(NULL, 0, timeout)) > 0)
+	    return (TRUE);
+	return (takeStatus);
     }
 
 
-    /* Flush the synchonization semaphore */
-    h2semFlush(H2DEV_MBOX_SEM_ID(mboxId));
+    /* Flush the synchonization event */
+    h2wakeFlush(H2DEV_MBOX_WAKE(mboxId));
 
     /* Wait for a message */
     while (1) {
@@ -504,7 +1481,7 @@ mboxPause(MBOX_ID mboxId, int timeout)
 	    return (TRUE);
 
 	/* otherwise, wait */
-	if ((takeStatus = h2semTake (H2DEV_MBOX_SEM_ID(mboxId), timeout))
+	if ((takeStatus = h2wakeTake (H2DEV_MBOX_WAKE(mboxId), timeout))
 	    != TRUE) {
 	    return (takeStatus);
 	}
@@ -512,15 +1489,223 @@ mboxPause(MBOX_ID mboxId, int timeout)
 }
 
 
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxNotEmpty  -  Tell if a mailbox holds at least one message
+ **/
+static BOOL
+mboxNotEmpty(MBOX_ID mboxId)
+{
+    BOOL notEmpty;
+
+    if (!MBOX_RCV_LOCK(mboxId))
+	return FALSE;
+    notEmpty = h2rngNBytes(mboxLane(mboxId, mboxRcvLane(mboxId))) > 0;
+    MBOX_RCV_UNLOCK(mboxId);
+    return notEmpty;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxReadyCheck  -  Tell if a device of the ready set has messages
+ **/
+static BOOL
+mboxReadyCheck(MBOX_ID id, long task)
+{
+    if (id == ERROR)
+	return FALSE;
+    if (H2DEV_TYPE(id) == H2_DEV_TYPE_MBOXGRP)
+	return mboxGroupReady(id, task, FALSE);
+    return mboxNotEmpty(id);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxReadyGet  -  Collect the non-empty mailboxes of a task
+ **
+ **   Description:
+ **   Walks the ready set of the task: mailboxes and groups found empty
+ **   get their bit cleared, then are checked again in case a sender set
+ **   it in between. Stores up to maxIds ids in pReady. With maxIds == 0,
+ **   stops at the first non-empty one.
+ **
+ **   Returns: the number of non-empty mailboxes and groups found
+ **/
+static int
+mboxReadyGet(long task, MBOX_ID *pReady, int maxIds)
+{
+    unsigned int ready, bit;
+    int i, nMbox, n = 0;
+
+    ready = H2_LOAD_SEQ(&H2DEV_TASK_MBOX_READY(task));
+    for (i = 0; i < H2_TASK_MAX_MBOX && ready != 0; i++) {
+	bit = 1U << i;
+	if ((ready & bit) == 0)
+	    continue;
+	ready &= ~bit;
+	nMbox = H2_LOAD_SEQ(&H2DEV_TASK_MBOX(task, i));
+	if (!mboxReadyCheck(nMbox, task)) {
+	    H2_AND_SEQ(&H2DEV_TASK_MBOX_READY(task), ~bit);
+	    if (!mboxReadyCheck(nMbox, task))
+		continue;
+	    H2_OR_SEQ(&H2DEV_TASK_MBOX_READY(task), bit);
+	}
+	if (n < maxIds)
+	    pReady[n] = nMbox;
+	if (++n == 1 && maxIds == 0)
+	    return n;
+    }
+
+    /* Mailboxes and groups that did not fit in the ready set */
+    if (H2_LOAD_SEQ(&H2DEV_TASK_NMBOX_OTHER(task)) > 0) {
+	for (nMbox = h2devOwnerFirst(task); nMbox != ERROR;
+	     nMbox = h2devOwnerNext(nMbox, task)) {
+	    if (H2DEV_TYPE(nMbox) == H2_DEV_TYPE_MBOX
+		&& H2DEV_MBOX_TASK_ID(nMbox) == task
+		&& H2DEV_MBOX_SLOT(nMbox) < 0 && mboxNotEmpty(nMbox)) {
+		if (n < maxIds)
+		    pReady[n] = nMbox;
+		if (++n == 1 && maxIds == 0)
+		    return n;
+	    }
+	} /* for */
+	for (nMbox = h2devFirst(H2_DEV_TYPE_MBOXGRP); nMbox != ERROR;
+	     nMbox = h2devNext(nMbox, H2_DEV_TYPE_MBOXGRP)) {
+	    if (mboxGroupReady(nMbox, task, TRUE)) {
+		if (n < maxIds)
+		    pReady[n] = nMbox;
+		if (++n == 1 && maxIds == 0)
+		    return n;
+	    }
+	} /* for */
+    }
+    return n;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxPauseAll  - Wait for a message in any mailbox of the task
+ **
+ **   Description:
+ **   suspends the execution of the current task until one of its
+ **   mailboxes, or one of the groups it subscribed to, holds a message.
+ **   The ids of up to maxIds non-empty mailboxes and groups are stored
+ **   in pReady. Senders flag the mailbox or group in the ready set of
+ **   the task, so only those that received messages are looked at.
+ **
+ **   Returns: the number of non-empty mailboxes and groups (possibly more
+ **   than maxIds), FALSE on timeout or ERROR
+ **/
+int
+mboxPauseAll(MBOX_ID *pReady, int maxIds, int timeout)
+{
+    int n;
+    int takeStatus;             /* status of semTake() */
+    long myTaskId;              /* my task identifier */
+    H2WAKE *wake;
+
+    myTaskId = taskGetUserData(0);
+    /* get and flush my task synchronization event */
+    wake = H2DEV_TASK_WAKE(myTaskId);
+    h2wakeFlush(wake);
+
+    /* Wait for a message */
+    while (1) {
+	/* Check for messages in one of mailboxes attached to this task */
+	if ((n = mboxReadyGet(myTaskId, pReady, maxIds)) > 0)
+	    return n;
+
+	/* no message, wait for the synchronization event */
+	LOGDBG(("comLib:mboxPause: waiting on task %ld\n", myTaskId));
+	if ((takeStatus = h2wakeTake(wake, timeout)) != TRUE) {
+	    return (takeStatus);
+	}
+    } /* while */
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **   mboxGetFd  -  File descriptor signalling messages in a mailbox
+ **
+ **   Description:
+ **   Returns a descriptor that is readable while the mailbox holds
+ **   messages, to wait for them with poll(), select() or epoll together
+ **   with other descriptors. It is the read end of a fifo next to the h2
+ **   devices key file, written to by the senders when they signal the
+ **   reader, and drained by the receive functions when they empty the
+ **   mailbox. Only the owner of the mailbox may call it; the descriptor
+ **   must not be read nor closed, and stays valid until mboxDelete().
+ **
+ **   Returns: the descriptor or ERROR
+ **/
+int
+mboxGetFd(MBOX_ID mboxId)
+{
+    H2_MBOX_STR *mbox;
+    char path[MAXPATHLEN];
+    int rd, wr;
+
+    if (H2DEV_TYPE(mboxId) != H2_DEV_TYPE_MBOX) {
+	errnoSet(S_mboxLib_MBOX_CLOSED);
+	return ERROR;
+    }
+    mbox = H2DEV_MBOX_STR(mboxId);
+    if (mbox->fdArmed && mbox->fdPid == getpid())
+	return mbox->fdRd;
+
+    if (h2devGetPath(mboxId, "fifo", path, sizeof(path)) == ERROR)
+	return ERROR;
+    if (mkfifo(path, PORTLIB_MODE) < 0 && errno != EEXIST) {
+	errnoSet(errno);
+	return ERROR;
+    }
+    /* The reader keeps a write end too: the fifo never hangs up when
+       senders close theirs */
+    if ((rd = open(path, O_RDONLY | O_NONBLOCK)) < 0) {
+	errnoSet(errno);
+	unlink(path);
+	return ERROR;
+    }
+    if ((wr = open(path, O_WRONLY | O_NONBLOCK)) < 0) {
+	errnoSet(errno);
+	close(rd);
+	unlink(path);
+	return ERROR;
+    }
+    fcntl(rd, F_SETFD, FD_CLOEXEC);
+    fcntl(wr, F_SETFD, FD_CLOEXEC);
+    mbox->fdRd = rd;
+    mbox->fdWr = wr;
+    mbox->fdPid = getpid();
+    mbox->fdPending = 0;
+    H2_STORE_SEQ(&mbox->fdArmed, 1);
+
+    /* Messages sent before */
+    if (mboxNotEmpty(mboxId))
+	mboxFdNotify(mboxId);
+    return rd;
+}
+
 /*----------------------------------------------------------------------*/
 
 int
 mboxSpy(MBOX_ID mboxId, MBOX_ID *pFromId, int *pNbytes,
 	char *buf, int maxbytes)
 {
+    int nr;
+
     /* Spy the ring buffer */
-    return h2rngBlockSpy (smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(mboxId)),
-			   (int *)pFromId, pNbytes, buf, maxbytes);
+    if (!MBOX_RCV_LOCK(mboxId))
+	return ERROR;
+    nr = h2rngBlockSpy (mboxLane(mboxId, mboxRcvLane(mboxId)),
+			(int *)pFromId, pNbytes, buf, maxbytes);
+    MBOX_RCV_UNLOCK(mboxId);
+    return nr;
 }
 
 /*----------------------------------------------------------------------*/
@@ -528,8 +1713,18 @@ mboxSpy(MBOX_ID mboxId, MBOX_ID *pFromId, int *pNbytes,
 STATUS
 mboxSkip(MBOX_ID mboxId)
 {
+    STATUS status;
+
     /* Skip a message in the ring buffer */
-    return h2rngBlockSkip (smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(mboxId)));
+    if (!MBOX_RCV_LOCK(mboxId))
+	return ERROR;
+    status = h2rngBlockSkip (mboxLane(mboxId, mboxRcvLane(mboxId)));
+    MBOX_RCV_UNLOCK(mboxId);
+    if (status == ERROR)
+	return ERROR;
+    mboxWakeSenders(mboxId);
+    mboxFdReset(mboxId);
+    return OK;
 
 }
 
@@ -537,65 +1732,1004 @@ mboxSkip(MBOX_ID mboxId)
 /*----------------------------------------------------------------------*/
 
 /**
- **  mboxSend  -  Send a message to a mailbox
+ **  mboxSignal  -  Signal a new message to a mailbox owner
  **
  **  Description:
- **  Sends a message to a mailbox device. Takes the mutex semaphore
- **  for the device, check that it exists, computes the local address
- **  of the ring buffer for this device, writes the messages in the
- **  ring buffer and frees the synchronization semaphore to signal
- **  the mailbox owner that a message was written.
+ **  Frees the synchronization semaphore of the mailbox and the one of
+ **  the task owning it.
  **
  **  Returns: OK or ERROR
  **/
 
-STATUS
-mboxSend(MBOX_ID toId, MBOX_ID fromId, char *buf, int nbytes)
+static STATUS
+mboxSignal(MBOX_ID toId)
 {
-    H2RNG_ID rngId;			/* ring buffer of the device */
-    H2SEM_ID semTask;
-    int result;
     char msg[64];
+    int slot;
 
-    if (H2DEV_TYPE(toId) != H2_DEV_TYPE_MBOX) {
-      errnoSet(S_mboxLib_MBOX_CLOSED);
-      return ERROR;
+    /* Signal the mailbox that there's a message to read */
+    LOGDBG(("comLib:mboxSend: signaling mbox %d\n", toId));
+    if (h2wakeGive(H2DEV_MBOX_WAKE(toId)) == ERROR) {
+	logMsg("erreur give semSigRd\n");
+        return ERROR;
     }
-
+    /* Make the descriptor of mboxGetFd() readable */
+    if (H2_LOAD_SEQ(&H2DEV_MBOX_STR(toId)->fdArmed))
+	mboxFdNotify(toId);
+    /* Flag the mailbox in the ready set of its owner */
+    if ((slot = H2DEV_MBOX_SLOT(toId)) >= 0)
+	H2_OR_SEQ(&H2DEV_TASK_MBOX_READY(H2DEV_MBOX_TASK_ID(toId)), 1U << slot);
+    /* Signal the event to the task owning the mailbox */
+    if (h2wakeGive(H2DEV_TASK_WAKE(H2DEV_MBOX_TASK_ID(toId))) == ERROR) {
+      logMsg("comLib:mboxSend:h2wakeGive: %s",
+	     h2getErrMsg(errnoGet(), msg, 64));
+	return ERROR;
+    }
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxConflate  -  Replace the unread message of a sender
+ **
+ **  Description:
+ **  For MBOX_FLAG_CONFLATE mailboxes, overwrites in place the newest
+ **  unread message from fromId in lane prio, if it has the same size as
+ **  the new one and is not being looked at through mboxRcvPeek(). The
+ **  mutex semaphore of the mailbox must be taken.
+ **
+ **  Returns: TRUE if the message was replaced, FALSE otherwise
+ **/
+
+static BOOL
+mboxConflate(MBOX_ID toId, int prio, MBOX_ID fromId, const char *buf,
+	     int nbytes)
+{
+    H2_MBOX_STR *mbox = H2DEV_MBOX_STR(toId);
+    H2RNG_VIEW view;
+
+    if (!(mbox->flags & MBOX_FLAG_CONFLATE) || nbytes <= 0 ||
+	h2rngBlockFind(mboxLane(toId, prio), (int) fromId, &view) != nbytes)
+	return FALSE;
+    if (prio == mbox->peekPrio && view.pos == mbox->peekPos)
+	return FALSE;
+    memcpy(view.ptr[0], buf, view.len[0]);
+    if (view.len[1] != 0)
+	memcpy(view.ptr[1], buf + view.len[0], view.len[1]);
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSend  -  Send a message to a mailbox
+ **
+ **  Description:
+ **  Sends a message to a mailbox device. Takes the mutex semaphore
+ **  for the device, check that it exists, computes the local address
+ **  of the ring buffer for this device, writes the messages in the
+ **  ring buffer and frees the synchronization semaphore to signal
+ **  the mailbox owner that a message was written.
+ **  The mutex is not used for MBOX_FLAG_SPSC and MBOX_FLAG_MPSC
+ **  mailboxes.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxSend(MBOX_ID toId, MBOX_ID fromId, char *buf, int nbytes)
+{
+    return mboxSendPrio(toId, fromId, 0, buf, nbytes);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendPrio  -  Send a message in a priority lane
+ **
+ **  Description:
+ **  Like mboxSend(), in lane prio (0 to the number of lanes - 1) of a
+ **  mailbox created by mboxCreatePrio(). Higher lanes are read first.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxSendPrio(MBOX_ID toId, MBOX_ID fromId, int prio, char *buf, int nbytes)
+{
+    H2RNG_ID rngId;			/* ring buffer of the device */
+    int result;
+    unsigned int seq;
+    STATUS status;
+    BOOL excl;
+
+    if (H2DEV_TYPE(toId) != H2_DEV_TYPE_MBOX) {
+      errnoSet(S_mboxLib_MBOX_CLOSED);
+      return ERROR;
+    }
+    if (prio < 0 || prio >= H2DEV_MBOX_STR(toId)->nPrio) {
+      errnoSet(S_mboxLib_BAD_PRIO);
+      return ERROR;
+    }
+    excl = !MBOX_LOCK_FREE(toId);
+
     /* take the mutex semaphore of the device */
-    if (h2semTake (H2DEV_MBOX_SEM_EXCL_ID(toId), WAIT_FOREVER) != TRUE) {
+    if (excl &&
+	h2semTake (H2DEV_MBOX_SEM_EXCL_ID(toId), WAIT_FOREVER) != TRUE) {
 	return (ERROR);
     }
+    /* Replace the unread message of this sender in a conflating mailbox */
+    if (mboxConflate(toId, prio, fromId, buf, nbytes)) {
+	mboxStatSent(toId, prio, NULL, 1, nbytes);
+	h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+	return (OK);
+    }
     /* Get the local address of the ring buffer */
+    rngId = mboxLane(toId, prio);
+    seq = H2_LOAD_RELAXED(&rngId->nPut);
+
+    /* Write a block corresponding to the message, growing a full
+       MBOX_FLAG_GROW mailbox */
+    while ((result = h2rngBlockPut (rngId, (int) fromId, buf, nbytes)) == 0
+	   && mboxGrow(toId, nbytes)) {
+	rngId = mboxLane(toId, prio);
+	seq = rngId->nPut;
+    }
+    if (result != nbytes) {
+        LOGDBG(("comLib:mboxSend: wrote %d bytes in mbox %d\n", result, toId));
+	if (result == 0) {
+	    errnoSet (S_mboxLib_MBOX_FULL);
+	    mboxStatFull(toId);
+	}
+	if (excl) h2semGive (H2DEV_MBOX_SEM_EXCL_ID(toId));
+	return (ERROR);
+    }
+    mboxStatSent(toId, prio, MBOX_STAT_SEQ(toId, &seq), 1, nbytes);
+    /* Signal the reader */
+    status = mboxSignal(toId);
+
+    /* Free the mutex */
+    if (excl) h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+    if (status == ERROR)
+	return (ERROR);
+
+    /* OK, done */
+    LOGDBG(("comLib:mboxSend: wrote %d bytes in mbox %d\n", result, toId));
+    return (OK);
+
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendTimed  -  Send a message, waiting for room in the mailbox
+ **
+ **  Description:
+ **  Like mboxSend(), but when the mailbox is full the caller sleeps until
+ **  the reader removes messages, for at most timeout ticks (0 or
+ **  WAIT_FOREVER to wait forever). Blocked senders are all woken by the
+ **  receive functions, each one waiting on its own snapshot of the wake
+ **  up sequence, so that several of them can wait on the same mailbox
+ **  without missing a wake up. Each wait is counted and can be
+ **  read back with the FIO_NSENDBLOCKED ioctl.
+ **
+ **  Returns: OK or ERROR. errno is S_mboxLib_MBOX_FULL on timeout, and
+ **  S_mboxLib_TOO_BIG if the message cannot fit even in the empty mailbox.
+ **/
+
+STATUS
+mboxSendTimed(MBOX_ID toId, MBOX_ID fromId, char *buf, int nbytes,
+	      int timeout)
+{
+    H2_MBOX_STR *mbox;
+    H2RNG_ID rngId;			/* ring buffer of the device */
+    H2TIMESPEC start;
+    unsigned long elapsed;
+    int result, wait, used;
+    unsigned int seq, wakeSeq = 0;
+    BOOL excl, blocked = FALSE, empty = FALSE;
+    STATUS status = ERROR;
+
+    if (H2DEV_TYPE(toId) != H2_DEV_TYPE_MBOX) {
+      errnoSet(S_mboxLib_MBOX_CLOSED);
+      return ERROR;
+    }
+    mbox = H2DEV_MBOX_STR(toId);
+    excl = !MBOX_LOCK_FREE(toId);
+    if (timeout == 0)
+	timeout = WAIT_FOREVER;
+    if (timeout != WAIT_FOREVER)
+	h2GetTimeSpec(&start);
+
+    while (1) {
+	/* Wake ups given from now on end the wait below */
+	if (blocked)
+	    wakeSeq = h2wakeSeq(H2DEV_MBOX_WAKE_WR(toId));
+	/* take the mutex semaphore of the device */
+	if (excl &&
+	    h2semTake (H2DEV_MBOX_SEM_EXCL_ID(toId), WAIT_FOREVER) != TRUE)
+	    break;
+	rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+	if (mboxConflate(toId, 0, fromId, buf, nbytes)) {
+	    mboxStatSent(toId, 0, NULL, 1, nbytes);
+	    result = nbytes;
+	} else {
+	    seq = H2_LOAD_RELAXED(&rngId->nPut);
+	    while ((result = h2rngBlockPut (rngId, (int) fromId, buf, nbytes))
+		   == 0 && mboxGrow(toId, nbytes)) {
+		rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+		seq = rngId->nPut;
+	    }
+	    if (result == nbytes)
+		mboxStatSent(toId, 0, MBOX_STAT_SEQ(toId, &seq), 1, nbytes);
+	}
+	if (result == nbytes) {
+	    status = mboxSignal(toId);
+	    if (excl) h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+	    break;
+	}
+	used = h2rngNBytes(rngId);
+	if (excl) h2semGive (H2DEV_MBOX_SEM_EXCL_ID(toId));
+	if (result != 0)
+	    break;
+
+	/* No room at all in an empty mailbox: retry once, in case the
+	   reader emptied it just after the failed put */
+	if (used == 0) {
+	    if (empty) {
+		errnoSet(S_mboxLib_TOO_BIG);
+		break;
+	    }
+	    empty = TRUE;
+	    continue;
+	}
+	empty = FALSE;
+
+	/* Register as waiting, then try again before sleeping so that
+	   room made in between is not missed */
+	if (!blocked) {
+	    blocked = TRUE;
+	    H2_ADD_RELAXED(&mbox->nSendBlocked, 1);
+	    H2_ADD_SEQ(&mbox->sendWaiters, 1);
+	    continue;
+	}
+	wait = timeout;
+	if (timeout != WAIT_FOREVER) {
+	    h2timespecInterval(&start, &elapsed);
+	    wait = timeout - (int)(elapsed * sysClkRateGet() / 1000);
+	    if (wait <= 0) {
+		errnoSet(S_mboxLib_MBOX_FULL);
+		mboxStatFull(toId);
+		break;
+	    }
+	}
+	LOGDBG(("comLib:mboxSendTimed: waiting for room in mbox %d\n", toId));
+	if (h2wakeWait(H2DEV_MBOX_WAKE_WR(toId), &wakeSeq, wait) != TRUE) {
+	    if (errnoGet() == S_h2semLib_TIMEOUT) {
+		errnoSet(S_mboxLib_MBOX_FULL);
+		mboxStatFull(toId);
+	    }
+	    break;
+	}
+    }
+
+    if (blocked)
+	H2_SUB_SEQ(&mbox->sendWaiters, 1);
+    return status;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendV  -  Send a message gathered from several buffers
+ **
+ **  Description:
+ **  Like mboxSend(), but the message is made of the iovcnt segments of
+ **  iov, which are copied one after the other into the mailbox. This
+ **  avoids assembling a header and its payload in a staging buffer.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxSendV(MBOX_ID toId, MBOX_ID fromId, const struct iovec *iov, int iovcnt)
+{
+    H2RNG_ID rngId;			/* ring buffer of the device */
+    int result, i, nbytes;
+    unsigned int seq;
+    STATUS status;
+    BOOL excl;
+
+    if (H2DEV_TYPE(toId) != H2_DEV_TYPE_MBOX) {
+      errnoSet(S_mboxLib_MBOX_CLOSED);
+      return ERROR;
+    }
+    excl = !MBOX_LOCK_FREE(toId);
+
+    /* take the mutex semaphore of the device */
+    if (excl &&
+	h2semTake (H2DEV_MBOX_SEM_EXCL_ID(toId), WAIT_FOREVER) != TRUE) {
+	return (ERROR);
+    }
     rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
 
-    /* Write a block corresponding to the message */
-    if ((result = h2rngBlockPut (rngId, (int) fromId, buf, nbytes))
-	!= nbytes) {
-        LOGDBG(("comLib:mboxSend: wrote %d bytes in mbox %d\n", result, toId));
+    /* Write a block made of all the segments */
+    seq = H2_LOAD_RELAXED(&rngId->nPut);
+    for (i = 0, nbytes = 0; i < iovcnt; i++)
+	nbytes += iov[i].iov_len;
+    while ((result = h2rngBlockPutV (rngId, (int) fromId, iov, iovcnt)) == 0
+	   && mboxGrow(toId, nbytes)) {
+	rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+	seq = rngId->nPut;
+    }
+    if (result <= 0) {
 	if (result == 0) {
 	    errnoSet (S_mboxLib_MBOX_FULL);
+	    mboxStatFull(toId);
 	}
-	h2semGive (H2DEV_MBOX_SEM_EXCL_ID(toId));
+	if (excl) h2semGive (H2DEV_MBOX_SEM_EXCL_ID(toId));
 	return (ERROR);
     }
-    /* Signal the mailbox that there's a message to read */
-    LOGDBG(("comLib:mboxSend: signaling sem #%d\n", H2DEV_MBOX_SEM_ID(toId)));
-    if (h2semGive(H2DEV_MBOX_SEM_ID(toId)) == ERROR) {
-	logMsg("erreur give semSigRd\n");
-        return ERROR;
+    mboxStatSent(toId, 0, MBOX_STAT_SEQ(toId, &seq), 1, result);
+    /* Signal the reader */
+    status = mboxSignal(toId);
+
+    /* Free the mutex */
+    if (excl) h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+    LOGDBG(("comLib:mboxSendV: wrote %d bytes in mbox %d\n", result, toId));
+    return (status);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendN  -  Send several messages to a mailbox at once
+ **
+ **  Description:
+ **  Like mboxSend(), but writes nMsgs messages (bufs[i] of nbytes[i]
+ **  bytes) under a single take of the mutex and signals the mailbox
+ **  owner only once. Messages are sent in order until the mailbox is
+ **  full; in that case errno is set to S_mboxLib_MBOX_FULL.
+ **
+ **  Returns: number of messages sent, or ERROR if none could be sent
+ **/
+
+int
+mboxSendN(MBOX_ID toId, MBOX_ID fromId, int nMsgs, char * const *bufs,
+	  const int *nbytes)
+{
+    H2RNG_ID rngId;			/* ring buffer of the device */
+    int result, n, i, sent;
+    unsigned int seq;
+    BOOL excl;
+
+    if (H2DEV_TYPE(toId) != H2_DEV_TYPE_MBOX) {
+      errnoSet(S_mboxLib_MBOX_CLOSED);
+      return ERROR;
     }
-    /* Signal the event to the task owning the mailbox */
-    semTask = H2DEV_TASK_SEM_ID(H2DEV_MBOX_TASK_ID(toId));
-    if (h2semSet(semTask, 1) == ERROR) {
-      logMsg("comLib:mboxSend:h2semSet: %s", h2getErrMsg(errnoGet(), msg, 64));
-	return ERROR;
+    excl = !MBOX_LOCK_FREE(toId);
+
+    /* take the mutex semaphore of the device */
+    if (excl &&
+	h2semTake (H2DEV_MBOX_SEM_EXCL_ID(toId), WAIT_FOREVER) != TRUE) {
+	return (ERROR);
     }
+    /* Write as many blocks as possible, growing a full MBOX_FLAG_GROW
+       mailbox for the remaining ones */
+    result = 0;
+    do {
+	rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+	seq = H2_LOAD_RELAXED(&rngId->nPut);
+	n = h2rngBlockPutN (rngId, (int) fromId, nMsgs - result,
+			    bufs + result, nbytes + result);
+	if (n == ERROR) {
+	    if (result == 0)
+		result = ERROR;
+	    break;
+	}
+	if (n > 0) {
+	    for (i = result, sent = 0; i < result + n; i++)
+		sent += nbytes[i];
+	    mboxStatSent(toId, 0, MBOX_STAT_SEQ(toId, &seq), n, sent);
+	    result += n;
+	}
+    } while (result < nMsgs && mboxGrow(toId, nbytes[result]));
+    if (result > 0 && mboxSignal(toId) == ERROR)
+	result = ERROR;
+
     /* Free the mutex */
-    h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+    if (excl) h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+    if (result == ERROR)
+	return (ERROR);
+    if (result < nMsgs) {
+	errnoSet (S_mboxLib_MBOX_FULL);
+	mboxStatFull(toId);
+	if (result == 0)
+	    return (ERROR);
+    }
+    LOGDBG(("comLib:mboxSendN: wrote %d messages in mbox %d\n",
+	    result, toId));
+    return (result);
+}
 
-    /* OK, done */
-    LOGDBG(("comLib:mboxSend: wrote %d bytes in mbox %d\n", result, toId));
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendReserve  -  Reserve room for a message in a mailbox
+ **
+ **  Description:
+ **  Reserves room for a message of nbytes directly in the ring buffer
+ **  of a mailbox, so that the message can be built in place without an
+ **  intermediate buffer. view is filled with the one or two pieces of
+ **  the reserved area. On success, the mailbox mutex is kept until
+ **  mboxSendCommit() or mboxSendCancel() is called, which must happen
+ **  promptly.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxSendReserve(MBOX_ID toId, int nbytes, H2RNG_VIEW *view)
+{
+    H2RNG_ID rngId;
+    int result;
+    BOOL excl;
+
+    if (H2DEV_TYPE(toId) != H2_DEV_TYPE_MBOX) {
+      errnoSet(S_mboxLib_MBOX_CLOSED);
+      return ERROR;
+    }
+    /* a pending reservation would block the other senders */
+    if (H2DEV_MBOX_FLAGS(toId) & MBOX_FLAG_MPSC) {
+      errnoSet(S_mboxLib_BAD_FLAGS);
+      return ERROR;
+    }
+    excl = !MBOX_LOCK_FREE(toId);
+
+    /* take the mutex semaphore of the device */
+    if (excl &&
+	h2semTake (H2DEV_MBOX_SEM_EXCL_ID(toId), WAIT_FOREVER) != TRUE) {
+	return (ERROR);
+    }
+    rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+
+    while ((result = h2rngBlockReserve(rngId, nbytes, view)) == 0
+	   && mboxGrow(toId, nbytes))
+	rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+    if (result != nbytes) {
+	if (result == 0) {
+	    errnoSet (S_mboxLib_MBOX_FULL);
+	    mboxStatFull(toId);
+	}
+	if (excl) h2semGive (H2DEV_MBOX_SEM_EXCL_ID(toId));
+	return (ERROR);
+    }
     return (OK);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendCommit  -  Send a message built with mboxSendReserve
+ **
+ **  Description:
+ **  Publishes the nbytes (at most the reserved size) written in the
+ **  area reserved by mboxSendReserve(), signals the mailbox owner and
+ **  frees the mailbox mutex.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxSendCommit(MBOX_ID toId, MBOX_ID fromId, int nbytes, H2RNG_VIEW *view)
+{
+    H2RNG_ID rngId;
+    unsigned int seq;
+    STATUS status;
+    BOOL excl;
+
+    excl = !MBOX_LOCK_FREE(toId);
+    rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+
+    seq = H2_LOAD_RELAXED(&rngId->nPut);
+    status = h2rngBlockCommit(rngId, (int) fromId, nbytes, view);
+    if (status == OK) {
+	mboxStatSent(toId, 0, &seq, 1, nbytes);
+	status = mboxSignal(toId);
+    }
+
+    if (excl) h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+    return (status);
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxSendCancel  -  Drop a reservation made by mboxSendReserve
+ **
+ **  Description:
+ **  view must be the one filled by mboxSendReserve(), like for
+ **  mboxSendCommit(). It is then marked as used, so that it cannot
+ **  free the mailbox mutex twice. A view that does not match the pending
+ **  reservation fails with S_h2rngLib_ERR_SYNC and leaves the mutex as is.
+ **
+ **  Returns: OK or ERROR
+ **/
 
+STATUS
+mboxSendCancel(MBOX_ID toId, H2RNG_VIEW *view)
+{
+    H2RNG_ID rngId;
+
+    rngId = (H2RNG_ID)smObjGlobalToLocal(H2DEV_MBOX_RNG_ID(toId));
+
+    /* the reservation must match the write pointer */
+    if (view == NULL || view->pos != rngId->pWr) {
+	errnoSet(S_h2rngLib_ERR_SYNC);
+	return (ERROR);
+    }
+    view->pos = -1;
+
+    if (MBOX_LOCK_FREE(toId))
+	return (OK);
+    return h2semGive(H2DEV_MBOX_SEM_EXCL_ID(toId));
+}
+
+/*----------------------------------------------------------------------*/
+
+/*
+ * Mailbox groups
+ *
+ * A message sent to a group is written once in a ring shared by all the
+ * subscribers, each of them reading it at its own position. The room
+ * taken by a message is given back once the slowest subscriber read it.
+ * Positions only grow, and wrap around the data at a power of 2 size.
+ * A message is stored as its size, the id of its sender and its data
+ * padded to 4 bytes. Senders and subscribers access the group with its
+ * lock held.
+ */
+
+#define MBOXGRP_HDR_SIZE (2 * sizeof(int))
+#define MBOXGRP_BLK_SIZE(nbytes) (MBOXGRP_HDR_SIZE + (((nbytes) + 3) & ~3))
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupCopy  -  Copy to or from the data of a group at a position
+ **/
+
+static void
+mboxGroupCopy(H2_MBOXGRP_STR *grp, unsigned int pos, char *buf, int n,
+	      BOOL in)
+{
+    char *pData = smObjGlobalToLocal(grp->pData);
+    unsigned int off = pos & (grp->size - 1);
+    int ntop = grp->size - off;
+
+    if (ntop > n)
+	ntop = n;
+    if (in) {
+	memcpy(pData + off, buf, ntop);
+	memcpy(pData, buf + ntop, n - ntop);
+    } else {
+	memcpy(buf, pData + off, ntop);
+	memcpy(buf + ntop, pData, n - ntop);
+    }
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupSub  -  Subscription of a task to a group
+ **
+ **  Returns: the subscriber entry, or NULL if the task is not subscribed
+ **/
+
+static H2_MBOXGRP_SUB *
+mboxGroupSub(H2_MBOXGRP_STR *grp, long task)
+{
+    int i;
+
+    for (i = 0; i < H2_MBOXGRP_MAX_SUBS; i++)
+	if (grp->sub[i].task == task)
+	    return &grp->sub[i];
+    return NULL;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupReady  -  Tell if a group has a message for a subscriber
+ **
+ **  Description:
+ **  With other, only a subscription outside the ready set of the task
+ **  counts.
+ **/
+
+static BOOL
+mboxGroupReady(MBOX_ID grpId, long task, BOOL other)
+{
+    H2_MBOXGRP_STR *grp;
+    H2_MBOXGRP_SUB *sub;
+    BOOL ready;
+
+    if (H2DEV_TYPE(grpId) != H2_DEV_TYPE_MBOXGRP)
+	return FALSE;
+    grp = H2DEV_MBOXGRP_STR(grpId);
+    if (h2semTake(grp->semExcl, WAIT_FOREVER) != TRUE)
+	return FALSE;
+    ready = (sub = mboxGroupSub(grp, task)) != NULL &&
+	(!other || sub->slot < 0) && sub->rd != grp->wr;
+    h2semGive(grp->semExcl);
+    return ready;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupCreate  -  Create a mailbox group
+ **
+ **  Description:
+ **  Creates a group holding at least size bytes of messages. Tasks
+ **  subscribe to it with mboxGroupJoin() and read the messages sent with
+ **  mboxGroupSend() with mboxGroupRcv().
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxGroupCreate(const char *name, int size, MBOX_ID *pGrpId)
+{
+    H2_MBOXGRP_STR *grp;
+    MBOX_ID dev;
+    char *pData;
+    int i, n;
+
+    if (size <= 0 || size > (1 << 30)) {
+	errnoSet(S_h2rngLib_ILLEGAL_NBYTES);
+	return ERROR;
+    }
+    for (n = 64; n < size; n *= 2)
+	;
+
+    /* Allocate a h2 device */
+    dev = h2devAlloc(name, H2_DEV_TYPE_MBOXGRP);
+    if (dev == ERROR) {
+	return ERROR;
+    }
+    grp = H2DEV_MBOXGRP_STR(dev);
+    if ((grp->semExcl = h2semAlloc(H2SEM_EXCL)) == ERROR) {
+	int e = errnoGet();
+	h2devFree(dev);
+	errnoSet(e);
+	return ERROR;
+    }
+    if ((pData = smMemMalloc(n)) == NULL) {
+	int e = errnoGet();
+	h2semDelete(grp->semExcl);
+	h2devFree(dev);
+	errnoSet(e);
+	return ERROR;
+    }
+    grp->pData = smObjLocalToGlobal(pData);
+    grp->size = n;
+    grp->wr = 0;
+    grp->taskId = taskGetUserData(0);
+    for (i = 0; i < H2_MBOXGRP_MAX_SUBS; i++) {
+	grp->sub[i].task = ERROR;
+	grp->sub[i].slot = -1;
+    }
+
+    LOGDBG(("comLib:mboxGroupCreate: created group %d\n", dev));
+    *pGrpId = dev;
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupDelete  -  Delete a mailbox group
+ **
+ **  Description:
+ **  Subscribers waiting in mboxGroupRcv() are woken up and get an error.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxGroupDelete(MBOX_ID grpId)
+{
+    uid_t uid = getuid();
+    H2_MBOXGRP_STR *grp;
+    H2_MBOXGRP_SUB subs[H2_MBOXGRP_MAX_SUBS];
+    int i, task;
+
+    if (H2DEV_TYPE(grpId) != H2_DEV_TYPE_MBOXGRP) {
+	errnoSet(S_mboxLib_MBOX_CLOSED);
+	return ERROR;
+    }
+    if (uid != H2DEV_UID(grpId) && uid != H2DEV_UID(0)) {
+	errnoSet(S_mboxLib_NOT_OWNER);
+	return ERROR;
+    }
+    grp = H2DEV_MBOXGRP_STR(grpId);
+    /* no sender may be writing the messages while they are freed */
+    if (h2semTake(grp->semExcl, WAIT_FOREVER) != TRUE)
+	return ERROR;
+    memcpy(subs, grp->sub, sizeof(subs));
+    smMemFree(smObjGlobalToLocal(grp->pData));
+    h2semDelete(grp->semExcl);
+    h2devFree(grpId);
+
+    /* the subscribers woken up now find the group deleted */
+    for (i = 0; i < H2_MBOXGRP_MAX_SUBS; i++)
+	if ((task = subs[i].task) != ERROR &&
+	    H2DEV_TYPE(task) == H2_DEV_TYPE_TASK) {
+	    mboxTaskSlotFree(task, grpId, subs[i].slot);
+	    h2wakeGive(H2DEV_TASK_WAKE(task));
+	}
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupFind  -  Look for a mailbox group by name
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxGroupFind(const char *name, MBOX_ID *pGrpId)
+{
+    MBOX_ID grp;
+
+    grp = h2devFind(name, H2_DEV_TYPE_MBOXGRP);
+    if (grp == ERROR) {
+	return ERROR;
+    }
+    *pGrpId = grp;
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupJoin  -  Subscribe the current task to a mailbox group
+ **
+ **  Description:
+ **  The task, which must have called mboxInit(), receives the messages
+ **  sent to the group from now on. The group is put in the ready set of
+ **  the task, and it is woken up through the same event as its
+ **  mailboxes.
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxGroupJoin(MBOX_ID grpId)
+{
+    H2_MBOXGRP_STR *grp;
+    long task = taskGetUserData(0);
+    H2_MBOXGRP_SUB *sub;
+
+    if (H2DEV_TYPE(grpId) != H2_DEV_TYPE_MBOXGRP) {
+	errnoSet(S_mboxLib_MBOX_CLOSED);
+	return ERROR;
+    }
+    if (task == 0 || H2DEV_TYPE(task) != H2_DEV_TYPE_TASK) {
+	errnoSet(S_mboxLib_NOT_OWNER);
+	return ERROR;
+    }
+    grp = H2DEV_MBOXGRP_STR(grpId);
+    if (h2semTake(grp->semExcl, WAIT_FOREVER) != TRUE)
+	return ERROR;
+    if (mboxGroupSub(grp, task) == NULL) {
+	if ((sub = mboxGroupSub(grp, ERROR)) == NULL) {
+	    h2semGive(grp->semExcl);
+	    errnoSet(S_mboxLib_GROUP_FULL);
+	    return ERROR;
+	}
+	sub->rd = grp->wr;
+	sub->slot = mboxTaskSlotAlloc(task, grpId);
+	sub->task = task;
+    }
+    h2semGive(grp->semExcl);
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupDrop  -  Remove a subscriber from a mailbox group
+ **/
+
+static STATUS
+mboxGroupDrop(MBOX_ID grpId, long task)
+{
+    H2_MBOXGRP_STR *grp = H2DEV_MBOXGRP_STR(grpId);
+    H2_MBOXGRP_SUB *sub;
+
+    if (h2semTake(grp->semExcl, WAIT_FOREVER) != TRUE)
+	return ERROR;
+    if ((sub = mboxGroupSub(grp, task)) != NULL) {
+	mboxTaskSlotFree(task, grpId, sub->slot);
+	sub->task = ERROR;
+    }
+    h2semGive(grp->semExcl);
+    if (sub == NULL) {
+	errnoSet(S_mboxLib_NOT_SUBSCRIBED);
+	return ERROR;
+    }
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupLeave  -  Unsubscribe the current task from a mailbox group
+ **
+ **  Returns: OK or ERROR
+ **/
+
+STATUS
+mboxGroupLeave(MBOX_ID grpId)
+{
+    if (H2DEV_TYPE(grpId) != H2_DEV_TYPE_MBOXGRP) {
+	errnoSet(S_mboxLib_MBOX_CLOSED);
+	return ERROR;
+    }
+    return mboxGroupDrop(grpId, taskGetUserData(0));
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupSend  -  Send a message to all the subscribers of a group
+ **
+ **  Description:
+ **  The message is copied once in the group and every subscriber is
+ **  woken up. Subscribers whose task disappeared are dropped.
+ **
+ **  Returns: OK or ERROR. errno is S_mboxLib_MBOX_FULL if the slowest
+ **  subscriber did not leave enough room.
+ **/
+
+STATUS
+mboxGroupSend(MBOX_ID grpId, MBOX_ID fromId, char *buf, int nbytes)
+{
+    H2_MBOXGRP_STR *grp;
+    unsigned int used, lag;
+    int i, nt, task, hdr[2];
+
+    if (H2DEV_TYPE(grpId) != H2_DEV_TYPE_MBOXGRP) {
+	errnoSet(S_mboxLib_MBOX_CLOSED);
+	return ERROR;
+    }
+    if (nbytes <= 0) {
+	errnoSet(S_h2rngLib_ILLEGAL_NBYTES);
+	return ERROR;
+    }
+    grp = H2DEV_MBOXGRP_STR(grpId);
+    nt = MBOXGRP_BLK_SIZE(nbytes);
+    if (nt > grp->size) {
+	errnoSet(S_mboxLib_TOO_BIG);
+	return ERROR;
+    }
+    if (h2semTake(grp->semExcl, WAIT_FOREVER) != TRUE)
+	return ERROR;
+
+    /* Room left behind the slowest subscriber */
+    used = 0;
+    for (i = 0; i < H2_MBOXGRP_MAX_SUBS; i++) {
+	if ((task = grp->sub[i].task) == ERROR)
+	    continue;
+	if (H2DEV_TYPE(task) != H2_DEV_TYPE_TASK) {
+	    grp->sub[i].task = ERROR;
+	    continue;
+	}
+	lag = grp->wr - grp->sub[i].rd;
+	if (lag > used)
+	    used = lag;
+    }
+    if (grp->size - used < (unsigned int)nt) {
+	h2semGive(grp->semExcl);
+	errnoSet(S_mboxLib_MBOX_FULL);
+	return ERROR;
+    }
+
+    /* Write the message and publish it */
+    hdr[0] = nbytes;
+    hdr[1] = fromId;
+    mboxGroupCopy(grp, grp->wr, (char *)hdr, MBOXGRP_HDR_SIZE, TRUE);
+    mboxGroupCopy(grp, grp->wr + MBOXGRP_HDR_SIZE, buf, nbytes, TRUE);
+    grp->wr += nt;
+
+    /* Flag the group in the ready set of every subscriber and signal it */
+    for (i = 0; i < H2_MBOXGRP_MAX_SUBS; i++) {
+	if ((task = grp->sub[i].task) == ERROR)
+	    continue;
+	if (grp->sub[i].slot >= 0)
+	    H2_OR_SEQ(&H2DEV_TASK_MBOX_READY(task), 1U << grp->sub[i].slot);
+	h2wakeGive(H2DEV_TASK_WAKE(task));
+    }
+    h2semGive(grp->semExcl);
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
+/**
+ **  mboxGroupRcv  -  Receive the next message of a group
+ **
+ **  Description:
+ **  Like mboxRcv(), for a group the current task subscribed to. The
+ **  message is copied with the lock of the group held, so that it cannot
+ **  be deleted meanwhile. A message larger than maxbytes is skipped, with
+ **  errno set to S_h2rngLib_SMALL_BUF.
+ **
+ **  Returns: number of bytes of the message, FALSE on timeout or ERROR
+ **/
+
+int
+mboxGroupRcv(MBOX_ID grpId, MBOX_ID *pFromId, char *buf, int maxbytes,
+	     int timeout)
+{
+    H2_MBOXGRP_STR *grp;
+    H2_MBOXGRP_SUB *sub;
+    long task = taskGetUserData(0);
+    unsigned int rd;
+    int takeStat, hdr[2];
+    BOOL flushed = FALSE;
+
+    while (1) {
+	if (H2DEV_TYPE(grpId) != H2_DEV_TYPE_MBOXGRP) {
+	    errnoSet(S_mboxLib_MBOX_CLOSED);
+	    return ERROR;
+	}
+	grp = H2DEV_MBOXGRP_STR(grpId);
+	/* mboxGroupDelete() frees the messages with the lock held */
+	if (h2semTake(grp->semExcl, WAIT_FOREVER) != TRUE) {
+	    errnoSet(S_mboxLib_MBOX_CLOSED);
+	    return ERROR;
+	}
+	if ((sub = mboxGroupSub(grp, task)) == NULL) {
+	    h2semGive(grp->semExcl);
+	    errnoSet(S_mboxLib_NOT_SUBSCRIBED);
+	    return ERROR;
+	}
+
+	/* Check if a message is available */
+	rd = sub->rd;
+	if (rd != grp->wr) {
+	    mboxGroupCopy(grp, rd, (char *)hdr, MBOXGRP_HDR_SIZE, FALSE);
+	    if (hdr[0] <= maxbytes) {
+		mboxGroupCopy(grp, rd + MBOXGRP_HDR_SIZE, buf, hdr[0], FALSE);
+		if (pFromId != NULL)
+		    *pFromId = hdr[1];
+	    }
+	    /* give the room back to the senders */
+	    sub->rd = rd + MBOXGRP_BLK_SIZE(hdr[0]);
+	    h2semGive(grp->semExcl);
+	    if (hdr[0] > maxbytes) {
+		errnoSet(S_h2rngLib_SMALL_BUF);
+		return ERROR;
+	    }
+	    return hdr[0];
+	}
+	h2semGive(grp->semExcl);
+
+	/* Flush the synchronisation event before the first wait and check
+	   again, so that no signal is lost */
+	if (!flushed) {
+	    h2wakeFlush(H2DEV_TASK_WAKE(task));
+	    flushed = TRUE;
+	    continue;
+	}
+
+	/* otherwise, wait */
+	if ((takeStat = h2wakeTake(H2DEV_TASK_WAKE(task), timeout)) != TRUE)
+	    return (takeStat);
+    }
 }
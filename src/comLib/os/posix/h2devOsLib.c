@@ -19,6 +19,9 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -28,6 +31,7 @@
 #include <sys/utsname.h>
 #include <signal.h>
 #include <limits.h>
+#include <ctype.h>
 #include <pthread.h>
 
 #include "portLib.h"
@@ -49,22 +53,123 @@
 #error "POSTER_SERV_PATH should be set"
 #endif
 
+/*
+ * The device table is made of chained shared memory segments, attached
+ * one after the other in an address range reserved for the largest
+ * table, so that h2Devs stays a plain array. The first segment starts
+ * with a header describing the segments and the name index. Segments
+ * hold a multiple of H2DEV_CHUNK_UNIT devices so that they are page
+ * aligned. With the POSIX backend, the segments are shm_open(3)
+ * objects named after the key of the devices and the segment number.
+ */
+typedef struct H2DEV_HDR {
+    int nDevs;			/* number of devices, published last */
+    int nChunks;
+    int shmFlags;		/* H2DEV_SHM_* options of the creator */
+    int typeHead[H2DEV_MAX_TYPES];	/* lists of devices by type */
+    struct {
+	int shmid;		/* -1 for a POSIX object */
+	int start;		/* index of the first device */
+	int n;			/* number of devices */
+    } chunk[H2_DEV_MAX_CHUNKS];
+} H2DEV_HDR;
+
+#define H2DEV_PAGE_ROUND(x) (((x) + h2devPageSize - 1) & ~(h2devPageSize - 1))
+#define H2DEV_PREFIX_SIZE \
+    H2DEV_PAGE_ROUND(sizeof(H2DEV_HDR) + H2_DEV_HASH_SLOTS * sizeof(int))
+#define H2DEV_CHUNK_ROUND(n) \
+    (((n) + h2devChunkUnit - 1) / h2devChunkUnit * h2devChunkUnit)
+#define H2DEV_RESERVE_SIZE \
+    (H2DEV_PREFIX_SIZE + H2DEV_CHUNK_ROUND(H2_DEV_MAX_LIMIT) * sizeof(H2_DEV_STR))
+
 /**
  ** Global variables
  **/
 
 H2_DEV_STR *h2Devs = NULL;
+int *h2devHash = NULL;
+int *h2devTypeHead = NULL;
+int h2devMapped = 0;		/* number of devices mapped locally */
 H2_DEV_STR h2DevInvalid = { .type = H2_DEV_TYPE_NONE, .uid = -1 };
-static int h2devMaxCur = -1;
+
+static char *h2devBase = NULL;	/* reserved address range */
+static H2DEV_HDR *h2devHdr = NULL;
+static int h2devChunksMapped = 0;
+static size_t h2devPageSize;
+static int h2devChunkUnit;
+static int h2devShmFlags = 0;	/* options for the next h2devInit() */
+static key_t h2devShmKey = -1;	/* names the POSIX objects */
 
 static int shmid = -1;
 static char h2devFileName[MAXPATHLEN];
+static char h2devNamespace[H2DEV_MAX_NAMESPACE];	/* set by the process */
 static pthread_mutex_t h2devMutex = PTHREAD_MUTEX_INITIALIZER;
 static int posterServPid = -1;		/* pid du serveur de posters */
 static char const posterServPath[] = POSTER_SERV_PATH;
 
 /*----------------------------------------------------------------------*/
 
+/**
+ ** Check the name of a namespace: letters, digits and underscores
+ **/
+static BOOL
+h2devNamespaceValid(const char *name)
+{
+    size_t i;
+
+    for (i = 0; name[i] != '\0'; i++)
+	if (!isalnum((unsigned char)name[i]) && name[i] != '_')
+	    return FALSE;
+    return i < H2DEV_MAX_NAMESPACE;
+}
+
+/**
+ ** Select the namespace of the h2 devices used by the process, before
+ ** h2devInit() or h2devAttach(). NULL or "" select the default one, or
+ ** the one named by $H2DEV_NAMESPACE.
+ **/
+STATUS
+h2devSetNamespace(const char *name)
+{
+    char old[H2DEV_MAX_NAMESPACE];
+
+    if (name == NULL)
+	name = "";
+    if (!h2devNamespaceValid(name)) {
+	errnoSet(S_h2devLib_BAD_PARAMETERS);
+	return ERROR;
+    }
+    if (h2Devs == NULL) {
+	strcpy(h2devNamespace, name);
+	return OK;
+    }
+    /* the devices of the current namespace are already mapped */
+    snprintf(old, sizeof(old), "%s", h2devGetNamespace());
+    strcpy(h2devNamespace, name);
+    if (strcmp(old, h2devGetNamespace()) != 0) {
+	strcpy(h2devNamespace, old);
+	errnoSet(S_h2devLib_BAD_PARAMETERS);
+	return ERROR;
+    }
+    return OK;
+}
+
+/**
+ ** Namespace of the h2 devices, "" for the default one
+ **/
+const char *
+h2devGetNamespace(void)
+{
+    const char *name;
+
+    if (h2devNamespace[0] != '\0')
+	return h2devNamespace;
+    name = getenv("H2DEV_NAMESPACE");
+    return name != NULL ? name : "";
+}
+
+/*----------------------------------------------------------------------*/
+
 /**
  ** Find the IPC key corresponding to a h2 device
  **
@@ -77,6 +182,7 @@ long
 h2devGetKey(int type, int dev, BOOL create, int *pFd)
 {
     char *home;
+    const char *ns;
     key_t key;
     struct utsname uts;
     int fd = -1;
@@ -112,10 +218,17 @@ h2devGetKey(int type, int dev, BOOL create, int *pFd)
 	errnoSet(errno);
 	return ERROR;
     }
+    /* Each namespace has its own key file */
+    ns = h2devGetNamespace();
+    if (!h2devNamespaceValid(ns)) {
+	errnoSet(S_h2devLib_BAD_PARAMETERS);
+	return ERROR;
+    }
     /* Check the length of the string */
     if (snprintf(
-          h2devFileName, sizeof(h2devFileName), "%s/%s-%s.%d",
-          home, H2_DEV_NAME, uts.nodename, libcomLib_MAJOR) >= MAXPATHLEN) {
+          h2devFileName, sizeof(h2devFileName), "%s/%s%s%s-%s.%d",
+          home, H2_DEV_NAME, ns[0] != '\0' ? "." : "", ns, uts.nodename,
+          libcomLib_MAJOR) >= MAXPATHLEN) {
 	errnoSet(S_h2devLib_BAD_HOME_DIR);
 	return ERROR;
     }
@@ -162,6 +275,373 @@ h2devGetKey(int type, int dev, BOOL create, int *pFd)
 
 /*----------------------------------------------------------------------*/
 
+/**
+ ** Reserve the address range of the device table
+ **/
+static STATUS
+h2devReserve(void)
+{
+    size_t a, b, t;
+
+    if (h2devBase != NULL)
+	return OK;
+    h2devPageSize = sysconf(_SC_PAGESIZE);
+    /* smallest number of devices filling whole pages */
+    for (a = sizeof(H2_DEV_STR), b = h2devPageSize; b != 0; t = b, b = a % b, a = t)
+	;
+    h2devChunkUnit = h2devPageSize / a;
+
+    h2devBase = mmap(NULL, H2DEV_RESERVE_SIZE, PROT_NONE,
+		     MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+    if (h2devBase == MAP_FAILED) {
+	h2devBase = NULL;
+	errnoSet(errno);
+	return ERROR;
+    }
+    return OK;
+}
+
+/**
+ ** Select the shared memory backend of the next h2devInit(). The
+ ** processes attaching to the devices follow the choice of their creator.
+ **/
+STATUS
+h2devSetShmFlags(int flags)
+{
+    if ((flags & ~H2DEV_SHM_ALL) != 0) {
+	errnoSet(S_h2devLib_BAD_PARAMETERS);
+	return ERROR;
+    }
+    /* the options are only available with shm_open(3) */
+    if (flags != 0)
+	flags |= H2DEV_SHM_POSIX;
+    h2devShmFlags = flags;
+    return OK;
+}
+
+/**
+ ** Backend options of the current devices
+ **/
+int
+h2devGetShmFlags(void)
+{
+    if (h2devHdr == NULL)
+	return h2devShmFlags;
+    return h2devHdr->shmFlags;
+}
+
+/* Longest name of a POSIX shared memory object of the h2 devices */
+#define H2DEV_SHM_NAME_MAX 64
+
+/* Where the system shows its POSIX shared memory objects, if anywhere */
+#define H2DEV_SHM_DIR "/dev/shm"
+
+/**
+ ** Name of a POSIX shared memory object of the h2 devices
+ **/
+static void
+h2devShmName(const char *what, char *name, size_t len)
+{
+    snprintf(name, len, "/h2dev.%08x.%s", (unsigned int)h2devShmKey, what);
+}
+
+/**
+ ** Apply the backend options to a new mapping. Only the creator of the
+ ** object fails if the memory cannot be locked.
+ **/
+static STATUS
+h2devShmAdvise(char *addr, size_t len, int flags, BOOL create)
+{
+    size_t i;
+
+    if (flags & H2DEV_SHM_HUGE) {
+#ifdef MADV_HUGEPAGE
+	madvise(addr, len, MADV_HUGEPAGE);
+#endif
+	/* prefault after the advice, not with MAP_POPULATE */
+	if (flags & H2DEV_SHM_POPULATE) {
+#ifdef MADV_POPULATE_WRITE
+	    if (madvise(addr, len, MADV_POPULATE_WRITE) < 0)
+#endif
+		for (i = 0; i < len; i += h2devPageSize)
+		    __atomic_fetch_add(addr + i, 0, __ATOMIC_RELAXED);
+	}
+    }
+    if ((flags & H2DEV_SHM_MLOCK) && mlock(addr, len) < 0 && create) {
+	errnoSet(errno);
+	return ERROR;
+    }
+    return OK;
+}
+
+/**
+ ** Map the POSIX shared memory object 'what' of the h2 devices at addr,
+ ** or anywhere if addr is NULL. The object is created with size *len if
+ ** create is TRUE, otherwise its size is returned in *len.
+ **/
+void *
+h2devShmMap(const char *what, size_t *len, void *addr, int flags,
+	    BOOL create)
+{
+    char name[H2DEV_SHM_NAME_MAX];
+    struct stat st;
+    int fd, mflags = MAP_SHARED;
+    int err;
+    void *p;
+
+    h2devShmName(what, name, sizeof(name));
+    fd = shm_open(name, O_RDWR | (create ? O_CREAT | O_EXCL : 0),
+		  PORTLIB_MODE);
+    if (fd < 0) {
+	errnoSet(errno);
+	return NULL;
+    }
+    if (create ? ftruncate(fd, *len) < 0 : fstat(fd, &st) < 0) {
+	err = S_smObjLib_SHMGET_ERROR;
+	goto fail;
+    }
+    if (!create)
+	*len = st.st_size;
+    if (addr != NULL)
+	mflags |= MAP_FIXED;
+#ifdef MAP_POPULATE
+    if ((flags & (H2DEV_SHM_POPULATE | H2DEV_SHM_HUGE)) == H2DEV_SHM_POPULATE)
+	mflags |= MAP_POPULATE;
+#endif
+    p = mmap(addr, *len, PROT_READ | PROT_WRITE, mflags, fd, 0);
+    if (p == MAP_FAILED) {
+	err = S_smObjLib_SHMAT_ERROR;
+	goto fail;
+    }
+    close(fd);
+    if (h2devShmAdvise(p, *len, flags, create) == ERROR) {
+	if (addr == NULL)
+	    munmap(p, *len);
+	shm_unlink(name);
+	return NULL;
+    }
+    return p;
+
+  fail:
+    close(fd);
+    if (create)
+	shm_unlink(name);
+    errnoSet(err);
+    return NULL;
+}
+
+/**
+ ** Open the POSIX shared memory object 'what' of the h2 devices, for
+ ** the users that map it themselves. Returns a descriptor or ERROR.
+ **/
+int
+h2devShmOpen(const char *what, int oflag)
+{
+    char name[H2DEV_SHM_NAME_MAX];
+    int fd;
+
+    h2devShmName(what, name, sizeof(name));
+    if ((fd = shm_open(name, oflag, PORTLIB_MODE)) < 0) {
+	errnoSet(errno);
+	return ERROR;
+    }
+    return fd;
+}
+
+/**
+ ** Remove a POSIX shared memory object of the h2 devices
+ **/
+STATUS
+h2devShmUnlink(const char *what)
+{
+    char name[H2DEV_SHM_NAME_MAX];
+
+    h2devShmName(what, name, sizeof(name));
+    if (shm_unlink(name) < 0) {
+	errnoSet(errno);
+	return ERROR;
+    }
+    return OK;
+}
+
+/**
+ ** Remove the POSIX objects left over by devices that were not
+ ** destroyed, once the key file is created. Objects with variable names,
+ ** like those of the mirrored ring buffers, are only found where the
+ ** system lists them.
+ **/
+static void
+h2devShmClean(void)
+{
+    char name[H2DEV_SHM_NAME_MAX], what[16];
+    DIR *dir;
+    struct dirent *e;
+    size_t len;
+    int c;
+
+    for (c = 0; c < H2_DEV_MAX_CHUNKS; c++) {
+	snprintf(what, sizeof(what), "%d", c);
+	h2devShmName(what, name, sizeof(name));
+	shm_unlink(name);
+    }
+    h2devShmName(SM_MEM_NAME, name, sizeof(name));
+    shm_unlink(name);
+
+    if ((dir = opendir(H2DEV_SHM_DIR)) == NULL)
+	return;
+    h2devShmName("", name, sizeof(name));
+    len = strlen(name + 1);
+    while ((e = readdir(dir)) != NULL)
+	if (strncmp(e->d_name, name + 1, len) == 0)
+	    h2devShmUnlink(e->d_name + len);
+    closedir(dir);
+}
+
+/**
+ ** Attach a segment at addr, within the reserved range
+ **/
+static STATUS
+h2devShmAt(int id, char *addr, size_t len)
+{
+    void *p;
+
+#ifdef SHM_REMAP
+    p = shmat(id, addr, SHM_REMAP);
+#else
+    munmap(addr, len);
+    p = shmat(id, addr, 0);
+#endif
+    if (p == (void *)-1) {
+	errnoSet(S_smObjLib_SHMAT_ERROR);
+	return ERROR;
+    }
+    return OK;
+}
+
+/**
+ ** Address of the first device of a segment
+ **/
+static char *
+h2devChunkAddr(int start)
+{
+    return h2devBase + H2DEV_PREFIX_SIZE + start * sizeof(H2_DEV_STR);
+}
+
+/**
+ ** Map the segments added by other processes. h2devMutex must be held.
+ **/
+static STATUS
+h2devMapChunks(void)
+{
+    int nDevs = __atomic_load_n(&h2devHdr->nDevs, __ATOMIC_ACQUIRE);
+    int c;
+    char what[16];
+    size_t len;
+
+    while (h2devMapped < nDevs) {
+	c = h2devChunksMapped;
+	len = h2devHdr->chunk[c].n * sizeof(H2_DEV_STR);
+	if (c > 0 && h2devHdr->chunk[c].shmid == -1) {
+	    snprintf(what, sizeof(what), "%d", c);
+	    if (h2devShmMap(what, &len,
+		    h2devChunkAddr(h2devHdr->chunk[c].start),
+		    h2devHdr->shmFlags, FALSE) == NULL)
+		return ERROR;
+	} else if (c > 0 && h2devShmAt(h2devHdr->chunk[c].shmid,
+		h2devChunkAddr(h2devHdr->chunk[c].start), len) == ERROR)
+	    return ERROR;
+	h2devChunksMapped = c + 1;
+	h2devMapped = h2devHdr->chunk[c].start + h2devHdr->chunk[c].n;
+    }
+    return OK;
+}
+
+/**
+ ** Make device idx accessible, if it was added by another process
+ **/
+STATUS
+h2devExtend(unsigned int idx)
+{
+    STATUS status;
+
+    if (h2devHdr == NULL)
+	return ERROR;
+    pthread_mutex_lock(&h2devMutex);
+    status = h2devMapChunks();
+    pthread_mutex_unlock(&h2devMutex);
+    if (status == ERROR || idx >= (unsigned int)h2devMapped)
+	return ERROR;
+    return OK;
+}
+
+/**
+ ** Add a segment of devices to the table, doubling its size.
+ ** H2SEM_DEV_LOCK must be held.
+ **/
+STATUS
+h2devGrow(void)
+{
+    int c, i, n, start, id = -1;
+    char what[16];
+    size_t len;
+
+    if (h2devAttach(NULL) == ERROR)
+	return ERROR;
+    pthread_mutex_lock(&h2devMutex);
+    if (h2devMapChunks() == ERROR) {
+	pthread_mutex_unlock(&h2devMutex);
+	return ERROR;
+    }
+    c = h2devHdr->nChunks;
+    start = h2devHdr->nDevs;
+    n = start;
+    if (start + n > H2_DEV_MAX_LIMIT)
+	n = H2_DEV_MAX_LIMIT - start;
+    n = H2DEV_CHUNK_ROUND(n);
+    if (c == H2_DEV_MAX_CHUNKS || n <= 0) {
+	pthread_mutex_unlock(&h2devMutex);
+	errnoSet(S_h2devLib_FULL);
+	return ERROR;
+    }
+    len = n * sizeof(H2_DEV_STR);
+    if (h2devHdr->shmFlags & H2DEV_SHM_POSIX) {
+	snprintf(what, sizeof(what), "%d", c);
+	if (h2devShmMap(what, &len, h2devChunkAddr(start),
+		h2devHdr->shmFlags, TRUE) == NULL) {
+	    pthread_mutex_unlock(&h2devMutex);
+	    return ERROR;
+	}
+    } else {
+	id = shmget(IPC_PRIVATE, len, IPC_CREAT | PORTLIB_MODE);
+	if (id == -1) {
+	    pthread_mutex_unlock(&h2devMutex);
+	    errnoSet(S_smObjLib_SHMGET_ERROR);
+	    return ERROR;
+	}
+	if (h2devShmAt(id, h2devChunkAddr(start), len) == ERROR) {
+	    shmctl(id, IPC_RMID, NULL);
+	    pthread_mutex_unlock(&h2devMutex);
+	    return ERROR;
+	}
+    }
+    for (i = start; i < start + n; i++) {
+	h2Devs[i].type = H2_DEV_TYPE_NONE;
+	h2Devs[i].devgen = i | (-1U << (8*sizeof(int) - H2_DEV_GEN_BITS));
+    }
+    h2devHdr->chunk[c].shmid = id;
+    h2devHdr->chunk[c].start = start;
+    h2devHdr->chunk[c].n = n;
+    h2devHdr->nChunks = c + 1;
+    h2devChunksMapped = c + 1;
+    h2devMapped = start + n;
+    /* publish the new devices */
+    __atomic_store_n(&h2devHdr->nDevs, start + n, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&h2devMutex);
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
 /**
  ** Initialization
  **/
@@ -173,34 +653,57 @@ h2devInit(int smMemSize, int h2devMax, int posterServFlag)
     int fd, pipefd[2];
     char buf[16];
     int savedError;
+    size_t len;
 
     h2devRecordH2ErrMsgs();
 
-    if (h2devMax > H2DEV_INDEX(-1U)) {
+    if (h2devMax > H2_DEV_MAX_LIMIT) {
 	errnoSet(S_h2devLib_TOO_MANY_DEVICES);
 	return(ERROR);
     }
+    if (h2devReserve() == ERROR) {
+	return ERROR;
+    }
+    h2devMax = H2DEV_CHUNK_ROUND(h2devMax);
 
     key = h2devGetKey(H2_DEV_TYPE_H2DEV, 0, TRUE, &fd);
     if (key == ERROR) {
 	return ERROR;
     }
-    shmid = shmget(key, sizeof(H2_DEV_STR)*h2devMax,
-		   IPC_CREAT | IPC_EXCL | PORTLIB_MODE);
-    if (shmid == -1) {
-	errnoSet(S_smObjLib_SHMGET_ERROR);
-	close(fd);
-	return(ERROR);
+    h2devShmKey = key;
+    h2devShmClean();
+    len = H2DEV_PREFIX_SIZE + h2devMax * sizeof(H2_DEV_STR);
+    shmid = -1;
+    if ((h2devShmFlags & H2DEV_SHM_POSIX) == 0) {
+	shmid = shmget(key, len, IPC_CREAT | IPC_EXCL | PORTLIB_MODE);
+	if (shmid == -1) {
+	    errnoSet(S_smObjLib_SHMGET_ERROR);
+	    close(fd);
+	    return(ERROR);
+	}
     }
     pthread_mutex_lock(&h2devMutex);
-    h2Devs = shmat(shmid, NULL, 0);
-    if (h2Devs == NULL) {
-	errnoSet(S_smObjLib_SHMAT_ERROR);
+    if (shmid == -1 ?
+	h2devShmMap("0", &len, h2devBase, h2devShmFlags, TRUE) == NULL :
+	h2devShmAt(shmid, h2devBase, len) == ERROR) {
 	pthread_mutex_unlock(&h2devMutex);
 	close(fd);
 	return(ERROR);
     }
-    h2devMaxCur = h2devMax;
+    h2devHdr = (H2DEV_HDR *)h2devBase;
+    h2devHash = (int *)(h2devHdr + 1);
+    h2devTypeHead = h2devHdr->typeHead;
+    h2Devs = (H2_DEV_STR *)h2devChunkAddr(0);
+    h2devHdr->shmFlags = h2devShmFlags;
+    for (i = 0; i < H2DEV_MAX_TYPES; i++)
+	h2devHdr->typeHead[i] = -1;
+    h2devHdr->nChunks = 1;
+    h2devHdr->chunk[0].shmid = shmid;
+    h2devHdr->chunk[0].start = 0;
+    h2devHdr->chunk[0].n = h2devMax;
+    h2devHdr->nDevs = h2devMax;
+    h2devChunksMapped = 1;
+    h2devMapped = h2devMax;
     /* Create semaphores */
     h2Devs[0].type = H2_DEV_TYPE_SEM;
     h2Devs[0].uid = getuid();
@@ -211,8 +714,10 @@ h2devInit(int smMemSize, int h2devMax, int posterServFlag)
 	close(fd);
 	return ERROR;
     }
-    /* Manually allocate the first semaphore */
+    /* Manually allocate the global locks, the device one being taken */
     h2semCreate0(H2DEV_SEM_SEM_ID(0), SEM_EMPTY);
+    h2semSet(H2SEM_SEM_LOCK, SEM_FULL);
+    h2semSet(H2SEM_MEM_LOCK, SEM_FULL);
 
     /* Initialization */
     for (i = 1; i < h2devMax; i++) {
@@ -221,7 +726,9 @@ h2devInit(int smMemSize, int h2devMax, int posterServFlag)
 	h2Devs[i].type = H2_DEV_TYPE_NONE;
 	h2Devs[i].devgen = i | (-1U << (8*sizeof(int) - H2_DEV_GEN_BITS));
     }
-    h2semGive(0);
+    h2devHashAdd(0);
+    h2devTypeAdd(0);
+    h2semGive(H2SEM_DEV_LOCK);
     pthread_mutex_unlock(&h2devMutex);
 
     /* Create shared memory segment */
@@ -288,6 +795,25 @@ h2devInit(int smMemSize, int h2devMax, int posterServFlag)
 
 /*----------------------------------------------------------------------*/
 
+/**
+ ** Path name of a file attached to h2 device dev, next to the key file
+ ** of the h2 devices
+ **/
+STATUS
+h2devGetPath(int dev, const char *suffix, char *path, size_t len)
+{
+    if (h2devGetKey(H2_DEV_TYPE_H2DEV, 0, FALSE, NULL) == ERROR)
+	return ERROR;
+    if (snprintf(path, len, "%s-%08x.%s", h2devFileName, (unsigned int)dev,
+	    suffix) >= (int)len) {
+	errnoSet(S_h2devLib_BAD_HOME_DIR);
+	return ERROR;
+    }
+    return OK;
+}
+
+/*----------------------------------------------------------------------*/
+
 /*
  * Look for the pointer to the shared H2_DEV structure
  */
@@ -298,10 +824,15 @@ h2devAttach(int *h2devMaxPtr)
     int fd, n;
     char buf[16];
     struct shmid_ds shm_ds;
+    size_t len;
+    STATUS status;
 
     if (h2Devs != NULL) {
+	/* pick up the devices added by other processes */
+	if (h2devMapped < __atomic_load_n(&h2devHdr->nDevs, __ATOMIC_ACQUIRE))
+	    h2devExtend(0);
 	if (h2devMaxPtr != NULL)
-	    *h2devMaxPtr = h2devMaxCur;
+	    *h2devMaxPtr = h2devMapped;
         return OK;
     }
 
@@ -314,30 +845,55 @@ h2devAttach(int *h2devMaxPtr)
 	pthread_mutex_unlock(&h2devMutex);
 	return ERROR;
     }
-    shmid = shmget(key, sizeof(H2_DEV_STR), PORTLIB_MODE);
-    if (shmid == -1) {
-	errnoSet(errno);
+    h2devShmKey = key;
+    if (h2devReserve() == ERROR) {
 	pthread_mutex_unlock(&h2devMutex);
 	close(fd);
 	return ERROR;
     }
-    if (shmctl(shmid, IPC_STAT, &shm_ds) < 0) {
+    /* Look for a POSIX object first, then for a SysV segment */
+    shmid = -1;
+    if (h2devShmMap("0", &len, h2devBase, 0, FALSE) == NULL) {
+	if (errnoGet() != ENOENT) {
+	    pthread_mutex_unlock(&h2devMutex);
+	    close(fd);
+	    return ERROR;
+	}
+	shmid = shmget(key, sizeof(H2_DEV_STR), PORTLIB_MODE);
+	if (shmid == -1) {
+	    errnoSet(errno);
+	    pthread_mutex_unlock(&h2devMutex);
+	    close(fd);
+	    return ERROR;
+	}
+	if (shmctl(shmid, IPC_STAT, &shm_ds) < 0) {
 	    errnoSet(errno);
 	    pthread_mutex_unlock(&h2devMutex);
 	    close(fd);
 	    return ERROR;
+	}
+	if (h2devShmAt(shmid, h2devBase, shm_ds.shm_segsz) == ERROR) {
+	    pthread_mutex_unlock(&h2devMutex);
+	    close(fd);
+	    return ERROR;
+	}
     }
-    h2devMaxCur = shm_ds.shm_segsz / sizeof(H2_DEV_STR);
-    if (h2devMaxPtr != NULL)
-	    *h2devMaxPtr = h2devMaxCur;
-
-    h2Devs = shmat(shmid, NULL, 0);
-    if (h2Devs == NULL) {
-	errnoSet(errno);
+    h2devHdr = (H2DEV_HDR *)h2devBase;
+    h2devHash = (int *)(h2devHdr + 1);
+    h2devTypeHead = h2devHdr->typeHead;
+    if (shmid == -1)
+	h2devShmAdvise(h2devBase, len, h2devHdr->shmFlags, FALSE);
+    h2devChunksMapped = 0;
+    h2devMapped = 0;
+    status = h2devMapChunks();
+    h2Devs = (H2_DEV_STR *)h2devChunkAddr(0);
+    if (status == ERROR) {
 	pthread_mutex_unlock(&h2devMutex);
 	close(fd);
 	return ERROR;
     }
+    if (h2devMaxPtr != NULL)
+	    *h2devMaxPtr = h2devMapped;
     /* get the process id of the poster server */
     n = read(fd, buf, sizeof(buf) - 1);
     if (n < 0) {
@@ -358,7 +914,7 @@ h2devAttach(int *h2devMaxPtr)
     pthread_mutex_unlock(&h2devMutex);
 
 #ifdef VALGRIND_SUPPORT
-    VALGRIND_MAKE_READABLE(h2Devs, sizeof(H2_DEV_STR) * *h2devMaxPtr);
+    VALGRIND_MAKE_READABLE(h2Devs, h2devMapped * sizeof(H2_DEV_STR));
 #endif
     return OK;
 }
@@ -382,10 +938,13 @@ h2devSize(void)
 STATUS
 h2devEnd(void)
 {
-    int i, d, rv = OK;
-    int h2devMax;
+    int i, next, c, id, rv = OK;
+    char what[16];
+    static const H2_DEV_TYPE types[] = {
+	H2_DEV_TYPE_MBOX, H2_DEV_TYPE_MBOXGRP, H2_DEV_TYPE_POSTER
+    };
 
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
 	/* Unlink the lock file, just in case */
 	/* XXX Not very clean from security point of vue */
 	rv = ERROR;
@@ -398,27 +957,24 @@ h2devEnd(void)
 	goto fail;
     }
     /* Destroy remaining devices */
-    for (d = 0; d < h2devMax; d++) {
-	i = H2DEV_BY_INDEX(d);
+    for (c = 0; c < sizeof(types)/sizeof(types[0]); c++)
+    for (i = h2devFirst(types[c]); i != ERROR; i = next) {
+	next = h2devNext(i, types[c]);
 	switch (H2DEV_TYPE(i)) {
 	  case H2_DEV_TYPE_MBOX:
 	    mboxDelete(i);
 	    break;
+	  case H2_DEV_TYPE_MBOXGRP:
+	    mboxGroupDelete(i);
+	    break;
 	  case H2_DEV_TYPE_POSTER:
 	    /* Don't call posterLib, to avoid circular lib dependencies */
 	    smMemFree(smObjGlobalToLocal(H2DEV_POSTER_POOL(i)));
 	    h2semDelete(H2DEV_POSTER_SEM_ID(i));
 	    h2devFree(i);
 	    break;
-	  case H2_DEV_TYPE_SEM:
-	    /* Nothing to do, semaphores are cleaned further down */
-	    break;
-	  case H2_DEV_TYPE_TASK:
-	    break;
-	  case H2_DEV_TYPE_NONE:
-	    break;
 	  default:
-	    /* error */
+	    /* semaphores are cleaned further down */
 	    break;
 	} /* switch */
     } /* for */
@@ -436,23 +992,43 @@ h2devEnd(void)
     /* Free the first array of semaphores */
     h2semDelete0();
 
-    /* Free the shared memory segment holding h2 devices */
-    if (shmdt((char *)h2Devs) < 0) {
-	fprintf(stderr, "h2devEnd: shmdt error %s\n", strerror(errno));
-	rv = ERROR;
-	goto fail;
-    }
-    if (shmctl(shmid, IPC_RMID, NULL) < 0) {
-	fprintf(stderr, "h2devEnd: shmctl(IPC_RMID) error %s\n",
-		strerror(errno));
-	rv = ERROR;
-	goto fail;
+    /* Free the shared memory segments holding h2 devices, the first one
+       holding the list last */
+    for (c = h2devHdr->nChunks - 1; c >= 0; c--) {
+	id = h2devHdr->chunk[c].shmid;
+	if (id == -1) {
+	    /* POSIX object, unmapped with the reserved range */
+	    snprintf(what, sizeof(what), "%d", c);
+	    if (h2devShmUnlink(what) == ERROR) {
+		fprintf(stderr, "h2devEnd: shm_unlink error %s\n",
+			strerror(errno));
+		rv = ERROR;
+	    }
+	    continue;
+	}
+	if (shmctl(id, IPC_RMID, NULL) < 0) {
+	    fprintf(stderr, "h2devEnd: shmctl(IPC_RMID) error %s\n",
+		    strerror(errno));
+	    rv = ERROR;
+	}
+	if (shmdt(c == 0 ? h2devBase : h2devChunkAddr(h2devHdr->chunk[c].start))
+	    < 0) {
+	    fprintf(stderr, "h2devEnd: shmdt error %s\n", strerror(errno));
+	    rv = ERROR;
+	}
     }
+    munmap(h2devBase, H2DEV_RESERVE_SIZE);
+    h2devBase = NULL;
+    h2devHdr = NULL;
+    h2devChunksMapped = 0;
+    h2devMapped = 0;
 fail:
     /* remove the .h2devs lock file */
     unlink(h2devFileName);
     /* and mark the global pointer as invalid */
     h2Devs = NULL;
+    h2devHash = NULL;
+    h2devTypeHead = NULL;
     return rv;
 }
 
@@ -472,28 +1048,27 @@ static char *h2devTypeName[] = {
     "POSTER",
     "TASK",
     "MEM",
+    "MBOXGRP",
 };
 
 STATUS
 h2devShow(void)
 {
-    int i, d;
-    int h2devMax;
+    int i, type;
+    H2_DEV_STR snap;
 
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
 	return ERROR;
     }
     printf("      Id  Gen   Type   UID Name\n"
 	   "------------------------------------------------\n");
-    for (d = 0; d < h2devMax; d++) {
-	i = H2DEV_BY_INDEX(d);
-	pthread_mutex_lock(&h2devMutex);
-	if (H2DEV_TYPE(i) != H2_DEV_TYPE_NONE) {
-            printf("%8d %4d %6s %5ld %s\n", H2DEV_INDEX(i), H2DEV_GEN(i),
-		   h2devTypeName[H2DEV_TYPE(i)],  H2DEV_UID(i),
-		   H2DEV_NAME(i));
+    for (type = H2_DEV_TYPE_NONE + 1; type < H2DEV_MAX_TYPES; type++)
+    for (i = h2devFirst(type); i != ERROR; i = h2devNext(i, type)) {
+	if (h2devSnapshot(H2DEV_INDEX(i), &snap) == OK && snap.type == type) {
+            printf("%8d %4d %6s %5ld %s\n", H2DEV_INDEX(i),
+		   H2DEV_GEN(snap.devgen), h2devTypeName[snap.type],
+		   snap.uid, snap.name);
 	}
-	pthread_mutex_unlock(&h2devMutex);
     } /* for */
     printf("------------------------------------------------\n");
     return OK;
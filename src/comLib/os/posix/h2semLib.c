@@ -25,6 +25,12 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 #include "portLib.h"
 #include "wdLib.h"
@@ -77,6 +83,24 @@ h2semRecordH2ErrMsgs(void)
 
 /*----------------------------------------------------------------------*/
 
+/**
+ ** Check if a semaphore array is used by another device than num
+ **/
+static BOOL
+h2semArrayInUse(int num, int semId)
+{
+    int i;
+
+    for (i = h2devFirst(H2_DEV_TYPE_SEM); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_SEM)) {
+	if (H2DEV_INDEX(i) != H2DEV_INDEX(num) && H2DEV_SEM_SEM_ID(i) == semId)
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------*/
+
 /**
  ** Allocation d'un tableau de semaphores
  **/
@@ -99,6 +123,13 @@ h2semInit(int num, int *pSemId)
 	errnoSet(errno);
 	return(ERROR);
     }
+    /* ftok() only keeps 8 bits of the device number, so the key may be
+       the one of another array: don't reset it, use a private one */
+    if (h2semArrayInUse(num, semId) &&
+	(semId = semget(IPC_PRIVATE, MAX_SEM, IPC_CREAT | PORTLIB_MODE)) == -1) {
+	errnoSet(errno);
+	return(ERROR);
+    }
 
     /* (re)Definit son proprietaire 
      * Pour que tous les tableaux appartiennent a celui qui a fait le
@@ -135,12 +166,12 @@ void
 h2semEnd(void)
 {
     union semun semun;
-    int i, d;
+    int i, next;
 
-    /* skip the first semaphore array */
-    for (d = 1; d < h2devSize(); d++) {
-	i = H2DEV_BY_INDEX(d);
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_SEM) {
+    for (i = h2devFirst(H2_DEV_TYPE_SEM); i != ERROR; i = next) {
+	next = h2devNext(i, H2_DEV_TYPE_SEM);
+	/* skip the first semaphore array */
+	if (H2DEV_INDEX(i) != 0) {
 	    /* Libere le tableau de semaphores */
 	    semun.val = 0;
 	    semctl(H2DEV_SEM_SEM_ID(i), 0, IPC_RMID, semun);
@@ -186,7 +217,7 @@ h2semDelete0(void)
 H2SEM_ID
 h2semAlloc(int type)
 {
-    int i, d, j, dev;
+    int i, j, dev;
     union semun semun;    
     unsigned short tabval[MAX_SEM];
 #ifdef VALGRIND_SUPPORT
@@ -201,33 +232,31 @@ h2semAlloc(int type)
     }
     LOGDBG(("h2semAlloc(type %d)\n", type));
     /* Verrouille l'acces aux structures */
-    h2semTake(0, WAIT_FOREVER);
+    h2semTake(H2SEM_SEM_LOCK, WAIT_FOREVER);
 
     /* Recherche d'un semaphore libre dans un tableau */
     j = -1;				/* stupid gcc warning killer */
-    for (d = 0; d < h2devSize(); d++) {
-        i = H2DEV_BY_INDEX(d);
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_SEM) {
-	    /* Allocation d'un semaphore dans le tableau */
-	    semun.array = tabval;
-            LOGDBG(("h2semAlloc: looking in %d semId %d\n",
-                    i, H2DEV_SEM_SEM_ID(i)));
-	    if (semctl(H2DEV_SEM_SEM_ID(i), 0, GETALL, semun) == -1) {
-                LOGDBG(("h2semAlloc:semctl GETALL failed dev %d %d\n",
-                        i, H2DEV_SEM_SEM_ID(i)));
-		errnoSet(errno);
-		h2semGive(0);
-		return ERROR;
-	    }
-	    for (j = 0; j < MAX_SEM; j++) {
-		if (tabval[j] == SEM_UNALLOCATED) {
-		    trouve = TRUE;
-		    break;
-		}
-	    } /* for */
-	    if (trouve) {
+    for (i = h2devFirst(H2_DEV_TYPE_SEM); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_SEM)) {
+	/* Allocation d'un semaphore dans le tableau */
+	semun.array = tabval;
+	LOGDBG(("h2semAlloc: looking in %d semId %d\n",
+		i, H2DEV_SEM_SEM_ID(i)));
+	if (semctl(H2DEV_SEM_SEM_ID(i), 0, GETALL, semun) == -1) {
+	    LOGDBG(("h2semAlloc:semctl GETALL failed dev %d %d\n",
+		    i, H2DEV_SEM_SEM_ID(i)));
+	    errnoSet(errno);
+	    h2semGive(H2SEM_SEM_LOCK);
+	    return ERROR;
+	}
+	for (j = 0; j < MAX_SEM; j++) {
+	    if (tabval[j] == SEM_UNALLOCATED) {
+		trouve = TRUE;
 		break;
 	    }
+	} /* for */
+	if (trouve) {
+	    break;
 	}
     } /* for */
 
@@ -236,22 +265,23 @@ h2semAlloc(int type)
 	semun.val = type == H2SEM_SYNC ? SEM_EMPTY : SEM_FULL;
 	semctl(H2DEV_SEM_SEM_ID(i), j, SETVAL, semun);
         LOGDBG(("h2semAlloc: found %d:%d\n", H2DEV_SEM_SEM_ID(i), j));
-	h2semGive(0);
+	h2semGive(H2SEM_SEM_LOCK);
         /* H2SEM_ID is the h2dev index without generation number, plus the
          * index within the semaphore array */
-	return d*MAX_SEM + j;
+	return H2DEV_INDEX(i)*MAX_SEM + j;
     }
     
     /* plus de semaphores libre, allocation d'un nouveau tableau */
     /* allocation d'un nouveau device */
-    dev = h2devAllocUnlocked("h2semLib", H2_DEV_TYPE_SEM);
+    dev = h2devAlloc("h2semLib", H2_DEV_TYPE_SEM);
     if (dev == ERROR) {
         LOGDBG(("h2semAlloc:h2devAlloc failed\n"));
+	h2semGive(H2SEM_SEM_LOCK);
 	return ERROR;
     }
     /* Allocation d'un nouveau tableau */
     if (h2semInit(dev, &(H2DEV_SEM_SEM_ID(dev))) == ERROR) {
-	h2semGive(0);
+	h2semGive(H2SEM_SEM_LOCK);
         LOGDBG(("h2semAlloc:h2semInit failed\n"));
 	return ERROR;
     }
@@ -259,10 +289,10 @@ h2semAlloc(int type)
     if (h2semCreate0(H2DEV_SEM_SEM_ID(dev), 
 		     type == H2SEM_SYNC ? SEM_EMPTY : SEM_FULL) == ERROR) {
         LOGDBG(("h2semAlloc:h2semCreate0 failed\n"));
-	h2semGive(0);
+	h2semGive(H2SEM_SEM_LOCK);
 	return ERROR;
     }
-    h2semGive(0);
+    h2semGive(H2SEM_SEM_LOCK);
 
     /* return the first H2SEM_ID of the array */
     return H2DEV_INDEX(dev)*MAX_SEM;
@@ -458,22 +488,20 @@ h2semShow(H2SEM_ID sem)
 void
 h2semList(void)
 {
-    int i, d, j, h2devMax;
+    int i, j;
     H2SEM_ID semId;
 
-    h2devAttach(&h2devMax);
-    h2semTake(0, WAIT_FOREVER);
-    for (d = 0; d < h2devMax; d++) {
-        i = H2DEV_BY_INDEX(d);
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_SEM) {
-            for (j = 0; j < MAX_SEM; j++) {
-                semId = d*MAX_SEM + j;
-                printf("%10d:%3d ", H2DEV_SEM_SEM_ID(i), j);
-                h2semShow(semId);
-            }
+    h2devAttach(NULL);
+    h2semTake(H2SEM_SEM_LOCK, WAIT_FOREVER);
+    for (i = h2devFirst(H2_DEV_TYPE_SEM); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_SEM)) {
+        for (j = 0; j < MAX_SEM; j++) {
+            semId = H2DEV_INDEX(i)*MAX_SEM + j;
+            printf("%10d:%3d ", H2DEV_SEM_SEM_ID(i), j);
+            h2semShow(semId);
         }
     }
-    h2semGive(0);
+    h2semGive(H2SEM_SEM_LOCK);
 }
 /*----------------------------------------------------------------------*/
 STATUS
@@ -493,3 +521,165 @@ h2semSet(H2SEM_ID sem, int value)
     return OK;
 }
 
+
+/*----------------------------------------------------------------------*/
+
+/**
+ ** Evenements en memoire partagee (H2WAKE)
+ **
+ ** A waiter consumes the event by recording the last seq it saw: the
+ ** owner in seen, the tasks using h2wakeWait() in their own snapshot.
+ ** Givers bump seq and wake all the waiters only if one declared itself
+ ** waiting. Both sides use sequentially consistent accesses, so either
+ ** the giver sees the waiter, or the waiter sees the new seq.
+ ** h2wakeTake() and h2wakeWait() return TRUE, FALSE on timeout, or
+ ** ERROR if the futex fails.
+ **/
+
+void
+h2wakeInit(H2WAKE *w, H2SEM_ID sem)
+{
+    w->seq = 0;
+    w->seen = 0;
+    w->waiters = 0;
+    w->sem = sem;
+}
+
+#ifdef __linux__
+
+static int
+h2wakeFutex(unsigned int *addr, int op, unsigned int val,
+	    const struct timespec *ts)
+{
+    return syscall(SYS_futex, addr, op, val, ts, NULL, 0);
+}
+
+STATUS
+h2wakeGive(H2WAKE *w)
+{
+    __atomic_add_fetch(&w->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&w->waiters, __ATOMIC_SEQ_CST) != 0 &&
+	h2wakeFutex(&w->seq, FUTEX_WAKE, INT_MAX, NULL) < 0) {
+	errnoSet(errno);
+	return ERROR;
+    }
+    return OK;
+}
+
+unsigned int
+h2wakeSeq(H2WAKE *w)
+{
+    return __atomic_load_n(&w->seq, __ATOMIC_SEQ_CST);
+}
+
+static BOOL
+h2wakeWaitSeq(H2WAKE *w, unsigned int *pSeen, int timeout)
+{
+    struct timespec deadline, ts;
+    unsigned int seq;
+    int r;
+
+    /* Dans comLib timeout = 0 signifie bloquant */
+    if (timeout == 0)
+	timeout = WAIT_FOREVER;
+    if (timeout != WAIT_FOREVER) {
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout / sysClkRateGet();
+	deadline.tv_nsec += (long)(timeout % sysClkRateGet())
+	    * 1000000000L / sysClkRateGet();
+	if (deadline.tv_nsec >= 1000000000L) {
+	    deadline.tv_sec++;
+	    deadline.tv_nsec -= 1000000000L;
+	}
+    }
+
+    while (1) {
+	seq = __atomic_load_n(&w->seq, __ATOMIC_SEQ_CST);
+	if (seq != *pSeen) {
+	    *pSeen = seq;
+	    return TRUE;
+	}
+	if (timeout != WAIT_FOREVER) {
+	    clock_gettime(CLOCK_MONOTONIC, &ts);
+	    ts.tv_sec = deadline.tv_sec - ts.tv_sec;
+	    ts.tv_nsec = deadline.tv_nsec - ts.tv_nsec;
+	    if (ts.tv_nsec < 0) {
+		ts.tv_sec--;
+		ts.tv_nsec += 1000000000L;
+	    }
+	    if (ts.tv_sec < 0) {
+		errnoSet(S_h2semLib_TIMEOUT);
+		return FALSE;
+	    }
+	}
+	__atomic_add_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+	r = h2wakeFutex(&w->seq, FUTEX_WAIT, seq,
+			timeout == WAIT_FOREVER ? NULL : &ts);
+	__atomic_sub_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+	if (r < 0 && errno != EAGAIN && errno != EINTR &&
+	    errno != ETIMEDOUT) {
+	    errnoSet(errno);
+	    return ERROR;
+	}
+    }
+}
+
+BOOL
+h2wakeTake(H2WAKE *w, int timeout)
+{
+    return h2wakeWaitSeq(w, &w->seen, timeout);
+}
+
+BOOL
+h2wakeWait(H2WAKE *w, unsigned int *pSeq, int timeout)
+{
+    return h2wakeWaitSeq(w, pSeq, timeout);
+}
+
+void
+h2wakeFlush(H2WAKE *w)
+{
+    w->seen = __atomic_load_n(&w->seq, __ATOMIC_SEQ_CST);
+}
+
+#else
+
+STATUS
+h2wakeGive(H2WAKE *w)
+{
+    return h2semGive(w->sem);
+}
+
+BOOL
+h2wakeTake(H2WAKE *w, int timeout)
+{
+    return h2semTake(w->sem, timeout);
+}
+
+unsigned int
+h2wakeSeq(H2WAKE *w)
+{
+    return 0;
+}
+
+/* The semaphore wakes one task: it passes the event on to the next one */
+BOOL
+h2wakeWait(H2WAKE *w, unsigned int *pSeq, int timeout)
+{
+    BOOL r;
+
+    __atomic_add_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST);
+    r = h2semTake(w->sem, timeout);
+    if (__atomic_sub_fetch(&w->waiters, 1, __ATOMIC_SEQ_CST) != 0 &&
+	r == TRUE)
+	h2semGive(w->sem);
+    return r;
+}
+
+void
+h2wakeFlush(H2WAKE *w)
+{
+    h2semFlush(w->sem);
+}
+
+#endif /* __linux__ */
@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
 
 #include <portLib.h>
 #include <errnoLib.h>
@@ -50,6 +51,7 @@ smMemInit(int smMemSize)
     key_t key;
     int dev;
     void *addr;
+    size_t len = smMemSize + 2*sizeof(SM_MALLOC_CHUNK);
     SM_MALLOC_CHUNK *header;
     
     /* allocation d'un device h2 */
@@ -57,6 +59,17 @@ smMemInit(int smMemSize)
     if (dev == ERROR) {
         return ERROR;
     }
+    H2DEV_MEM_SIZE(dev) = len;
+    if (h2devGetShmFlags() & H2DEV_SHM_POSIX) {
+	/* Objet POSIX, avec les options des devices h2 */
+	H2DEV_MEM_SHM_ID(dev) = -1;
+	addr = h2devShmMap(SM_MEM_NAME, &len, NULL, h2devGetShmFlags(), TRUE);
+	if (addr == NULL) {
+	    h2devFree(dev);
+	    return ERROR;
+	}
+	goto mapped;
+    }
     /* Clef associee aux SHM */
     key = h2devGetKey(H2_DEV_TYPE_MEM, dev, FALSE, NULL);
     if (key == ERROR) {
@@ -64,8 +77,7 @@ smMemInit(int smMemSize)
     }    
     /* Creation du segment de memoire partage'e */
     do {
-        H2DEV_MEM_SHM_ID(dev) = shmget(key, 
-				       smMemSize + 2*sizeof(SM_MALLOC_CHUNK), 
+        H2DEV_MEM_SHM_ID(dev) = shmget(key, len,
 				       (IPC_CREAT | IPC_EXCL | PORTLIB_MODE));
         if (H2DEV_MEM_SHM_ID(dev) < 0 && errno != EINTR) {
             h2devFree(dev);
@@ -84,6 +96,7 @@ smMemInit(int smMemSize)
 	}
     } while (addr == (void *)-1);
 
+  mapped:
     /* remember base address */
     smMemBaseAddr = addr;
 
@@ -109,6 +122,7 @@ smMemAttach(void)
 {
     int dev;
     void *addr;
+    size_t len;
     
     if (smMemBaseAddr != NULL) {
 	return OK;
@@ -118,6 +132,15 @@ smMemAttach(void)
 	return ERROR;
     }
 
+    if (H2DEV_MEM_SHM_ID(dev) == -1) {
+	addr = h2devShmMap(SM_MEM_NAME, &len, NULL, h2devGetShmFlags(), FALSE);
+	if (addr == NULL) {
+	    return ERROR;
+	}
+	smMemBaseAddr = addr;
+	smMemFreeList = (SM_MALLOC_CHUNK *)addr + 1;
+	return OK;
+    }
     /* Attach du SHM */
     do {
         addr = shmat(H2DEV_MEM_SHM_ID(dev), NULL, 0);
@@ -152,12 +175,17 @@ smMemEnd(void)
     if (dev == ERROR) {
 	return ERROR;
     }
-    /* Detach le shared memory segment */
-    shmdt((char *)smMemBaseAddr);
+    if (H2DEV_MEM_SHM_ID(dev) == -1) {
+	munmap(smMemBaseAddr, H2DEV_MEM_SIZE(dev));
+	h2devShmUnlink(SM_MEM_NAME);
+    } else {
+	/* Detach le shared memory segment */
+	shmdt((char *)smMemBaseAddr);
+	/* Libere le shared memory segment */
+	shmctl(H2DEV_MEM_SHM_ID(dev), IPC_RMID, NULL);
+    }
     smMemBaseAddr = NULL;
     smMemFreeList = NULL;
-    /* Libere le shared memory segment */
-    shmctl(H2DEV_MEM_SHM_ID(dev), IPC_RMID, NULL);
     
     /* Libere le device h2 */
     h2devFree(dev);
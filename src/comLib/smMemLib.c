@@ -252,10 +252,10 @@ smMemMalloc(size_t nBytes)
 	    return NULL;
 	}
     }
-    /* use h2dev global semaphore to protect access to shared data */
-    h2semTake(0, WAIT_FOREVER);
+    /* use the heap global semaphore to protect access to shared data */
+    h2semTake(H2SEM_MEM_LOCK, WAIT_FOREVER);
     result = internal_malloc(nBytes);
-    h2semGive(0);
+    h2semGive(H2SEM_MEM_LOCK);
 
     LOGDBG(("comLib:smMemLib: alloc %u -> 0x%lx\n", 
 	    nBytes, (unsigned long)result));
@@ -338,8 +338,8 @@ smMemFree(void *ptr)
        return ERROR;
     }
 
-    /* use h2dev global semaphore to protect access to shared data */
-    h2semTake(0, WAIT_FOREVER);
+    /* use the heap global semaphore to protect access to shared data */
+    h2semTake(H2SEM_MEM_LOCK, WAIT_FOREVER);
 
     /* insert free chunk in the free list */
     insert_after(&smMemFreeList, oc);
@@ -362,7 +362,7 @@ smMemFree(void *ptr)
 	remove_chunk(&smMemFreeList, c);
     }
 
-    h2semGive(0);
+    h2semGive(H2SEM_MEM_LOCK);
     return OK;
 }
 
@@ -390,8 +390,8 @@ smMemShow(BOOL option)
     }
 
     /* Parcours de la liste des blocs libres */
-    /* use h2dev global semaphore to protect access to shared data */
-    h2semTake(0, WAIT_FOREVER);
+    /* use the heap global semaphore to protect access to shared data */
+    h2semTake(H2SEM_MEM_LOCK, WAIT_FOREVER);
     for (c = smMemFreeList; c != NULL; c = smObjGlobalToLocal(c->next)) {
         if (c->signature != SIGNATURE) {
             logMsg("corrupted free memory linked list\n");
@@ -407,7 +407,7 @@ smMemShow(BOOL option)
 		   (unsigned long)c->length);
 	}
     }
-    h2semGive(0);
+    h2semGive(H2SEM_MEM_LOCK);
 
     if (option) {
 	logMsg("\nSUMMARY:\n");
@@ -47,22 +47,60 @@ void
 usage(void)
 {
     fprintf(stderr, 
-	    "Usage: %s init [-d H2_DEV_MAX (%d)][-p][SM_MEM_SIZE (%u)]\n"
+	    "Usage: %s init [-d H2_DEV_MAX (%d)][-p][-s SHM_OPTIONS]"
+	    "[SM_MEM_SIZE (%u)]\n"
 	    "       %s end\n"
 	    "       %s info\n"
             "       %s version\n"
 	    "       %s posterStats [INTERVAL (10)]\n"
+	    "       %s mboxStats [INTERVAL (10)]\n"
 	    "       %s listModules\n"
 	    "       %s printErrno CODE\n"
-	    "       %s clean PATTERN\n",
+	    "       %s clean PATTERN\n"
+	    "Options: -n NAMESPACE selects the devices of a namespace "
+	    "(default $H2DEV_NAMESPACE)\n",
 	progname, H2_DEV_MAX_DEFAULT, SM_MEM_SIZE,
 	progname, progname, progname, progname,
-	progname, progname, progname);
+	progname, progname, progname, progname);
     exit(1);
 }
 
 /*----------------------------------------------------------------------*/
 
+/*
+ * Options de memoire partagee: liste de posix, huge, populate, mlock
+ */
+static int
+shmFlags(char *arg)
+{
+    static const struct {
+	const char *name;
+	int flag;
+    } opts[] = {
+	{ "posix", H2DEV_SHM_POSIX },
+	{ "huge", H2DEV_SHM_HUGE },
+	{ "populate", H2DEV_SHM_POPULATE },
+	{ "mlock", H2DEV_SHM_MLOCK },
+    };
+    char *opt;
+    int i, flags = 0;
+
+    for (opt = strtok(arg, ","); opt != NULL; opt = strtok(NULL, ",")) {
+	for (i = 0; i < sizeof(opts)/sizeof(opts[0]); i++)
+	    if (strcmp(opt, opts[i].name) == 0)
+		break;
+	if (i == sizeof(opts)/sizeof(opts[0])) {
+	    fprintf(stderr, "%s: unknown shared memory option %s\n",
+		    progname, opt);
+	    usage();
+	}
+	flags |= opts[i].flag;
+    }
+    return flags;
+}
+
+/*----------------------------------------------------------------------*/
+
 int 
 getyesno(int def)
 {
@@ -201,6 +239,19 @@ h2posterStats(int interval)
     return OK;
 }
 
+int
+h2mboxStats(int interval)
+{
+    int done = 0;
+
+    while (!done) {
+	putchar('\n');
+	mboxStats();
+	sleep(interval);
+    }
+    return OK;
+}
+
 /*----------------------------------------------------------------------*/
 
 int
@@ -213,7 +264,7 @@ main(int argc, char *argv[])
 
     progname = argv[0];
     
-    while ((c = getopt(argc, argv, "d:p")) != -1) {
+    while ((c = getopt(argc, argv, "d:n:ps:")) != -1) {
 	    switch (c) {
 	    case 'p':
 		    posterServFlag++;
@@ -223,6 +274,16 @@ main(int argc, char *argv[])
 		    if (h2devMax < 0)
 			    usage();
 		    break;
+	    case 's':
+		    h2devSetShmFlags(shmFlags(optarg));
+		    break;
+	    case 'n':
+		    if (h2devSetNamespace(optarg) == ERROR) {
+			    fprintf(stderr, "%s: invalid namespace %s\n",
+				progname, optarg);
+			    usage();
+		    }
+		    break;
 	    default: 
 		    usage();
 	    }
@@ -254,6 +315,9 @@ main(int argc, char *argv[])
 	} else if (strcmp(argv[0], "posterStats") == 0) {
 	    h2posterStats(10);
 	    status = OK;
+	} else if (strcmp(argv[0], "mboxStats") == 0) {
+	    h2mboxStats(10);
+	    status = OK;
 	} else if (strcmp(argv[0], "h2semList") == 0) {
             h2semList();
             status = OK;
@@ -271,6 +335,8 @@ main(int argc, char *argv[])
 	    status = cleanDevs(argv[1]);
 	} else if (strcmp(argv[0], "posterStats") == 0) {
 	    status = h2posterStats(atoi(argv[1]));
+	} else if (strcmp(argv[0], "mboxStats") == 0) {
+	    status = h2mboxStats(atoi(argv[1]));
 	} else {
 	    usage();
 	}
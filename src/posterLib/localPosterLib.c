@@ -522,29 +522,27 @@ localPosterIoctl(POSTER_ID posterId, int code, void *parg)
 static STATUS
 localPosterShow(void)
 {
-    int i, d, h2devMax;
+    int i;
     H2TIMESPEC *date;
     H2TIME h2time;
 
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
 	return ERROR;
     }
     logMsg("\n");
     logMsg("NAME                              Id/host      Size T(last write)\n");
     logMsg("-------------------------------- -------- --------- -------------\n");
-    for (d = 0; d < h2devMax; d++) {
-	i = H2DEV_BY_INDEX(d);
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_POSTER) {
-	    logMsg("%-32s %8d %8d", H2DEV_NAME(i), i,
-		   H2DEV_POSTER_SIZE(i));
-	    if (H2DEV_POSTER_FLG_FRESH(i)) {
-		date = H2DEV_POSTER_DATE(i);
-		h2timeFromTimespec(&h2time, date);
-		logMsg(" %02dh:%02dmin%02ds %lu\n", h2time.hour, h2time.minute,
-		    h2time.sec, h2time.ntick);
-	    } else {
-		logMsg(" EMPTY_POSTER!\n");
-	    }
+    for (i = h2devFirst(H2_DEV_TYPE_POSTER); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_POSTER)) {
+	logMsg("%-32s %8d %8d", H2DEV_NAME(i), i,
+	       H2DEV_POSTER_SIZE(i));
+	if (H2DEV_POSTER_FLG_FRESH(i)) {
+	    date = H2DEV_POSTER_DATE(i);
+	    h2timeFromTimespec(&h2time, date);
+	    logMsg(" %02dh:%02dmin%02ds %lu\n", h2time.hour, h2time.minute,
+		h2time.sec, h2time.ntick);
+	} else {
+	    logMsg(" EMPTY_POSTER!\n");
 	}
     } /* for */
     logMsg("\n");
@@ -555,27 +553,25 @@ localPosterShow(void)
 static STATUS
 localPosterStats(void)
 {
-    int i, d, h2devMax;
+    int i;
 
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
 	return ERROR;
     }
     logMsg("\n");
     logMsg("NAME                                ReadOps   WriteOps  ReadBytes WriteBytes\n");
     logMsg("-------------------------------- ---------- ---------- ---------- ----------\n");
-    for (d = 0; d < h2devMax; d++) {
-	i = H2DEV_BY_INDEX(d);
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_POSTER) {
-	    logMsg("%-32s %10d %10d %10d %10d\n", H2DEV_NAME(i),
-		   H2DEV_POSTER_READ_OPS(i),
-		   H2DEV_POSTER_WRITE_OPS(i),
-		   H2DEV_POSTER_READ_BYTES(i),
-		   H2DEV_POSTER_WRITE_BYTES(i));
-	    H2DEV_POSTER_READ_OPS(i) = 0;
-	    H2DEV_POSTER_WRITE_OPS(i) = 0;
-	    H2DEV_POSTER_READ_BYTES(i) = 0;
-	    H2DEV_POSTER_WRITE_BYTES(i) = 0;
-	}
+    for (i = h2devFirst(H2_DEV_TYPE_POSTER); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_POSTER)) {
+	logMsg("%-32s %10d %10d %10d %10d\n", H2DEV_NAME(i),
+	       H2DEV_POSTER_READ_OPS(i),
+	       H2DEV_POSTER_WRITE_OPS(i),
+	       H2DEV_POSTER_READ_BYTES(i),
+	       H2DEV_POSTER_WRITE_BYTES(i));
+	H2DEV_POSTER_READ_OPS(i) = 0;
+	H2DEV_POSTER_WRITE_OPS(i) = 0;
+	H2DEV_POSTER_READ_BYTES(i) = 0;
+	H2DEV_POSTER_WRITE_BYTES(i) = 0;
     } /* for */
     logMsg("\n");
     return OK;
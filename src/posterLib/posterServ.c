@@ -315,24 +315,23 @@ bool_t
 SVC(poster_list_1)(void *unused, POSTER_LIST_RESULT *res, struct svc_req *clnt)
 {
     POSTER_LIST *list = NULL, *l;
-    int i, h2devMax;
+    int i;
 
-    if (h2devAttach(&h2devMax) == ERROR) {
+    if (h2devAttach(NULL) == ERROR) {
 	    res = NULL;
 	    return 1;
     }
-    for (i = 0; i < h2devMax; i++) {
-	if (H2DEV_TYPE(i) == H2_DEV_TYPE_POSTER) {
-	    l = malloc(sizeof(struct POSTER_LIST));
-	    l->next = list;
-	    snprintf(l->name, H2_DEV_MAX_NAME, "%s", H2DEV_NAME(i));
-	    l->id = i;
-	    l->size = H2DEV_POSTER_SIZE(i);
-	    l->fresh = H2DEV_POSTER_FLG_FRESH(i);
-	    l->tv_sec = H2DEV_POSTER_DATE(i)->tv_sec;
-	    l->tv_nsec = H2DEV_POSTER_DATE(i)->tv_nsec;
-	    list = l;
-	}
+    for (i = h2devFirst(H2_DEV_TYPE_POSTER); i != ERROR;
+	 i = h2devNext(i, H2_DEV_TYPE_POSTER)) {
+	l = malloc(sizeof(struct POSTER_LIST));
+	l->next = list;
+	snprintf(l->name, H2_DEV_MAX_NAME, "%s", H2DEV_NAME(i));
+	l->id = i;
+	l->size = H2DEV_POSTER_SIZE(i);
+	l->fresh = H2DEV_POSTER_FLG_FRESH(i);
+	l->tv_sec = H2DEV_POSTER_DATE(i)->tv_sec;
+	l->tv_nsec = H2DEV_POSTER_DATE(i)->tv_nsec;
+	list = l;
     } /* for */
     res->list = list;
     return 1;
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "h2devLib.h"
+
+/* name index: devices are found after others were freed, and the same
+ * name may be used by devices of different types */
+
+#define NDEV 60
+#define NROUND 20
+
+int
+pocoregress_init()
+{
+  int i, r, devs[NDEV];
+  char name[H2_DEV_MAX_NAME], buf[H2_DEV_MAX_NAME];
+
+  for (i = 0; i < NDEV; i++) {
+    snprintf(name, sizeof(name), "th2devFind%d", i);
+    if ((devs[i] = h2devAlloc(name, H2_DEV_TYPE_MBOX)) == ERROR) {
+      logMsg("Error: could not allocate device %d\n", i);
+      return 2;
+    }
+  }
+  if (h2devAlloc("th2devFind0", H2_DEV_TYPE_MBOX) != ERROR ||
+      errnoGet() != S_h2devLib_DUPLICATE_DEVICE_NAME) {
+    logMsg("Error: duplicate device name accepted\n");
+    return 2;
+  }
+
+  /* free and reallocate half of the devices, under other names */
+  for (r = 0; r < NROUND; r++) {
+    for (i = r & 1; i < NDEV; i += 2) {
+      h2devFree(devs[i]);
+      snprintf(name, sizeof(name), "th2devFind%d.%d", i, r);
+      if ((devs[i] = h2devAlloc(name, H2_DEV_TYPE_POSTER)) == ERROR) {
+	logMsg("Error: could not reallocate device %d\n", i);
+	return 2;
+      }
+    }
+    for (i = 0; i < NDEV; i++) {
+      if (((i - r) & 1) == 0)
+	snprintf(name, sizeof(name), "th2devFind%d.%d", i, r);
+      else if (r == 0)
+	snprintf(name, sizeof(name), "th2devFind%d", i);
+      else
+	snprintf(name, sizeof(name), "th2devFind%d.%d", i, r - 1);
+      if (h2devFind(name, H2DEV_TYPE(devs[i])) != devs[i]) {
+	logMsg("Error: device %s not found\n", name);
+	return 2;
+      }
+    }
+  }
+  if (h2devFind("th2devFind1", H2_DEV_TYPE_MBOX) != ERROR ||
+      errnoGet() != S_h2devLib_NOT_FOUND) {
+    logMsg("Error: freed device found\n");
+    return 2;
+  }
+
+  /* same name, other type */
+  if ((r = h2devAlloc(name, H2_DEV_TYPE_MBOX)) == ERROR ||
+      h2devFind(name, H2_DEV_TYPE_MBOX) != r ||
+      h2devFind(name, H2_DEV_TYPE_POSTER) != devs[NDEV - 1]) {
+    logMsg("Error: devices of different types with the same name\n");
+    return 2;
+  }
+  h2devFree(r);
+
+  /* names are read through the device id, checking its generation */
+  if (h2devGetName(devs[NDEV - 1], buf, sizeof(buf)) != OK ||
+      strcmp(buf, name) != 0 ||
+      h2devGetName(r, buf, sizeof(buf)) != ERROR ||
+      errnoGet() != S_h2devLib_NOT_FOUND) {
+    logMsg("Error: h2devGetName\n");
+    return 2;
+  }
+
+  /* a writer that died in the middle of an update does not block lookups */
+  h2Devs[H2DEV_INDEX(devs[0])].seq++;
+  r = h2devGetName(devs[0], buf, sizeof(buf));
+  h2Devs[H2DEV_INDEX(devs[0])].seq++;
+  if (r != OK) {
+    logMsg("Error: lookup past a device being updated\n");
+    return 2;
+  }
+  for (i = 0; i < NDEV; i++)
+    h2devFree(devs[i]);
+  return 0;
+}
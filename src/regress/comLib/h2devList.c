@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "taskLib.h"
+#include "h2devLib.h"
+#include "mboxLib.h"
+
+/* devices are listed by type and by owner task */
+
+#define NDEV 20
+
+/* number of devices of a type with the prefix tList */
+static int
+count(H2_DEV_TYPE type)
+{
+	int i, n = 0;
+
+	for (i = h2devFirst(type); i != ERROR; i = h2devNext(i, type)) {
+		if (H2DEV_TYPE(i) != type)
+			return -1;
+		if (strncmp(H2DEV_NAME(i), "tList", 5) == 0)
+			n++;
+	}
+	return n;
+}
+
+int
+pocoregress_init(void)
+{
+	int i, k, n, task, reuse, devs[NDEV];
+	MBOX_ID mbox[3];
+	char name[32];
+
+	logMsg("h2devList test started\n");
+
+	for (i = 0; i < NDEV; i++) {
+		snprintf(name, sizeof(name), "tList%d", i);
+		devs[i] = h2devAlloc(name,
+		    i % 2 ? H2_DEV_TYPE_POSTER : H2_DEV_TYPE_MBOXGRP);
+		if (devs[i] == ERROR) {
+			logMsg("cannot allocate device %d: %x\n", i,
+			    errnoGet());
+			return 2;
+		}
+	}
+	if (count(H2_DEV_TYPE_POSTER) != NDEV/2 ||
+	    count(H2_DEV_TYPE_MBOXGRP) != NDEV/2) {
+		logMsg("bad type lists\n");
+		return 2;
+	}
+	/* a scan standing on a device freed and allocated again with
+	 * another type goes on in its own list */
+	i = h2devNext(h2devFirst(H2_DEV_TYPE_POSTER), H2_DEV_TYPE_POSTER);
+	for (k = 0; k < NDEV && devs[k] != i; k++)
+		;
+	h2devFree(i);
+	reuse = h2devAlloc("tListReuse", H2_DEV_TYPE_MBOXGRP);
+	if (k == NDEV || reuse == ERROR ||
+	    H2DEV_INDEX(reuse) != H2DEV_INDEX(i)) {
+		logMsg("device %d not allocated again\n", i);
+		return 2;
+	}
+	for (n = 0; (i = h2devNext(i, H2_DEV_TYPE_POSTER)) != ERROR; n++)
+		if (H2DEV_TYPE(i) != H2_DEV_TYPE_POSTER) {
+			logMsg("device %d of another type listed\n", i);
+			return 2;
+		}
+	if (n != NDEV/2 - 1) {
+		logMsg("scan of a device allocated again: %d devices\n", n);
+		return 2;
+	}
+	h2devFree(reuse);
+	snprintf(name, sizeof(name), "tList%d", k);
+	if ((devs[k] = h2devAlloc(name, H2_DEV_TYPE_POSTER)) == ERROR) {
+		logMsg("cannot allocate device %d: %x\n", k, errnoGet());
+		return 2;
+	}
+	/* free the head, the tail and devices in the middle */
+	for (i = 0; i < NDEV; i += 3)
+		h2devFree(devs[i]);
+	for (i = NDEV - 1; i >= NDEV - 2; i--)
+		h2devFree(devs[i]);
+	if (count(H2_DEV_TYPE_POSTER) != 6 ||
+	    count(H2_DEV_TYPE_MBOXGRP) != 6) {
+		logMsg("bad type lists after free: %d %d\n",
+		    count(H2_DEV_TYPE_POSTER), count(H2_DEV_TYPE_MBOXGRP));
+		return 2;
+	}
+	for (i = 0; i < NDEV - 2; i++)
+		if (i % 3 != 0)
+			h2devFree(devs[i]);
+	if (count(H2_DEV_TYPE_POSTER) != 0 ||
+	    count(H2_DEV_TYPE_MBOXGRP) != 0) {
+		logMsg("devices left in type lists\n");
+		return 2;
+	}
+
+	/* mailboxes are listed under their task */
+	if (mboxInit("tListTask") == ERROR) {
+		logMsg("mboxInit: %x\n", errnoGet());
+		return 2;
+	}
+	task = taskGetUserData(0);
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "tListMbox%d", i);
+		if (mboxCreate(name, 64, &mbox[i]) == ERROR) {
+			logMsg("mboxCreate: %x\n", errnoGet());
+			return 2;
+		}
+	}
+	mboxDelete(mbox[1]);
+	n = 0;
+	for (i = h2devOwnerFirst(task); i != ERROR;
+	     i = h2devOwnerNext(i, task)) {
+		if (i != mbox[0] && i != mbox[2]) {
+			logMsg("bad device %d owned by the task\n", i);
+			return 2;
+		}
+		n++;
+	}
+	if (n != 2 || count(H2_DEV_TYPE_MBOX) != 2) {
+		logMsg("bad owner list: %d devices\n", n);
+		return 2;
+	}
+	if (mboxEnd(0) == ERROR || count(H2_DEV_TYPE_MBOX) != 0 ||
+	    count(H2_DEV_TYPE_TASK) != 0) {
+		logMsg("mailboxes left after mboxEnd\n");
+		return 2;
+	}
+	logMsg("OK\n");
+	return 0;
+}
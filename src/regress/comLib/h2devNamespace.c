@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "h2devLib.h"
+
+/* each namespace has its own table of devices */
+
+int
+pocoregress_init(void)
+{
+	char ns[H2DEV_MAX_NAMESPACE];
+
+	logMsg("h2devNamespace test started\n");
+
+	/* set by posix.c for each test */
+	snprintf(ns, sizeof(ns), "%s", h2devGetNamespace());
+	if (ns[0] == '\0') {
+		logMsg("no namespace\n");
+		return 2;
+	}
+	if (h2devSetNamespace("bad-name") != ERROR ||
+	    h2devSetNamespace("tNsOther") != ERROR ||
+	    h2devSetNamespace(ns) == ERROR) {
+		logMsg("namespace changed while attached\n");
+		return 2;
+	}
+	if (h2devAlloc("tNs", H2_DEV_TYPE_MBOX) == ERROR) {
+		logMsg("cannot allocate device: %x\n", errnoGet());
+		return 2;
+	}
+
+	/* a new namespace starts with an empty table */
+	h2devEnd();
+	if (h2devSetNamespace("tNsOther") == ERROR ||
+	    h2devInit(64*1024, 16, FALSE) == ERROR) {
+		logMsg("cannot create devices in tNsOther: %x\n", errnoGet());
+		return 2;
+	}
+	if (strcmp(h2devGetNamespace(), "tNsOther") != 0 ||
+	    h2devFind("tNs", H2_DEV_TYPE_MBOX) != ERROR) {
+		logMsg("device found in tNsOther\n");
+		return 2;
+	}
+	h2devEnd();
+
+	/* back to the namespace of the test */
+	if (h2devSetNamespace(NULL) == ERROR ||
+	    strcmp(h2devGetNamespace(), ns) != 0 ||
+	    h2devInit(1024*1024, H2_DEV_MAX_DEFAULT, FALSE) == ERROR) {
+		logMsg("cannot create devices in %s: %x\n", ns, errnoGet());
+		return 2;
+	}
+	logMsg("OK\n");
+	return 0;
+}
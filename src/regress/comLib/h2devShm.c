@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "h2devLib.h"
+#include "smMemLib.h"
+
+extern void *smMemBaseAddr;
+
+/* h2 devices and shared memory heap in POSIX shared memory objects */
+
+#define NDEV 100
+
+int
+pocoregress_init(void)
+{
+	int i, n, status;
+	char name[32], *p, *q;
+	size_t len;
+	pid_t pid;
+
+	logMsg("h2devShm test started\n");
+
+	h2devEnd();
+	if (h2devSetShmFlags(H2DEV_SHM_POPULATE) == ERROR ||
+	    h2devInit(64*1024, 16, FALSE) == ERROR) {
+		logMsg("cannot create POSIX h2 devices: %x\n", errnoGet());
+		return 2;
+	}
+	if (h2devGetShmFlags() != (H2DEV_SHM_POSIX|H2DEV_SHM_POPULATE)) {
+		logMsg("bad backend options %x\n", h2devGetShmFlags());
+		return 2;
+	}
+
+	/* the heap is shared with another mapping of its object */
+	p = smMemMalloc(64);
+	q = h2devShmMap(SM_MEM_NAME, &len, NULL, 0, FALSE);
+	if (p == NULL || q == NULL || len < 64*1024) {
+		logMsg("cannot map the heap: %x\n", errnoGet());
+		return 2;
+	}
+	strcpy(p, "h2devShm");
+	if (strcmp(q + (p - (char *)smMemBaseAddr), "h2devShm") != 0) {
+		logMsg("heap mappings differ\n");
+		return 2;
+	}
+	smMemFree(p);
+
+	/* a child process grows the table with new objects */
+	pid = fork();
+	if (pid == 0) {
+		for (i = 0; i < NDEV; i++) {
+			snprintf(name, sizeof(name), "th2devShm%d", i);
+			if (h2devAlloc(name, H2_DEV_TYPE_MBOX) == ERROR)
+				_exit(1);
+		}
+		_exit(0);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		logMsg("child could not allocate devices\n");
+		return 2;
+	}
+	snprintf(name, sizeof(name), "th2devShm%d", NDEV - 1);
+	n = h2devFind(name, H2_DEV_TYPE_MBOX);
+	if (n == ERROR || strcmp(H2DEV_NAME(n), name) != 0 ||
+	    h2devSize() < NDEV) {
+		logMsg("device of the child process not found\n");
+		return 2;
+	}
+
+	/* all objects are removed with the devices */
+	if (h2devEnd() == ERROR) {
+		logMsg("h2devEnd failed: %x\n", errnoGet());
+		return 2;
+	}
+	if (h2devShmMap("0", &len, NULL, 0, FALSE) != NULL ||
+	    errnoGet() != ENOENT ||
+	    h2devShmMap("1", &len, NULL, 0, FALSE) != NULL) {
+		logMsg("POSIX objects left after h2devEnd\n");
+		return 2;
+	}
+
+	/* back to SysV IPC for the end of the test */
+	h2devSetShmFlags(0);
+	if (h2devInit(1024*1024, H2_DEV_MAX_DEFAULT, FALSE) == ERROR) {
+		logMsg("cannot create h2 devices: %x\n", errnoGet());
+		return 2;
+	}
+	logMsg("OK %d devices\n", h2devSize());
+	return 0;
+}
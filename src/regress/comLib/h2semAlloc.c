@@ -17,6 +17,11 @@ pocoregress_init(void)
 		if (pocoregress_tab[i] == ERROR) {
 			return 2;
 		}
+		/* the global locks are never handed out */
+		if (pocoregress_tab[i] < H2SEM_NLOCKS) {
+			printf("allocated global lock %d\n", pocoregress_tab[i]);
+			return 2;
+		}
 	}
 	printf("allocated %d semaphores\n", POCOREGRESS_NSEMS);
 	for (i = 0; i < POCOREGRESS_NSEMS; i++) {
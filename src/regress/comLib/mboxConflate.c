@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "mboxLib.h"
+
+/* conflating mailbox: a stalled reader only finds the latest message of
+ * each sender, and sends never fail */
+
+#define NSENDER 3
+#define NUPDATE 1000
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  H2RNG_VIEW view;
+  int i, n, msg[2], big[4];
+
+  if (mboxInit("conflate") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreateFlags("conflate", 256,
+		      MBOX_FLAG_CONFLATE | MBOX_FLAG_SPSC, &id) != ERROR ||
+      errnoGet() != S_mboxLib_BAD_FLAGS) {
+    logMsg("Error: lock-free conflating mbox accepted\n");
+    return 2;
+  }
+  if (mboxCreateFlags("conflate", 256, MBOX_FLAG_CONFLATE, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  /* many more updates than the mailbox can hold */
+  for (i = 0; i < NUPDATE; i++) {
+    msg[0] = i % NSENDER;
+    msg[1] = i;
+    if (mboxSend(id, 100 + msg[0], (char *)msg, sizeof(msg)) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+  }
+  if (mboxIoctl(id, FIO_NMSGS, &n) != OK || n != NSENDER) {
+    logMsg("Error: expected %d messages, got %d\n", NSENDER, n);
+    return 2;
+  }
+  /* first sent first, with the latest value */
+  for (i = 0; i < NSENDER; i++) {
+    n = mboxRcv(id, &from, (char *)msg, sizeof(msg), 1);
+    if (n != sizeof(msg) || from != 100 + i || msg[0] != i ||
+	msg[1] != NUPDATE - 1 - (NUPDATE - 1 - i) % NSENDER) {
+      logMsg("Error: bad or stale message %d\n", i);
+      return 2;
+    }
+  }
+
+  /* a message of another size is queued */
+  if (mboxSend(id, 100, (char *)msg, sizeof(msg)) != OK ||
+      mboxSend(id, 100, (char *)big, sizeof(big)) != OK ||
+      mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 2) {
+    logMsg("Error: message of another size should be queued\n");
+    return 2;
+  }
+  if (mboxIoctl(id, FIO_FLUSH, NULL) != OK) {
+    logMsg("Error: flush\n");
+    return 2;
+  }
+
+  /* a message being looked at is not overwritten */
+  msg[1] = 1;
+  mboxSend(id, 100, (char *)msg, sizeof(msg));
+  if (mboxRcvPeek(id, &from, &view, 1) != sizeof(msg)) {
+    logMsg("Error: mboxRcvPeek\n");
+    return 2;
+  }
+  msg[1] = 2;
+  if (mboxSend(id, 100, (char *)msg, sizeof(msg)) != OK ||
+      ((int *)view.ptr[0])[1] != 1 ||
+      mboxRcvRelease(id, &view) != OK) {
+    logMsg("Error: peeked message overwritten\n");
+    return 2;
+  }
+  if (mboxRcv(id, &from, (char *)msg, sizeof(msg), 1) != sizeof(msg) ||
+      msg[1] != 2) {
+    logMsg("Error: update sent during peek lost\n");
+    return 2;
+  }
+
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "semLib.h"
+#include "taskLib.h"
+#include "h2devLib.h"
+#include "mboxLib.h"
+
+/* mailbox descriptor: readable while messages are waiting, whether they
+ * come from this process or from another one */
+
+#define NROUND 2000
+
+static MBOX_ID rcvId;
+static SEM_ID done;
+static int sendError;
+
+/* sends each message as soon as the previous one is received, that is
+ * while the reader may be draining the fifo */
+void *
+pocoregress_sender(void *arg)
+{
+  int i, n;
+
+  for (i = 0; i < NROUND; i++) {
+    while (mboxIoctl(rcvId, FIO_NMSGS, &n) == OK && n != 0)
+      sched_yield();
+    if (mboxSend(rcvId, rcvId, (char *)&i, sizeof(i)) != OK) {
+      logMsg("Error: could not send message %d\n", i);
+      sendError = 1;
+      break;
+    }
+  }
+  semGive(done);
+  return NULL;
+}
+
+static int
+readable(int fd, int ms)
+{
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  int n;
+
+  /* the clock of portLib interrupts system calls */
+  while ((n = poll(&pfd, 1, ms)) < 0 && errno == EINTR)
+    ;
+  return n == 1 && (pfd.revents & POLLIN);
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  pid_t pid;
+  int fd, wfd, i, msg, status;
+  char path[MAXPATHLEN];
+
+  if (mboxInit("fd") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreate("fd", 256, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+  /* a message sent before the descriptor is asked for */
+  msg = 1;
+  mboxSend(id, id, (char *)&msg, sizeof(msg));
+  if ((fd = mboxGetFd(id)) == ERROR || mboxGetFd(id) != fd) {
+    logMsg("Error: mboxGetFd\n");
+    return 2;
+  }
+  if (!readable(fd, 0)) {
+    logMsg("Error: pending message not signalled\n");
+    return 2;
+  }
+  if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0) != sizeof(msg)
+      || readable(fd, 0)) {
+    logMsg("Error: descriptor still readable on an empty mailbox\n");
+    return 2;
+  }
+
+  /* several messages: readable until the last one is received */
+  for (i = 0; i < 3; i++)
+    mboxSend(id, id, (char *)&i, sizeof(i));
+  for (i = 0; i < 3; i++) {
+    if (!readable(fd, 0)) {
+      logMsg("Error: descriptor not readable with %d messages\n", 3 - i);
+      return 2;
+    }
+    mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0);
+  }
+  if (readable(fd, 0)) {
+    logMsg("Error: descriptor readable after the last message\n");
+    return 2;
+  }
+
+  /* sender in another process */
+  if ((pid = fork()) == 0) {
+    usleep(100000);
+    msg = 42;
+    _exit(mboxSend(id, id, (char *)&msg, sizeof(msg)) == OK ? 0 : 1);
+  }
+  if (pid < 0) {
+    logMsg("Error: fork\n");
+    return 2;
+  }
+  if (!readable(fd, 5000)) {
+    logMsg("Error: message of another process not signalled\n");
+    return 2;
+  }
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+      || WEXITSTATUS(status) != 0) {
+    logMsg("Error: sender process failed\n");
+    return 2;
+  }
+  if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0) != sizeof(msg)
+      || msg != 42 || readable(fd, 0)) {
+    logMsg("Error: message of another process not received\n");
+    return 2;
+  }
+
+  /* a byte written by a late sender after the last drain is removed by
+     the next receive finding the mailbox empty */
+  if (h2devGetPath(id, "fifo", path, sizeof(path)) == ERROR
+      || (wfd = open(path, O_WRONLY | O_NONBLOCK)) < 0
+      || write(wfd, "", 1) != 1) {
+    logMsg("Error: cannot write the fifo\n");
+    return 2;
+  }
+  close(wfd);
+  if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 1) != FALSE
+      || readable(fd, 0)) {
+    logMsg("Error: descriptor readable on an empty mailbox\n");
+    return 2;
+  }
+
+  /* a sender in another task, racing with the drain of the reader */
+  rcvId = id;
+  done = semCCreate(0, 0);
+  taskSpawn2("sender", 200, VX_FP_TASK, 20000, pocoregress_sender, NULL);
+  for (i = 0; i < NROUND && !sendError; i++) {
+    if (!readable(fd, 5000)) {
+      logMsg("Error: message %d not signalled\n", i);
+      return 2;
+    }
+    if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0) != sizeof(msg)
+	|| msg != i) {
+      logMsg("Error: message %d not received\n", i);
+      return 2;
+    }
+  }
+  semTake(done, WAIT_FOREVER);
+  if (sendError)
+    return 2;
+
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
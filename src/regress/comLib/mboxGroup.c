@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "h2rngLib.h"
+#include "mboxLib.h"
+
+/* mailbox group: messages are kept until every subscriber read them,
+ * and wrap around the ring */
+
+#define NMSG 1000
+
+int
+pocoregress_init()
+{
+  MBOX_ID grp, from, ready[2];
+  int i, n, msg[3], small;
+
+  if (mboxInit("group") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxGroupCreate("group", 100, &grp) != OK) {
+    logMsg("Error: could not create group\n");
+    return 2;
+  }
+  if (mboxGroupFind("group", &from) != OK || from != grp) {
+    logMsg("Error: could not find group\n");
+    return 2;
+  }
+
+  /* without subscriber, messages are dropped */
+  if (mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != OK) {
+    logMsg("Error: mboxGroupSend without subscriber\n");
+    return 2;
+  }
+  if (mboxGroupRcv(grp, &from, (char *)msg, sizeof(msg), 1) != ERROR ||
+      errnoGet() != S_mboxLib_NOT_SUBSCRIBED) {
+    logMsg("Error: mboxGroupRcv without subscription\n");
+    return 2;
+  }
+  if (mboxGroupJoin(grp) != OK ||
+      mboxGroupRcv(grp, &from, (char *)msg, sizeof(msg), 1) != FALSE) {
+    logMsg("Error: message sent before subscription received\n");
+    return 2;
+  }
+
+  /* the ring (128 bytes) holds 6 messages of 20 bytes */
+  for (i = 0; i < 6; i++) {
+    msg[0] = i;
+    if (mboxGroupSend(grp, 100 + i, (char *)msg, sizeof(msg)) != OK) {
+      logMsg("Error: mboxGroupSend %d\n", i);
+      return 2;
+    }
+  }
+  if (mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != ERROR ||
+      errnoGet() != S_mboxLib_MBOX_FULL) {
+    logMsg("Error: group should be full\n");
+    return 2;
+  }
+  for (i = 0; i < 6; i++) {
+    n = mboxGroupRcv(grp, &from, (char *)msg, sizeof(msg), 1);
+    if (n != sizeof(msg) || from != 100 + i || msg[0] != i) {
+      logMsg("Error: bad message %d\n", i);
+      return 2;
+    }
+  }
+
+  /* many messages, wrapping around */
+  for (i = 0; i < NMSG; i++) {
+    msg[0] = i;
+    msg[2] = -i;
+    if (mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != OK ||
+	mboxGroupRcv(grp, &from, (char *)msg, sizeof(msg), 1) != sizeof(msg)
+	|| msg[0] != i || msg[2] != -i) {
+      logMsg("Error: bad message %d after wrap around\n", i);
+      return 2;
+    }
+  }
+
+  /* the group is in the ready set of its subscribers */
+  if (mboxPauseAll(ready, 2, 1) != FALSE ||
+      mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != OK ||
+      mboxPauseAll(ready, 2, 1) != 1 || ready[0] != grp ||
+      mboxPause(ALL_MBOX, 1) != TRUE ||
+      mboxGroupRcv(grp, &from, (char *)msg, sizeof(msg), 1) != sizeof(msg) ||
+      mboxPauseAll(ready, 2, 1) != FALSE) {
+    logMsg("Error: group message not seen by mboxPauseAll\n");
+    return 2;
+  }
+
+  /* a too small buffer skips the message */
+  if (mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != OK ||
+      mboxGroupRcv(grp, &from, (char *)&small, sizeof(small), 1) != ERROR ||
+      errnoGet() != S_h2rngLib_SMALL_BUF ||
+      mboxGroupRcv(grp, &from, (char *)msg, sizeof(msg), 1) != FALSE) {
+    logMsg("Error: message too big for the buffer not skipped\n");
+    return 2;
+  }
+
+  /* leaving gives the room back */
+  for (i = 0; i < 6; i++)
+    mboxGroupSend(grp, 100, (char *)msg, sizeof(msg));
+  if (mboxGroupLeave(grp) != OK ||
+      mboxGroupLeave(grp) != ERROR ||
+      errnoGet() != S_mboxLib_NOT_SUBSCRIBED ||
+      mboxGroupJoin(grp) != OK ||
+      mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != OK) {
+    logMsg("Error: leaving the group did not free the room\n");
+    return 2;
+  }
+
+  if (mboxGroupDelete(grp) != OK ||
+      mboxGroupSend(grp, 100, (char *)msg, sizeof(msg)) != ERROR ||
+      errnoGet() != S_mboxLib_MBOX_CLOSED) {
+    logMsg("Error: could not delete group\n");
+    return 2;
+  }
+  mboxEnd(0);
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "mboxLib.h"
+
+/* growing mailbox: a burst larger than the mailbox is kept in order, up
+ * to the size limit, and no growth happens under a message being read in
+ * place */
+
+#define SIZE 64
+#define NBURST 20
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  H2RNG_VIEW view;
+  char *bufs[NBURST];
+  int i, n, msg, size, maxSize, msgs[NBURST], nbytes[NBURST];
+
+  if (mboxInit("grow") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreateFlags("grow", SIZE, MBOX_FLAG_GROW | MBOX_FLAG_SPSC, &id)
+      != ERROR || errnoGet() != S_mboxLib_BAD_FLAGS ||
+      mboxCreatePrio("grow", SIZE, MBOX_FLAG_GROW, 2, &id) != ERROR ||
+      errnoGet() != S_mboxLib_BAD_PRIO) {
+    logMsg("Error: bad growing mailbox accepted\n");
+    return 2;
+  }
+  if (mboxCreateFlags("grow", SIZE, MBOX_FLAG_GROW, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  /* burst */
+  for (i = 0; i < NBURST; i++)
+    if (mboxSend(id, id, (char *)&i, sizeof(i)) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+  if (mboxIoctl(id, FIO_SIZE, &size) != OK || size <= SIZE ||
+      size > SIZE * MBOX_GROW_MAX_DEFAULT) {
+    logMsg("Error: mailbox size %d after the burst\n", size);
+    return 2;
+  }
+  for (i = 0; i < NBURST; i++)
+    if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0) != sizeof(msg) ||
+	msg != i) {
+      logMsg("Error: message %d out of order (%d)\n", i, msg);
+      return 2;
+    }
+
+  /* no growth over the limit, which cannot be below the current size */
+  maxSize = size - 1;
+  if (mboxIoctl(id, FIO_SETMAXSIZE, &maxSize) != ERROR ||
+      errnoGet() != S_h2rngLib_ILLEGAL_NBYTES) {
+    logMsg("Error: FIO_SETMAXSIZE below the size accepted\n");
+    return 2;
+  }
+  if (mboxIoctl(id, FIO_SETMAXSIZE, &size) != OK) {
+    logMsg("Error: FIO_SETMAXSIZE\n");
+    return 2;
+  }
+  for (n = 0; mboxSend(id, id, (char *)&n, sizeof(n)) == OK; n++)
+    ;
+  if (errnoGet() != S_mboxLib_MBOX_FULL || mboxIoctl(id, FIO_SIZE, &i) != OK
+      || i != size) {
+    logMsg("Error: mailbox grown over its limit\n");
+    return 2;
+  }
+
+  /* no growth while a message is read in place */
+  maxSize = 4 * size;
+  mboxIoctl(id, FIO_SETMAXSIZE, &maxSize);
+  if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0) != sizeof(msg) ||
+      mboxRcvPeek(id, &from, &view, 0) != sizeof(msg) ||
+      mboxSend(id, id, (char *)&n, sizeof(n)) != OK) {
+    logMsg("Error: mboxRcvPeek\n");
+    return 2;
+  }
+  if (mboxSend(id, id, (char *)&n, sizeof(n)) != ERROR ||
+      errnoGet() != S_mboxLib_MBOX_FULL) {
+    logMsg("Error: mailbox grown under mboxRcvPeek\n");
+    return 2;
+  }
+  if (mboxRcvRelease(id, &view) != OK ||
+      mboxSend(id, id, (char *)&n, sizeof(n)) != OK ||
+      mboxSend(id, id, (char *)&n, sizeof(n)) != OK) {
+    logMsg("Error: mailbox not grown after mboxRcvRelease\n");
+    return 2;
+  }
+
+  /* batch sends grow it too */
+  mboxIoctl(id, FIO_FLUSH, NULL);
+  for (i = 0; i < NBURST; i++) {
+    msgs[i] = i;
+    bufs[i] = (char *)&msgs[i];
+    nbytes[i] = sizeof(msgs[i]);
+  }
+  maxSize = 16 * size;
+  mboxIoctl(id, FIO_SETMAXSIZE, &maxSize);
+  for (n = 0; n < 5; n++)
+    if (mboxSendN(id, id, NBURST, bufs, nbytes) != NBURST) {
+      logMsg("Error: mboxSendN %d\n", n);
+      return 2;
+    }
+  if (mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 5 * NBURST) {
+    logMsg("Error: %d messages after mboxSendN, expected %d\n", n,
+	   5 * NBURST);
+    return 2;
+  }
+
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
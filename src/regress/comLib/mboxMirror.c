@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "mboxLib.h"
+
+/* messages going around a mirrored mailbox many times: every view must
+ * be in one piece, and copies must match */
+
+#define NLOOP 2000
+
+static void
+fill(char *buf, int n, int seed)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    buf[i] = (char)(seed * 7 + i);
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  H2RNG_VIEW view;
+  H2RNG_ID rng;
+  char msg[512], buf[512];
+  int i, n, sz;
+
+  if (mboxInit("mirror") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreateFlags("mirror", 1000, MBOX_FLAG_MIRROR, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  for (i = 0; i < NLOOP; i++) {
+    sz = 1 + (i * 53) % 500;
+    fill(msg, sz, i);
+
+    if (i % 3 == 0) {
+      if (mboxSendReserve(id, sz, &view) != OK || view.len[1] != 0 ||
+	  view.len[0] != sz) {
+	logMsg("Error: mboxSendReserve %d\n", i);
+	return 2;
+      }
+      memcpy(view.ptr[0], msg, sz);
+      if (mboxSendCommit(id, id, sz, &view) != OK) {
+	logMsg("Error: mboxSendCommit %d\n", i);
+	return 2;
+      }
+    } else if (mboxSend(id, id, msg, sz) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+
+    if (i & 1) {
+      n = mboxRcv(id, &from, buf, sizeof(buf), WAIT_FOREVER);
+      if (n != sz || memcmp(buf, msg, sz)) {
+	logMsg("Error: message %d corrupted\n", i);
+	return 2;
+      }
+    } else {
+      n = mboxRcvPeek(id, &from, &view, WAIT_FOREVER);
+      if (n != sz || view.len[1] != 0 || memcmp(view.ptr[0], msg, sz) ||
+	  mboxRcvRelease(id, &view) != OK) {
+	logMsg("Error: peeked message %d corrupted\n", i);
+	return 2;
+      }
+    }
+  }
+
+  if (mboxResize(id, 4000) == OK || errnoGet() != S_mboxLib_BAD_FLAGS) {
+    logMsg("Error: mirrored mailbox should not be resizable\n");
+    return 2;
+  }
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+
+  /* byte ring */
+  if ((rng = h2rngCreateFlags(H2RNG_TYPE_BYTE, 100,
+			      H2RNG_FLAG_MIRROR)) == NULL) {
+    logMsg("Error: could not create byte ring\n");
+    return 2;
+  }
+  for (i = 0; i < NLOOP; i++) {
+    sz = 1 + (i * 53) % 500;
+    fill(msg, sz, i);
+    if (h2rngBufPut(rng, msg, sz) != sz ||
+	h2rngBufGet(rng, buf, sizeof(buf)) != sz || memcmp(buf, msg, sz)) {
+      logMsg("Error: byte ring %d\n", i);
+      return 2;
+    }
+  }
+  h2rngDelete(rng);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "semLib.h"
+#include "taskLib.h"
+#include "mboxLib.h"
+
+/* multiple producers / single consumer mailbox: several senders without
+ * the mutex semaphore, messages of each sender must come out intact and
+ * in order */
+
+#define NSENDER 4
+#define NMSG 3000
+
+static MBOX_ID rcvId;
+static SEM_ID done;
+static int sendError;
+
+void *
+pocoregress_sender(void *arg)
+{
+  long s = (long)arg;
+  int i, k, msg[16];
+
+  for (i = 0; i < NMSG; i++) {
+    msg[0] = s;
+    msg[1] = i;
+    for (k = 2; k < 2 + i % 14; k++)
+      msg[k] = s * NMSG + i;
+    while (mboxSend(rcvId, 0, (char *)msg, k * sizeof(int)) != OK) {
+      if (errnoGet() != S_mboxLib_MBOX_FULL) {
+	logMsg("Error: could not send message %d\n", i);
+	sendError = 1;
+	goto end;
+      }
+      taskDelay(1);
+    }
+  }
+end:
+  semGive(done);
+  return NULL;
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID from;
+  H2RNG_VIEW view;
+  int i, k, n, msg[16], next[NSENDER];
+  char name[16];
+
+  if (mboxInit("mpsc") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreateFlags("mpsc", 16 * 64, MBOX_FLAG_MPSC, &rcvId) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+  if (mboxSendReserve(rcvId, 10, &view) == OK ||
+      errnoGet() != S_mboxLib_BAD_FLAGS) {
+    logMsg("Error: reserving in a MPSC mbox should fail\n");
+    return 2;
+  }
+
+  done = semCCreate(0, 0);
+  for (i = 0; i < NSENDER; i++) {
+    next[i] = 0;
+    snprintf(name, sizeof(name), "sender%d", i);
+    taskSpawn2(name, 200, VX_FP_TASK, 20000, pocoregress_sender,
+	       (void *)(long)i);
+  }
+
+  for (i = 0; i < NSENDER * NMSG; i++) {
+    n = mboxRcv(rcvId, &from, (char *)msg, sizeof(msg), WAIT_FOREVER);
+    if (n < 2 * sizeof(int) || msg[0] < 0 || msg[0] >= NSENDER ||
+	msg[1] != next[msg[0]] || n != (2 + msg[1] % 14) * sizeof(int)) {
+      logMsg("Error: bad message %d (%d bytes)\n", i, n);
+      return 2;
+    }
+    for (k = 2; k < n / sizeof(int); k++)
+      if (msg[k] != msg[0] * NMSG + msg[1]) {
+	logMsg("Error: message %d corrupted\n", i);
+	return 2;
+      }
+    next[msg[0]]++;
+  }
+  for (i = 0; i < NSENDER; i++)
+    semTake(done, WAIT_FOREVER);
+  semDelete(done);
+  if (sendError) return 2;
+  if (mboxIoctl(rcvId, FIO_NMSGS, &n) != OK || n != 0) {
+    logMsg("Error: %d messages left\n", n);
+    return 2;
+  }
+  logMsg("received %d messages from %d senders\n", NSENDER * NMSG, NSENDER);
+
+  if (mboxDelete(rcvId) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
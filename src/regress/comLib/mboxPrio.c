@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "mboxLib.h"
+
+/* mailbox with priority lanes: urgent messages overtake the backlog of
+ * routine ones, messages of a lane stay in order */
+
+#define NROUTINE 50
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  H2RNG_VIEW view;
+  int i, n, msg, nbytes;
+
+  if (mboxInit("prio") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreatePrio("prio", 1024, 0, 0, &id) != ERROR ||
+      errnoGet() != S_mboxLib_BAD_PRIO ||
+      mboxCreatePrio("prio", 1024, 0, MBOX_MAX_PRIO + 1, &id) != ERROR) {
+    logMsg("Error: bad number of lanes accepted\n");
+    return 2;
+  }
+  if (mboxCreatePrio("prio", 1024, 0, 3, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+  if (mboxSendPrio(id, id, 3, (char *)&msg, sizeof(msg)) != ERROR ||
+      errnoGet() != S_mboxLib_BAD_PRIO) {
+    logMsg("Error: send to a missing lane accepted\n");
+    return 2;
+  }
+  if (mboxResize(id, 2048) != ERROR) {
+    logMsg("Error: mbox with lanes should not be resizable\n");
+    return 2;
+  }
+
+  for (i = 0; i < NROUTINE; i++)
+    if (mboxSend(id, id, (char *)&i, sizeof(i)) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+  msg = 1000;
+  if (mboxSendPrio(id, id, 1, (char *)&msg, sizeof(msg)) != OK) {
+    logMsg("Error: mboxSendPrio 1\n");
+    return 2;
+  }
+  msg = 2000;
+  if (mboxSendPrio(id, id, 2, (char *)&msg, sizeof(msg)) != OK) {
+    logMsg("Error: mboxSendPrio 2\n");
+    return 2;
+  }
+  if (mboxIoctl(id, FIO_NMSGS, &n) != OK || n != NROUTINE + 2) {
+    logMsg("Error: expected %d messages, got %d\n", NROUTINE + 2, n);
+    return 2;
+  }
+
+  /* highest lane first, for all receive functions */
+  if (mboxSpy(id, &from, &nbytes, (char *)&msg, sizeof(msg)) != sizeof(msg)
+      || msg != 2000) {
+    logMsg("Error: mboxSpy should see the urgent message\n");
+    return 2;
+  }
+  if (mboxRcvPeek(id, &from, &view, 1) != sizeof(msg) ||
+      *(int *)view.ptr[0] != 2000) {
+    logMsg("Error: mboxRcvPeek should see the urgent message\n");
+    return 2;
+  }
+  /* a more urgent message arriving meanwhile does not change the
+   * message released */
+  msg = 2001;
+  if (mboxSendPrio(id, id, 2, (char *)&msg, sizeof(msg)) != OK ||
+      mboxRcvRelease(id, &view) != OK) {
+    logMsg("Error: mboxRcvRelease\n");
+    return 2;
+  }
+  if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 1) != sizeof(msg) ||
+      msg != 2001) {
+    logMsg("Error: expected second urgent message, got %d\n", msg);
+    return 2;
+  }
+  if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 1) != sizeof(msg) ||
+      msg != 1000) {
+    logMsg("Error: expected lane 1 message, got %d\n", msg);
+    return 2;
+  }
+  for (i = 0; i < NROUTINE; i++)
+    if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 1) != sizeof(msg) ||
+	msg != i) {
+      logMsg("Error: routine message %d out of order (%d)\n", i, msg);
+      return 2;
+    }
+
+  /* flush empties all lanes */
+  for (i = 0; i < 3; i++)
+    mboxSendPrio(id, id, i, (char *)&i, sizeof(i));
+  if (mboxIoctl(id, FIO_FLUSH, NULL) != OK ||
+      mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 0 ||
+      mboxPause(id, 1) != FALSE) {
+    logMsg("Error: lanes not flushed\n");
+    return 2;
+  }
+
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "h2devLib.h"
+#include "mboxLib.h"
+
+/* mboxPauseAll() on more mailboxes than the ready set can track: the
+ * non-empty ones must all be reported, and none once they are drained */
+
+#define NMBOX (H2_TASK_MAX_MBOX + 3)
+
+int
+pocoregress_init()
+{
+  MBOX_ID id[NMBOX], ready[NMBOX], from;
+  static const int full[] = { 2, 17, H2_TASK_MAX_MBOX + 1 };
+  char name[32], buf[16];
+  int i, j, n;
+
+  if (mboxInit("ready") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  for (i = 0; i < NMBOX; i++) {
+    snprintf(name, sizeof(name), "ready%d", i);
+    if (mboxCreate(name, 64, &id[i]) != OK) {
+      logMsg("Error: could not create mbox %d\n", i);
+      return 2;
+    }
+  }
+
+  if (mboxPauseAll(ready, NMBOX, 1) != FALSE ||
+      mboxPause(ALL_MBOX, 1) != FALSE) {
+    logMsg("Error: no mailbox should be ready\n");
+    return 2;
+  }
+
+  for (i = 0; i < 3; i++)
+    if (mboxSend(id[full[i]], id[0], "x", 1) != OK) {
+      logMsg("Error: mboxSend %d\n", full[i]);
+      return 2;
+    }
+
+  if (mboxPause(ALL_MBOX, 1) != TRUE) {
+    logMsg("Error: mboxPause(ALL_MBOX) should find messages\n");
+    return 2;
+  }
+  n = mboxPauseAll(ready, NMBOX, 1);
+  if (n != 3) {
+    logMsg("Error: expected 3 ready mailboxes, got %d\n", n);
+    return 2;
+  }
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < n && ready[j] != id[full[i]]; j++);
+    if (j == n) {
+      logMsg("Error: mailbox %d not reported\n", full[i]);
+      return 2;
+    }
+  }
+  if (mboxPauseAll(ready, 1, 1) != 3) {
+    logMsg("Error: count should not depend on maxIds\n");
+    return 2;
+  }
+
+  /* drain one, then all */
+  if (mboxRcv(id[full[1]], &from, buf, sizeof(buf), 1) != 1 ||
+      mboxPauseAll(ready, NMBOX, 1) != 2) {
+    logMsg("Error: drained mailbox still reported\n");
+    return 2;
+  }
+  for (i = 0; i < 3; i += 2)
+    mboxRcv(id[full[i]], &from, buf, sizeof(buf), 1);
+  if (mboxPauseAll(ready, NMBOX, 1) != FALSE) {
+    logMsg("Error: no mailbox should be ready after draining\n");
+    return 2;
+  }
+
+  /* a freed slot is reused */
+  if (mboxDelete(id[5]) != OK ||
+      mboxCreate("ready5", 64, &id[5]) != OK ||
+      mboxSend(id[5], id[0], "y", 1) != OK ||
+      mboxPauseAll(ready, NMBOX, 1) != 1 || ready[0] != id[5]) {
+    logMsg("Error: recreated mailbox not reported\n");
+    return 2;
+  }
+
+  for (i = 0; i < NMBOX; i++)
+    if (mboxDelete(id[i]) != OK) {
+      logMsg("Error: could not delete mbox %d\n", i);
+      return 2;
+    }
+  return 0;
+}
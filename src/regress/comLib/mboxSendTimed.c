@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "semLib.h"
+#include "taskLib.h"
+#include "mboxLib.h"
+
+/* senders blocking on a small full mailbox until the reader makes room:
+ * no message may be lost or reordered, and timeouts must be reported */
+
+#define NSENDER 3
+#define NMSG 500
+
+static MBOX_ID rcvId;
+static SEM_ID done;
+static int sendError;
+
+void *
+pocoregress_sender(void *arg)
+{
+  long s = (long)arg;
+  int i, msg[2];
+
+  for (i = 0; i < NMSG; i++) {
+    msg[0] = s;
+    msg[1] = i;
+    if (mboxSendTimed(rcvId, 0, (char *)msg, sizeof(msg), WAIT_FOREVER)
+	!= OK) {
+      logMsg("Error: could not send message %d\n", i);
+      sendError = 1;
+      break;
+    }
+  }
+  semGive(done);
+  return NULL;
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID from;
+  char buf[200], name[16];
+  int i, n, nfill, msg[2], next[NSENDER];
+
+  if (mboxInit("timed") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreate("timed", 100, &rcvId) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  if (mboxSendTimed(rcvId, 0, buf, sizeof(buf), 1) != ERROR ||
+      errnoGet() != S_mboxLib_TOO_BIG) {
+    logMsg("Error: oversized message should fail with TOO_BIG\n");
+    return 2;
+  }
+
+  /* fill the mailbox */
+  for (nfill = 0; mboxSend(rcvId, 0, buf, 16) == OK; nfill++);
+  if (nfill == 0 || errnoGet() != S_mboxLib_MBOX_FULL) {
+    logMsg("Error: could not fill mbox\n");
+    return 2;
+  }
+  if (mboxSendTimed(rcvId, 0, buf, 16, 1) != ERROR ||
+      errnoGet() != S_mboxLib_MBOX_FULL) {
+    logMsg("Error: send to a full mbox should time out\n");
+    return 2;
+  }
+  if (mboxIoctl(rcvId, FIO_NSENDBLOCKED, &n) != OK || n != 1) {
+    logMsg("Error: expected 1 blocked send, got %d\n", n);
+    return 2;
+  }
+
+  done = semCCreate(0, 0);
+  for (i = 0; i < NSENDER; i++) {
+    next[i] = 0;
+    snprintf(name, sizeof(name), "sender%d", i);
+    taskSpawn2(name, 200, VX_FP_TASK, 20000, pocoregress_sender,
+	       (void *)(long)i);
+  }
+
+  for (i = 0; i < nfill; i++)
+    if (mboxRcv(rcvId, &from, buf, sizeof(buf), WAIT_FOREVER) != 16) {
+      logMsg("Error: bad filler message %d\n", i);
+      return 2;
+    }
+  for (i = 0; i < NSENDER * NMSG; i++) {
+    n = mboxRcv(rcvId, &from, (char *)msg, sizeof(msg), WAIT_FOREVER);
+    if (n != sizeof(msg) || msg[0] < 0 || msg[0] >= NSENDER ||
+	msg[1] != next[msg[0]]) {
+      logMsg("Error: bad message %d (%d bytes)\n", i, n);
+      return 2;
+    }
+    next[msg[0]]++;
+  }
+  for (i = 0; i < NSENDER; i++)
+    semTake(done, WAIT_FOREVER);
+  semDelete(done);
+  if (sendError) return 2;
+
+  if (mboxIoctl(rcvId, FIO_NSENDBLOCKED, &n) != OK || n <= 1) {
+    logMsg("Error: senders never blocked (%d)\n", n);
+    return 2;
+  }
+  logMsg("senders blocked %d times\n", n);
+
+  if (mboxDelete(rcvId) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
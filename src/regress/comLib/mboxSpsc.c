@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "semLib.h"
+#include "taskLib.h"
+#include "mboxLib.h"
+
+/* single producer / single consumer mailbox: messages must come out in
+ * order, through many wraps of a small ring buffer */
+
+#define NMSG 5000
+
+static MBOX_ID rcvId;
+static SEM_ID done;
+static int sendError;
+
+void *
+pocoregress_sender(void *arg)
+{
+  int i;
+
+  for (i = 0; i < NMSG; i++) {
+    while (mboxSend(rcvId, 0, (char *)&i, sizeof(i)) != OK) {
+      if (errnoGet() != S_mboxLib_MBOX_FULL) {
+	logMsg("Error: could not send message %d\n", i);
+	sendError = 1;
+	goto end;
+      }
+      taskDelay(1);
+    }
+  }
+end:
+  semGive(done);
+  return NULL;
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID from;
+  int i, n, msg;
+
+  if (mboxInit("spsc") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreateFlags("spsc", 16 * 64, MBOX_FLAG_SPSC, &rcvId) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+  if (mboxResize(rcvId, 32 * 64) == OK ||
+      errnoGet() != S_mboxLib_BAD_FLAGS) {
+    logMsg("Error: resizing a SPSC mbox should fail\n");
+    return 2;
+  }
+
+  done = semBCreate(0, SEM_EMPTY);
+  taskSpawn2("sender", 200, VX_FP_TASK, 20000, pocoregress_sender, NULL);
+
+  for (i = 0; i < NMSG; i++) {
+    n = mboxRcv(rcvId, &from, (char *)&msg, sizeof(msg), WAIT_FOREVER);
+    if (n != sizeof(msg)) {
+      logMsg("Error: mboxRcv returned %d\n", n);
+      return 2;
+    }
+    if (msg != i) {
+      logMsg("Error: got message %d instead of %d\n", msg, i);
+      return 2;
+    }
+  }
+  semTake(done, WAIT_FOREVER);
+  semDelete(done);
+  if (sendError) return 2;
+  logMsg("received %d messages in order\n", NMSG);
+
+  if (mboxDelete(rcvId) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "mboxLib.h"
+
+/* mailbox statistics: traffic counters, send failures, high-water mark
+ * and latency histogram, reset by each FIO_STATS */
+
+static unsigned int
+nLatency(const MBOX_STATS *st)
+{
+  unsigned int n = 0;
+  int b;
+
+  for (b = 0; b < MBOX_STATS_NLAT; b++)
+    n += st->latency[b];
+  return n;
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, grow, plain, from, froms[8];
+  MBOX_STATS st;
+  char buf[100], *bufs[8];
+  int i, n, sizes[8];
+
+  if (mboxInit("stats") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreateFlags("stats", 256, MBOX_FLAG_LATENCY, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  for (i = 1; i <= 3; i++)
+    if (mboxSend(id, id, buf, 10 * i) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+  if (mboxIoctl(id, FIO_NBYTES, &n) != OK) {
+    logMsg("Error: FIO_NBYTES\n");
+    return 2;
+  }
+  for (i = 0; i < 2; i++)
+    if (mboxRcv(id, &from, buf, sizeof(buf), 0) <= 0) {
+      logMsg("Error: mboxRcv %d\n", i);
+      return 2;
+    }
+  /* fill the mailbox */
+  while (mboxSend(id, id, buf, 50) == OK)
+    ;
+  if (errnoGet() != S_mboxLib_MBOX_FULL) {
+    logMsg("Error: expected a full mailbox\n");
+    return 2;
+  }
+
+  if (mboxIoctl(id, FIO_STATS, &st) != OK) {
+    logMsg("Error: FIO_STATS\n");
+    return 2;
+  }
+  if (st.sentMsgs < 4 || st.sentBytes != 60 + 50 * (st.sentMsgs - 3)) {
+    logMsg("Error: sent %u messages, %u bytes\n", st.sentMsgs, st.sentBytes);
+    return 2;
+  }
+  if (st.rcvMsgs != 2 || st.rcvBytes != 30) {
+    logMsg("Error: received %u messages, %u bytes\n", st.rcvMsgs,
+	   st.rcvBytes);
+    return 2;
+  }
+  if (st.sendFull != 1) {
+    logMsg("Error: %u failed sends, expected 1\n", st.sendFull);
+    return 2;
+  }
+  if (st.highWater < (unsigned int)n || st.highWater > 256) {
+    logMsg("Error: high-water mark %u\n", st.highWater);
+    return 2;
+  }
+  if (nLatency(&st) != 2) {
+    logMsg("Error: %u latencies, expected 2\n", nLatency(&st));
+    return 2;
+  }
+
+  /* counters were reset */
+  if (mboxIoctl(id, FIO_STATS, &st) != OK ||
+      st.sentMsgs != 0 || st.rcvMsgs != 0 || st.sendFull != 0 ||
+      st.highWater != 0 || nLatency(&st) != 0) {
+    logMsg("Error: statistics not reset\n");
+    return 2;
+  }
+
+  /* a batch read sees the stamps of all its messages */
+  for (i = 0; i < 8; i++)
+    bufs[i] = buf;
+  if ((n = mboxRcvN(id, 8, froms, sizes, bufs, sizeof(buf), 0)) <= 0) {
+    logMsg("Error: mboxRcvN\n");
+    return 2;
+  }
+  if (mboxIoctl(id, FIO_STATS, &st) != OK || st.rcvMsgs != (unsigned int)n
+      || nLatency(&st) != (unsigned int)n) {
+    logMsg("Error: %u messages received, %u latencies, expected %d\n",
+	   st.rcvMsgs, nLatency(&st), n);
+    return 2;
+  }
+
+  /* messages queued behind many others keep their stamps, also when a
+     growing mailbox moves them */
+  if (mboxCreateFlags("statsgrow", 256, MBOX_FLAG_GROW | MBOX_FLAG_LATENCY,
+		      &grow) != OK) {
+    logMsg("Error: could not create growing mbox\n");
+    return 2;
+  }
+  for (i = 0; i < 100; i++)
+    if (mboxSend(grow, grow, buf, 1) != OK) {
+      logMsg("Error: mboxSend %d to growing mbox\n", i);
+      return 2;
+    }
+  for (i = 0; i < 100; i++)
+    if (mboxRcv(grow, &from, buf, sizeof(buf), 0) != 1) {
+      logMsg("Error: mboxRcv %d from growing mbox\n", i);
+      return 2;
+    }
+  if (mboxIoctl(grow, FIO_STATS, &st) != OK || nLatency(&st) != 100) {
+    logMsg("Error: %u latencies, expected 100\n", nLatency(&st));
+    return 2;
+  }
+
+  /* without MBOX_FLAG_LATENCY, messages are counted but not dated */
+  if (mboxCreate("statsplain", 256, &plain) != OK) {
+    logMsg("Error: could not create plain mbox\n");
+    return 2;
+  }
+  if (mboxSend(plain, plain, buf, 10) != OK
+      || mboxRcv(plain, &from, buf, sizeof(buf), 0) != 10) {
+    logMsg("Error: mboxSend/mboxRcv on plain mbox\n");
+    return 2;
+  }
+  if (mboxIoctl(plain, FIO_STATS, &st) != OK || st.sentMsgs != 1
+      || st.rcvMsgs != 1 || nLatency(&st) != 0) {
+    logMsg("Error: plain mbox: %u sent, %u received, %u latencies\n",
+	   st.sentMsgs, st.rcvMsgs, nLatency(&st));
+    return 2;
+  }
+
+  mboxStats();
+  if (mboxDelete(plain) != OK || mboxDelete(grow) != OK
+      || mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "pocolibs-config.h"
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <dlfcn.h>
+#include <stdarg.h>
+#endif
+
+#include "portLib.h"
+#include "semLib.h"
+#include "taskLib.h"
+#include "h2devLib.h"
+#include "mboxLib.h"
+
+/* a task sleeping in mboxRcv() or mboxPause() is woken by a send from
+ * another task, and a send to a mailbox nobody waits for does not enter
+ * the kernel */
+
+static MBOX_ID rcvId;
+static SEM_ID ready, done;
+static int rcvMsg, pauseStat;
+
+#ifdef __linux__
+
+/* futex calls of h2semLib, counted before being passed on to the libc */
+static unsigned int nFutexWait, nFutexWake;
+
+long
+syscall(long number, ...)
+{
+  static long (*next)(long, ...);
+  long a[6];
+  va_list ap;
+  int i;
+
+  va_start(ap, number);
+  for (i = 0; i < 6; i++)
+    a[i] = va_arg(ap, long);
+  va_end(ap);
+
+  if (number == SYS_futex) {
+    if ((a[1] & FUTEX_CMD_MASK) == FUTEX_WAIT)
+      __atomic_add_fetch(&nFutexWait, 1, __ATOMIC_SEQ_CST);
+    else if ((a[1] & FUTEX_CMD_MASK) == FUTEX_WAKE)
+      __atomic_add_fetch(&nFutexWake, 1, __ATOMIC_SEQ_CST);
+  }
+  if (next == NULL)
+    next = (long (*)(long, ...))dlsym(RTLD_NEXT, "syscall");
+  return next(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+#define FUTEX_WAITS() __atomic_load_n(&nFutexWait, __ATOMIC_SEQ_CST)
+#define FUTEX_WAKES() __atomic_load_n(&nFutexWake, __ATOMIC_SEQ_CST)
+
+#endif /* __linux__ */
+
+void *
+pocoregress_receiver(void *arg)
+{
+  MBOX_ID from;
+  int msg;
+
+  if (mboxInit("wakerx") == ERROR ||
+      mboxCreate("wakerx", 64, &rcvId) != OK) {
+    logMsg("Error: could not create receiver mbox\n");
+    rcvId = ERROR;
+    semGive(ready);
+    return NULL;
+  }
+  semGive(ready);
+
+  /* sleeps in mboxRcv() */
+  if (mboxRcv(rcvId, &from, (char *)&msg, sizeof(msg), 0) == sizeof(msg))
+    rcvMsg = msg;
+  semGive(done);
+
+  /* then in mboxPause() */
+  pauseStat = mboxPause(rcvId, 0);
+  mboxRcv(rcvId, &from, (char *)&msg, sizeof(msg), 1);
+  semGive(done);
+
+  semTake(ready, WAIT_FOREVER);
+  mboxDelete(rcvId);
+  semGive(done);
+  return NULL;
+}
+
+/* waits until the receiver sleeps, or tries to, after markSleeping() */
+#ifdef __linux__
+static unsigned int sleeps;
+#endif
+
+static void
+markSleeping(void)
+{
+#ifdef __linux__
+  sleeps = FUTEX_WAITS();
+#endif
+}
+
+static void
+waitSleeping(void)
+{
+#ifdef __linux__
+  while (FUTEX_WAITS() == sleeps)
+    taskDelay(1);
+#else
+  taskDelay(sysClkRateGet() / 10 + 1);
+#endif
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  int i, msg;
+#ifdef __linux__
+  unsigned int wakes;
+#endif
+
+  if (mboxInit("wake") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreate("wake", 256, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  /* nobody waits: no FUTEX_WAKE */
+#ifdef __linux__
+  wakes = FUTEX_WAKES();
+#endif
+  for (i = 0; i < 10; i++)
+    if (mboxSend(id, id, (char *)&i, sizeof(i)) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+  for (i = 0; i < 10; i++)
+    if (mboxRcv(id, &from, (char *)&msg, sizeof(msg), 0) != sizeof(msg)
+	|| msg != i) {
+      logMsg("Error: mboxRcv %d\n", i);
+      return 2;
+    }
+#ifdef __linux__
+  if (FUTEX_WAKES() != wakes) {
+    logMsg("Error: %u FUTEX_WAKE without waiters\n", FUTEX_WAKES() - wakes);
+    return 2;
+  }
+#endif
+
+  /* a receiver in another task */
+  ready = semCCreate(0, 0);
+  done = semCCreate(0, 0);
+  markSleeping();
+  taskSpawn2("receiver", 200, VX_FP_TASK, 20000, pocoregress_receiver, NULL);
+  semTake(ready, WAIT_FOREVER);
+  if (rcvId == ERROR)
+    return 2;
+
+  waitSleeping();
+#ifdef __linux__
+  wakes = FUTEX_WAKES();
+#endif
+  msg = 42;
+  markSleeping();
+  if (mboxSend(rcvId, id, (char *)&msg, sizeof(msg)) != OK) {
+    logMsg("Error: mboxSend to the receiver\n");
+    return 2;
+  }
+  if (semTake(done, 5 * sysClkRateGet()) != OK || rcvMsg != 42) {
+    logMsg("Error: mboxRcv not woken by mboxSend\n");
+    return 2;
+  }
+#ifdef __linux__
+  if (FUTEX_WAKES() == wakes) {
+    logMsg("Error: no FUTEX_WAKE for the sleeping receiver\n");
+    return 2;
+  }
+#endif
+
+  waitSleeping();
+#ifdef __linux__
+  wakes = FUTEX_WAKES();
+#endif
+  if (mboxSend(rcvId, id, (char *)&msg, sizeof(msg)) != OK) {
+    logMsg("Error: mboxSend to the receiver\n");
+    return 2;
+  }
+  if (semTake(done, 5 * sysClkRateGet()) != OK || pauseStat != TRUE) {
+    logMsg("Error: mboxPause not woken by mboxSend\n");
+    return 2;
+  }
+#ifdef __linux__
+  if (FUTEX_WAKES() == wakes) {
+    logMsg("Error: no FUTEX_WAKE for the pausing receiver\n");
+    return 2;
+  }
+#endif
+
+  semGive(ready);
+  semTake(done, WAIT_FOREVER);
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2026 CNRS/LAAS
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "pocolibs-config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "portLib.h"
+#include "errnoLib.h"
+#include "mboxLib.h"
+
+/* messages written in place in the ring with mboxSendReserve() and read
+ * in place with mboxRcvPeek(), with sizes chosen so that both the header
+ * and the data wrap */
+
+#define MBOX_SIZE 1000
+#define NLOOP 500
+
+static void
+fill(char *buf, int n, int seed)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    buf[i] = (char)(seed + i);
+}
+
+int
+pocoregress_init()
+{
+  MBOX_ID id, from;
+  H2RNG_VIEW view;
+  char msg[256], buf[256];
+  int i, n, sz;
+
+  if (mboxInit("zeroCopy") == ERROR) {
+    logMsg("Error: could not initialize mbox\n");
+    return 2;
+  }
+  if (mboxCreate("zeroCopy", MBOX_SIZE, &id) != OK) {
+    logMsg("Error: could not create mbox\n");
+    return 2;
+  }
+
+  for (i = 0; i < NLOOP; i++) {
+    sz = 1 + (i * 37) % 200;
+    fill(msg, sz, i);
+
+    /* reserve more than needed, commit the actual size */
+    if (mboxSendReserve(id, sz + 13, &view) != OK) {
+      logMsg("Error: mboxSendReserve %d\n", i);
+      return 2;
+    }
+    if (view.len[0] + view.len[1] != sz + 13) {
+      logMsg("Error: bad view length\n");
+      return 2;
+    }
+    n = sz < view.len[0] ? sz : view.len[0];
+    memcpy(view.ptr[0], msg, n);
+    if (n < sz)
+      memcpy(view.ptr[1], msg + n, sz - n);
+    if (mboxSendCommit(id, id, sz, &view) != OK) {
+      logMsg("Error: mboxSendCommit %d\n", i);
+      return 2;
+    }
+
+    /* a cancelled reservation leaves nothing behind */
+    if (mboxSendReserve(id, 10, &view) != OK ||
+	mboxSendCancel(id, &view) != OK) {
+      logMsg("Error: reserve/cancel %d\n", i);
+      return 2;
+    }
+    /* ... and its view cannot be cancelled again */
+    if (mboxSendCancel(id, &view) != ERROR ||
+	errnoGet() != S_h2rngLib_ERR_SYNC ||
+	mboxSendCancel(id, NULL) != ERROR) {
+      logMsg("Error: cancelled view accepted %d\n", i);
+      return 2;
+    }
+
+    if (i & 1) {
+      n = mboxRcv(id, &from, buf, sizeof(buf), WAIT_FOREVER);
+    } else {
+      /* peek twice: the message stays until released */
+      if (mboxRcvPeek(id, &from, &view, WAIT_FOREVER) != sz) {
+	logMsg("Error: mboxRcvPeek %d\n", i);
+	return 2;
+      }
+      n = mboxRcvPeek(id, &from, &view, WAIT_FOREVER);
+      if (view.len[0] + view.len[1] != n ||
+	  h2rngViewCopy(&view, 0, buf, sizeof(buf)) != n ||
+	  mboxRcvRelease(id, &view) != OK ||
+	  mboxIoctl(id, FIO_NBYTES, &sz) != OK || sz != 0) {
+	logMsg("Error: peek/release %d\n", i);
+	return 2;
+      }
+      sz = 1 + (i * 37) % 200;
+    }
+    if (n != sz || from != id || memcmp(buf, msg, sz)) {
+      logMsg("Error: message %d corrupted (%d/%d bytes)\n", i, n, sz);
+      return 2;
+    }
+  }
+
+  /* batched send and receive */
+  {
+    char bbuf[7][32], *bufs[7];
+    MBOX_ID froms[7];
+    int lens[7], k, j;
+
+    for (k = 0; k < 7; k++) {
+      bufs[k] = bbuf[k];
+      lens[k] = 20 + k;
+      fill(bufs[k], lens[k], k);
+    }
+    if (mboxSendN(id, id, 7, bufs, lens) != 7) {
+      logMsg("Error: mboxSendN\n");
+      return 2;
+    }
+    for (i = 0; i < 7; i += n) {
+      n = mboxRcvN(id, 5, froms, lens, bufs, sizeof(bbuf[0]), WAIT_FOREVER);
+      if (n != (i == 0 ? 5 : 2)) {
+	logMsg("Error: mboxRcvN returned %d\n", n);
+	return 2;
+      }
+      for (k = 0, j = i; k < n; k++, j++) {
+	fill(msg, 20 + j, j);
+	if (lens[k] != 20 + j || froms[k] != id ||
+	    memcmp(bufs[k], msg, lens[k])) {
+	  logMsg("Error: batched message %d corrupted\n", j);
+	  return 2;
+	}
+      }
+    }
+    if (mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 0) {
+      logMsg("Error: expected empty mbox after mboxRcvN, got %d\n", n);
+      return 2;
+    }
+
+    /* a batch larger than the mailbox is only partially sent */
+    for (k = 0; k < 7; k++) {
+      bufs[k] = msg;
+      lens[k] = 200;
+    }
+    n = mboxSendN(id, id, 7, bufs, lens);
+    if (n <= 0 || n >= 7 || errnoGet() != S_mboxLib_MBOX_FULL ||
+	mboxIoctl(id, FIO_NMSGS, &k) != OK || k != n ||
+	mboxIoctl(id, FIO_FLUSH, NULL) != OK) {
+      logMsg("Error: partial mboxSendN sent %d\n", n);
+      return 2;
+    }
+
+    /* the batch stops before a message that does not fit */
+    for (k = 0; k < 7; k++)
+      bufs[k] = bbuf[k];
+    if (mboxSend(id, id, msg, 10) != OK ||
+	mboxSend(id, id, msg, 100) != OK ||
+	mboxRcvN(id, 5, froms, lens, bufs, sizeof(bbuf[0]), 1) != 1 ||
+	mboxRcvN(id, 5, froms, lens, bufs, sizeof(bbuf[0]), 1) != ERROR) {
+      logMsg("Error: mboxRcvN with a small buffer\n");
+      return 2;
+    }
+
+    /* an empty batch is an error, not a wait for nothing */
+    if (mboxRcvN(id, 0, froms, lens, bufs, sizeof(bbuf[0]), WAIT_FOREVER)
+	!= ERROR || errnoGet() != S_h2rngLib_ILLEGAL_NBYTES) {
+      logMsg("Error: mboxRcvN accepted 0 messages\n");
+      return 2;
+    }
+  }
+
+  /* gathered send */
+  {
+    struct iovec iov[3];
+
+    fill(msg, 60, 3);
+    iov[0].iov_base = msg;
+    iov[0].iov_len = 7;
+    iov[1].iov_base = msg + 7;
+    iov[1].iov_len = 0;
+    iov[2].iov_base = msg + 7;
+    iov[2].iov_len = 53;
+    if (mboxSendV(id, id, iov, 3) != OK ||
+	mboxRcv(id, &from, buf, sizeof(buf), 1) != 60 ||
+	memcmp(buf, msg, 60)) {
+      logMsg("Error: mboxSendV\n");
+      return 2;
+    }
+  }
+
+  /* message count */
+  for (i = 0; i < 3; i++)
+    if (mboxSend(id, id, msg, 10 + i) != OK) {
+      logMsg("Error: mboxSend %d\n", i);
+      return 2;
+    }
+  if (mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 3) {
+    logMsg("Error: expected 3 messages, got %d\n", n);
+    return 2;
+  }
+  if (mboxSkip(id) != OK || mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 2) {
+    logMsg("Error: expected 2 messages, got %d\n", n);
+    return 2;
+  }
+  if (mboxIoctl(id, FIO_FLUSH, NULL) != OK ||
+      mboxIoctl(id, FIO_NMSGS, &n) != OK || n != 0) {
+    logMsg("Error: expected no message after flush, got %d\n", n);
+    return 2;
+  }
+
+  /* empty mailbox: waits time out */
+  if (mboxRcv(id, &from, buf, sizeof(buf), 1) != FALSE ||
+      mboxPause(id, 1) != FALSE) {
+    logMsg("Error: waiting on an empty mbox should time out\n");
+    return 2;
+  }
+
+  /* no room */
+  if (mboxSendReserve(id, MBOX_SIZE * 2, &view) == OK ||
+      errnoGet() != S_mboxLib_MBOX_FULL) {
+    logMsg("Error: oversized reservation should fail\n");
+    return 2;
+  }
+
+  if (mboxDelete(id) != OK) {
+    logMsg("Error: could not delete mbox\n");
+    return 2;
+  }
+  return 0;
+}
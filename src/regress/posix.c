@@ -18,6 +18,7 @@
 
 #include "portLib.h"
 
+#include <ctype.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,8 +32,15 @@ int
 main(int argc, char *argv[])
 {
 	int status;
+	char ns[H2DEV_MAX_NAMESPACE], *p;
 
 	osInit(100);
+	/* each test has its own devices, so that tests can run in parallel */
+	snprintf(ns, sizeof(ns), "%s", basename(argv[0]));
+	for (p = ns; *p != '\0'; p++)
+		if (!isalnum((unsigned char)*p))
+			*p = '_';
+	setenv("H2DEV_NAMESPACE", ns, 1);
 	h2devEnd();
 	if (h2devInit(1024*1024, H2_DEV_MAX_DEFAULT, FALSE) == ERROR) {
 		char buf[1024];